@@ -33,6 +33,7 @@ void rfc822_date (char *date);
 void rfc822_timezone (char *s,void *t);
 void internal_date (char *date);
 long server_input_wait (long seconds);
+long server_input_watch (long seconds,int fd);
 void server_init (char *server,char *service,char *sasl,
 		  void *clkint,void *kodint,void *hupint,void *trmint,
 		  void *staint);
@@ -302,7 +302,8 @@ DRIVER imapdriver = {
   imap_expunge,			/* expunge deleted messages */
   imap_copy,			/* copy messages to another mailbox */
   imap_append,			/* append string message to mailbox */
-  imap_gc			/* garbage collect stream */
+  imap_gc,			/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -740,6 +741,8 @@ long imap_status (MAILSTREAM *stream,char *mbx,long flags)
     if (flags & SA_UNSEEN) strcat (tmp," UNSEEN");
     if (flags & SA_UIDNEXT) strcat (tmp," UIDNEXT");
     if (flags & SA_UIDVALIDITY) strcat (tmp," UIDVALIDITY");
+    if ((flags & SA_HIGHESTMODSEQ) && LEVELCONDSTORE (stream))
+      strcat (tmp," HIGHESTMODSEQ");
     tmp[0] = '(';
     strcat (tmp,")");
 				/* send "STATUS mailbox flag" */
@@ -754,7 +757,7 @@ long imap_status (MAILSTREAM *stream,char *mbx,long flags)
 				/* IMAP2 way */
   else if (imap_OK (stream,imap_send (stream,"EXAMINE",args))) {
     MAILSTATUS status;
-    status.flags = flags & ~ (SA_UIDNEXT | SA_UIDVALIDITY);
+    status.flags = flags & ~ (SA_UIDNEXT | SA_UIDVALIDITY | SA_HIGHESTMODSEQ);
     status.messages = stream->nmsgs;
     status.recent = stream->recent;
     status.unseen = 0;
@@ -784,6 +787,8 @@ MAILSTREAM *imap_open (MAILSTREAM *stream)
   unsigned long i,j;
   char *s,tmp[MAILTMPLEN],usr[MAILTMPLEN];
   NETMBX mb;
+  NETSTREAM *ns;
+  netdeflate_t nd;
   IMAPPARSEDREPLY *reply = NIL;
   imapreferral_t ir =
     (imapreferral_t) mail_parameters (stream,GET_IMAPREFERRAL,NIL);
@@ -933,6 +938,17 @@ MAILSTREAM *imap_open (MAILSTREAM *stream)
     }
 				/* get server capabilities again */
     if (LOCAL->netstream && !LOCAL->gotcapability) imap_capability (stream);
+				/* negotiate compression if possible */
+    if (LOCAL->netstream && LEVELDEFLATE (stream) &&
+	(nd = (netdeflate_t) mail_parameters (NIL,GET_NETDEFLATE,NIL)) &&
+	LOCAL->netstream->dtb->getsome &&
+	imap_OK (stream,imap_send (stream,"COMPRESS DEFLATE",NIL))) {
+      if (!(ns = (*nd) (LOCAL->netstream))) {
+	mm_log ("Unable to start compression",ERROR);
+	net_close (LOCAL->netstream);
+      }
+      LOCAL->netstream = ns;	/* stream is compressed from now on */
+    }
 				/* save state for future recycling */
     if (mb.tlsflag) LOCAL->tlsflag = T;
     if (mb.tlssslv23) LOCAL->tlssslv23 = T;
@@ -1998,7 +2014,8 @@ long imap_search (MAILSTREAM *stream,char *charset,SEARCHPGM *pgm,long flags)
 	pgm->undraft || pgm->return_path || pgm->sender || pgm->reply_to ||
 	pgm->message_id || pgm->in_reply_to || pgm->newsgroups ||
 	pgm->followup_to || pgm->references)) ||
-      (!LEVELWITHIN (stream) && (pgm->older || pgm->younger))) {
+      (!LEVELWITHIN (stream) && (pgm->older || pgm->younger)) ||
+      (!LEVELCONDSTORE (stream) && pgm->modseq)) {
     if ((flags & SE_NOLOCAL) ||
 	!mail_search_default (stream,charset,pgm,flags | SE_NOSERVER))
       return NIL;
@@ -2008,7 +2025,7 @@ long imap_search (MAILSTREAM *stream,char *charset,SEARCHPGM *pgm,long flags)
 	   !(pgm->uid || pgm->or || pgm->not ||
 	     pgm->header || pgm->from || pgm->to || pgm->cc || pgm->bcc ||
 	     pgm->subject || pgm->body || pgm->text ||
-	     pgm->larger || pgm->smaller ||
+	     pgm->larger || pgm->smaller || pgm->modseq ||
 	     pgm->sentbefore || pgm->senton || pgm->sentsince ||
 	     pgm->before || pgm->on || pgm->since ||
 	     pgm->answered || pgm->unanswered ||
@@ -3304,6 +3321,10 @@ IMAPPARSEDREPLY *imap_send_spgm (MAILSTREAM *stream,char *tag,char *base,
   if (pgm->younger) {
     sprintf (*s," YOUNGER %lu",pgm->younger);
     *s += strlen (*s);
+  }
+  if (pgm->modseq) {		/* modification sequence */
+    sprintf (*s," MODSEQ %lu",pgm->modseq);
+    *s += strlen (*s);
   }
 				/* search texts */
   if ((pgm->bcc && (reply = imap_send_slist (stream,tag,base,s," BCC ",
@@ -3963,7 +3984,7 @@ void imap_parse_unsolicited (MAILSTREAM *stream,IMAPPARSEDREPLY *reply)
       *s = '\0';		/* tie off status data */
 				/* initialize data block */
       status.flags = status.messages = status.recent = status.unseen =
-	status.uidnext = status.uidvalidity = 0;
+	status.uidnext = status.uidvalidity = status.highestmodseq = 0;
       while (*txt && (s = strchr (txt,' '))) {
 	*s++ = '\0';		/* tie off status attribute name */
 				/* get attribute value */
@@ -3987,6 +4008,10 @@ void imap_parse_unsolicited (MAILSTREAM *stream,IMAPPARSEDREPLY *reply)
 	else if (!compare_cstring (txt,"UIDVALIDITY")) {
 	  status.flags |= SA_UIDVALIDITY;
 	  status.uidvalidity = i;
+	}
+	else if (!compare_cstring (txt,"HIGHESTMODSEQ")) {
+	  status.flags |= SA_HIGHESTMODSEQ;
+	  status.highestmodseq = i;
 	}
 				/* next attribute */
 	txt = (*s == ' ') ? s + 1 : s;
@@ -5553,6 +5578,8 @@ void imap_parse_capabilities (MAILSTREAM *stream,char *t)
 	thread->next = LOCAL->cap.threader;
 	LOCAL->cap.threader = thread;
       }
+      else if (!compare_cstring (t,"COMPRESS") &&
+	       !compare_cstring (s,"DEFLATE")) LOCAL->cap.deflate = T;
       else if (!compare_cstring (t,"AUTH")) {
 	if ((i = mail_lookup_auth_name (s,LOCAL->authflags)) &&
 	    (--i < MAXAUTHENTICATORS)) LOCAL->cap.auth |= (1 << i);
@@ -86,6 +86,7 @@ typedef struct imap_cap {
   unsigned int condstore : 1;	/* server has CONDSTORE (RFC 4551) */
   unsigned int esearch : 1;	/* server has ESEARCH (RFC 4731) */
   unsigned int within : 1;	/* server has WITHIN (RFC 5032) */
+  unsigned int deflate : 1;	/* server has COMPRESS=DEFLATE (RFC 4978) */
   unsigned int extlevel;	/* extension data level supported by server */
 				/* supported authenticators */
   unsigned int auth : MAXAUTHENTICATORS;
@@ -246,6 +247,11 @@ typedef struct imap_cap {
 /* Has WITHIN extension */
 
 #define LEVELWITHIN(stream) imap_cap (stream)->within
+
+
+/* Has COMPRESS=DEFLATE extension */
+
+#define LEVELDEFLATE(stream) imap_cap (stream)->deflate
 
 /* Body structure extension levels */
 
@@ -94,6 +94,8 @@ static freebodysparep_t mailfreebodysparep = NIL;
 static freestreamsparep_t mailfreestreamsparep = NIL;
 				/* SSL start routine */
 static sslstart_t mailsslstart = NIL;
+				/* network compression start routine */
+static netdeflate_t mailnetdeflate = NIL;
 				/* SSL certificate query */
 static sslcertificatequery_t mailsslcertificatequery = NIL;
 				/* SSL client certificate */
@@ -163,7 +165,9 @@ void *mm_cache (MAILSTREAM *stream,unsigned long msgno,long op)
 				/* is existing cache size large neough */
     else if (msgno > stream->cachesize) {
       i = stream->cachesize;	/* remember old size */
-      n = (stream->cachesize = msgno + CACHEINCREMENT) * sizeof (void *);
+				/* grow geometrically */
+      n = (stream->cachesize = msgno + max (CACHEINCREMENT,msgno >> 1)) *
+	sizeof (void *);
       fs_resize ((void **) &stream->cache,n);
       fs_resize ((void **) &stream->sc,n);
       while (i < stream->cachesize) {
@@ -189,24 +193,7 @@ void *mm_cache (MAILSTREAM *stream,unsigned long msgno,long op)
     mail_free_elt (&stream->cache[msgno - 1]);
     break;
   case CH_FREESORTCACHE:
-    if (stream->sc[msgno - 1]) {
-      if (stream->sc[msgno - 1]->from)
-	fs_give ((void **) &stream->sc[msgno - 1]->from);
-      if (stream->sc[msgno - 1]->to)
-	fs_give ((void **) &stream->sc[msgno - 1]->to);
-      if (stream->sc[msgno - 1]->cc)
-	fs_give ((void **) &stream->sc[msgno - 1]->cc);
-      if (stream->sc[msgno - 1]->subject)
-	fs_give ((void **) &stream->sc[msgno - 1]->subject);
-      if (stream->sc[msgno - 1]->unique &&
-	  (stream->sc[msgno - 1]->unique != stream->sc[msgno - 1]->message_id))
-	fs_give ((void **) &stream->sc[msgno - 1]->unique);
-      if (stream->sc[msgno - 1]->message_id)
-	fs_give ((void **) &stream->sc[msgno - 1]->message_id);
-      if (stream->sc[msgno - 1]->references)
-	mail_free_stringlist (&stream->sc[msgno - 1]->references);
-      fs_give ((void **) &stream->sc[msgno - 1]);
-    }
+    mail_free_sortcache (&stream->sc[msgno - 1]);
     break;
   case CH_EXPUNGE:		/* expunge cache slot */
     for (i = msgno - 1; msgno < stream->nmsgs; i++,msgno++) {
@@ -223,6 +210,199 @@ void *mm_cache (MAILSTREAM *stream,unsigned long msgno,long op)
   }
   return ret;
 }
+
+/* Slab mail cache handler
+ * Accepts: pointer to cache handle
+ *	    message number
+ *	    caching function
+ * Returns: cache data
+ *
+ * Unlike mm_cache(), elts are allocated a slab at a time, and an expunge
+ * leaves a gap in the cache arrays at the expunged slot instead of shifting
+ * the remainder of the cache down.  Expunging a run of messages in order
+ * thus moves each cache slot at most once.  The message number of an elt
+ * beyond the gap is brought up to date when it is next returned, and the
+ * gap is closed in a single pass when the cache is resized or flushed.
+ * A slab with an elt still held elsewhere when the cache is flushed is kept
+ * on a list of held slabs, and freed by a later flush once it is released.
+ */
+
+#define CACHESLABELTS 256	/* number of elts in a cache slab */
+
+typedef struct cache_slab {
+  struct cache_slab *next;	/* next (older) slab */
+  MESSAGECACHE elt[CACHESLABELTS];
+} CACHESLAB;
+
+typedef struct cache_arena {
+  CACHESLAB *slab;		/* most recent slab */
+  unsigned long used;		/* elts used in most recent slab */
+  MESSAGECACHE *free;		/* free elts, chained by sparep */
+  unsigned long gap;		/* cache slot at start of expunge gap */
+  unsigned long gapsize;	/* number of slots in expunge gap */
+} CACHEARENA;
+
+				/* slabs with elts held after cache flush */
+static CACHESLAB *mailheldslabs = NIL;
+
+				/* cache slot of message number */
+#define CACHESLOT(arena,msgno) ((((arena) && (arena)->gapsize && \
+  ((msgno) > (arena)->gap)) ? (arena)->gapsize : 0) + (msgno) - 1)
+
+void *mm_cache_slab (MAILSTREAM *stream,unsigned long msgno,long op)
+{
+  size_t n;
+  void *ret = NIL;
+  unsigned long i,j;
+  MESSAGECACHE *elt;
+  CACHESLAB *slab,**held;
+  CACHEARENA *arena = (CACHEARENA *) stream->private.cache;
+  switch ((int) op) {		/* what function? */
+  case CH_INIT:			/* initialize cache */
+    if (stream->cache) {	/* flush old cache contents */
+      mail_cache_slab_close (stream);
+      for (i = 0; i < stream->cachesize; ++i) {
+	mail_free_elt (&stream->cache[i]);
+	mail_free_sortcache (&stream->sc[i]);
+      }
+      fs_give ((void **) &stream->cache);
+      fs_give ((void **) &stream->sc);
+      stream->nmsgs = 0;	/* can't have any messages now */
+    }
+    if (arena) {		/* flush slabs */
+      while (slab = arena->slab) {
+	arena->slab = slab->next;
+	slab->next = mailheldslabs;
+	mailheldslabs = slab;
+      }
+      fs_give ((void **) &stream->private.cache);
+    }
+				/* free slabs no longer referenced */
+    for (held = &mailheldslabs; slab = *held;) {
+      for (i = 0; (i < CACHESLABELTS) && !slab->elt[i].lockcount; ++i);
+      if (i < CACHESLABELTS) held = &slab->next;
+      else {			/* no elt held, slab can go */
+	*held = slab->next;
+	fs_give ((void **) &slab);
+      }
+    }
+    break;
+  case CH_SIZE:			/* (re-)size the cache */
+    mail_cache_slab_close (stream);
+    if (!stream->cache)	{	/* have a cache already? */
+				/* no, create new cache */
+      n = (stream->cachesize = msgno + CACHEINCREMENT) * sizeof (void *);
+      stream->cache = (MESSAGECACHE **) memset (fs_get (n),0,n);
+      stream->sc = (SORTCACHE **) memset (fs_get (n),0,n);
+    }
+				/* is existing cache size large neough */
+    else if (msgno > stream->cachesize) {
+      i = stream->cachesize;	/* remember old size */
+				/* grow geometrically */
+      n = (stream->cachesize = msgno + max (CACHEINCREMENT,msgno >> 1)) *
+	sizeof (void *);
+      fs_resize ((void **) &stream->cache,n);
+      fs_resize ((void **) &stream->sc,n);
+      while (i < stream->cachesize) {
+	stream->cache[i] = NIL;
+	stream->sc[i++] = NIL;
+      }
+    }
+    break;
+
+  case CH_MAKEELT:		/* return elt, make if necessary */
+    if (!stream->cache[i = CACHESLOT (arena,msgno)]) {
+      if (!arena) stream->private.cache = (void *) (arena = (CACHEARENA *)
+	memset (fs_get (sizeof (CACHEARENA)),0,sizeof (CACHEARENA)));
+				/* reuse a free elt if possible */
+      if (elt = arena->free) arena->free = (MESSAGECACHE *) elt->sparep;
+      else {			/* else take next elt from slab */
+	if (!arena->slab || (arena->used == CACHESLABELTS)) {
+	  slab = (CACHESLAB *) memset (fs_get (sizeof (CACHESLAB)),0,
+				       sizeof (CACHESLAB));
+	  slab->next = arena->slab;
+	  arena->slab = slab;
+	  arena->used = 0;
+	}
+	elt = &arena->slab->elt[arena->used++];
+      }
+      memset (elt,0,sizeof (MESSAGECACHE));
+      elt->lockcount = 1;	/* initially only cache references it */
+      elt->private.slab = T;	/* note elt is in a slab */
+      stream->cache[i] = elt;
+    }
+				/* falls through */
+  case CH_ELT:			/* return elt */
+    if (elt = stream->cache[CACHESLOT (arena,msgno)])
+      elt->msgno = msgno;	/* make sure message number is current */
+    ret = (void *) elt;
+    break;
+  case CH_SORTCACHE:		/* return sortcache entry, make if needed */
+    if (!stream->sc[i = CACHESLOT (arena,msgno)]) stream->sc[i] =
+      (SORTCACHE *) memset (fs_get (sizeof (SORTCACHE)),0,sizeof (SORTCACHE));
+    ret = (void *) stream->sc[i];
+    break;
+  case CH_FREE:			/* free elt */
+    if (elt = stream->cache[i = CACHESLOT (arena,msgno)]) {
+      mail_free_elt (&stream->cache[i]);
+      if (!elt->lockcount) {	/* put on free list if no other references */
+	elt->sparep = (void *) arena->free;
+	arena->free = elt;
+      }
+    }
+    break;
+  case CH_FREESORTCACHE:
+    mail_free_sortcache (&stream->sc[CACHESLOT (arena,msgno)]);
+    break;
+  case CH_EXPUNGE:		/* expunge cache slot */
+    if (!arena) stream->private.cache = (void *) (arena = (CACHEARENA *)
+      memset (fs_get (sizeof (CACHEARENA)),0,sizeof (CACHEARENA)));
+    i = msgno - 1;		/* slot being expunged */
+    if (!arena->gapsize);	/* no gap yet, start one here */
+    else if (i > arena->gap)	/* move gap up */
+      for (j = arena->gap; j < i; ++j) {
+	if (stream->cache[j] = stream->cache[j + arena->gapsize])
+	  stream->cache[j]->msgno = j + 1;
+	stream->sc[j] = stream->sc[j + arena->gapsize];
+      }
+    else for (j = arena->gap; j > i;) {
+      --j;			/* move gap down */
+      stream->cache[j + arena->gapsize] = stream->cache[j];
+      stream->sc[j + arena->gapsize] = stream->sc[j];
+    }
+    arena->gap = i;		/* expunged slot joins the gap */
+    stream->cache[i + arena->gapsize] = NIL;
+    stream->sc[i + arena->gapsize++] = NIL;
+    break;
+  default:
+    fatal ("Bad mm_cache_slab op");
+    break;
+  }
+  return ret;
+}
+
+
+/* Slab mail cache close expunge gap
+ * Accepts: mail stream
+ */
+
+void mail_cache_slab_close (MAILSTREAM *stream)
+{
+  unsigned long i,j;
+  CACHEARENA *arena = (CACHEARENA *) stream->private.cache;
+  if (arena && arena->gapsize) {
+    for (i = arena->gap, j = i + arena->gapsize; j < stream->cachesize;
+	 ++i,++j) {
+      if (stream->cache[i] = stream->cache[j]) stream->cache[i]->msgno = i + 1;
+      stream->sc[i] = stream->sc[j];
+    }
+    while (i < stream->cachesize) {
+      stream->cache[i] = NIL;	/* top of cache goes away */
+      stream->sc[i++] = NIL;
+    }
+    arena->gapsize = 0;		/* no more gap */
+  }
+}
 
 /* Dummy string driver for complete in-memory strings */
 
@@ -520,6 +700,11 @@ void *mail_parameters (MAILSTREAM *stream,long function,void *value)
   case GET_SSLSTART:
     ret = (void *) mailsslstart;
     break;
+  case SET_NETDEFLATE:
+    mailnetdeflate = (netdeflate_t) value;
+  case GET_NETDEFLATE:
+    ret = (void *) mailnetdeflate;
+    break;
   case SET_SSLCERTIFICATEQUERY:
     mailsslcertificatequery = (sslcertificatequery_t) value;
   case GET_SSLCERTIFICATEQUERY:
@@ -1177,6 +1362,9 @@ long mail_status_default (MAILSTREAM *stream,char *mbx,long flags)
       if (!mail_elt (stream,i)->seen) status.unseen++;
   status.uidnext = stream->uid_last + 1;
   status.uidvalidity = stream->uid_validity;
+				/* zero if driver doesn't do modsequences */
+  status.highestmodseq = (unsigned long)
+    mail_parameters (stream,GET_HIGHESTMODSEQ,(void *) stream);
   MM_STATUS(stream,mbx,&status);/* pass status to main program */
   if (tstream) mail_close (tstream);
   return T;			/* success */
@@ -1361,6 +1549,7 @@ MAILSTREAM *mail_close_full (MAILSTREAM *stream,long options)
     if (stream->original_mailbox)
       fs_give ((void **) &stream->original_mailbox);
     if (stream->snarf.name) fs_give ((void **) &stream->snarf.name);
+    msearch_destroy ((MSEARCH **) &stream->private.search.automata);
     stream->sequence++;		/* invalidate sequence */
 				/* flush user flags */
     for (i = 0; i < NUSERFLAGS; i++)
@@ -2369,6 +2558,8 @@ long mail_search_full (MAILSTREAM *stream,char *charset,SEARCHPGM *pgm,
   if (pgm && stream->dtb)	/* must have a search program and driver */
     ret = (*(stream->dtb->search ? stream->dtb->search : mail_search_default))
       (stream,charset,pgm,flags);
+				/* flush automata made by this search */
+  msearch_destroy ((MSEARCH **) &stream->private.search.automata);
 				/* flush search program if requested */
   if (flags & SE_FREE) mail_free_searchpgm (&pgm);
   return ret;
@@ -2500,6 +2691,21 @@ void mail_check (MAILSTREAM *stream)
 }
 
 
+/* Mail watch mailbox
+ * Accepts: mail stream
+ * Returns: descriptor which becomes readable when the mailbox changes, or -1
+ *
+ * Change notifications already pending are discarded, so call this before
+ * pinging the mailbox.
+ */
+
+int mail_watch (MAILSTREAM *stream)
+{
+  return (stream && stream->dtb && stream->dtb->watch) ?
+    (*stream->dtb->watch) (stream) : -1;
+}
+
+
 /* Mail expunge mailbox
  * Accepts: mail stream
  *	    sequence to expunge if non-NIL
@@ -3481,6 +3687,8 @@ long mail_search_msg (MAILSTREAM *stream,unsigned long msgno,char *section,
 				/* size ranges */
   if ((pgm->larger && (elt->rfc822_size <= pgm->larger)) ||
       (pgm->smaller && (elt->rfc822_size >= pgm->smaller))) return NIL;
+				/* modification sequence */
+  if (pgm->modseq && (elt->private.mod < pgm->modseq)) return NIL;
 				/* message flags */
   if ((pgm->answered && !elt->answered) ||
       (pgm->unanswered && elt->answered) ||
@@ -3671,8 +3879,13 @@ long mail_search_text (MAILSTREAM *stream,unsigned long msgno,char *section,
   BODY *body;
   long ret = NIL;
   STRINGLIST *s = mail_newstringlist ();
+  MSEARCH **ms = (MSEARCH **) &stream->private.search.automata;
   mailgets_t omg = mailgets;
   if (stream->dtb->flags & DR_LOWMEM) mailgets = mail_search_gets;
+				/* find or make automaton for these strings */
+  while (*ms && !msearch_pattern (*ms,st)) ms = &(*ms)->next;
+  if (stream->private.search.match = *ms ? *ms : (*ms = msearch_create (st)))
+    stream->private.search.want = (*ms)->all;
 				/* strings to search */
   for (stream->private.search.string = s; st;) {
     s->text.data = st->text.data;
@@ -3685,7 +3898,7 @@ long mail_search_text (MAILSTREAM *stream,unsigned long msgno,char *section,
     s.data = (unsigned char *)
       mail_fetch_header (stream,msgno,section,NIL,&s.size,FT_INTERNAL|FT_PEEK);
     utf8_mime2text (&s,&t,U8T_CANONICAL);
-    ret = mail_search_string_work (&t,&stream->private.search.string);
+    ret = mail_search_keys_work (stream,&t);
     if (t.data != s.data) fs_give ((void **) &t.data);
   }
   if (!ret) {			/* still looking for match? */
@@ -3702,6 +3915,7 @@ long mail_search_text (MAILSTREAM *stream,unsigned long msgno,char *section,
   for (s = stream->private.search.string; s; s = s->next) s->text.data = NIL;
   mail_free_stringlist (&stream->private.search.string);
   stream->private.search.text = NIL;
+  stream->private.search.match = NIL;
   return ret;
 }
 
@@ -3734,7 +3948,7 @@ long mail_search_body (MAILSTREAM *stream,unsigned long msgno,BODY *body,
     else {
 				/* make UTF-8 version of header */
       utf8_mime2text (&st,&h,U8T_CANONICAL);
-      ret = mail_search_string_work (&h,&stream->private.search.string);
+      ret = mail_search_keys_work (stream,&h);
       if (h.data != st.data) fs_give ((void **) &h.data);
     }
   }
@@ -3755,7 +3969,7 @@ long mail_search_body (MAILSTREAM *stream,unsigned long msgno,BODY *body,
 	else {
 				/* make UTF-8 version of header */
 	  utf8_mime2text (&st,&h,U8T_CANONICAL);
-	  ret = mail_search_string_work (&h,&stream->private.search.string);
+	  ret = mail_search_keys_work (stream,&h);
 	  if (h.data != st.data) fs_give ((void **) &h.data);
 	}
       }
@@ -3774,31 +3988,177 @@ long mail_search_body (MAILSTREAM *stream,unsigned long msgno,BODY *body,
     else {
       for (t = NIL,param = body->parameter; param && !t; param = param->next)
 	if (!strcmp (param->attribute,"CHARSET")) t = param->value;
-      switch (body->encoding) {	/* what encoding? */
-      case ENCBASE64:
-	if (st.data = (unsigned char *)
-	    rfc822_base64 ((unsigned char *) s,i,&st.size)) {
-	  ret = mail_search_string (&st,t,&stream->private.search.string);
-	  fs_give ((void **) &st.data);
-	}
-	break;
-      case ENCQUOTEDPRINTABLE:
-	if (st.data = rfc822_qprint ((unsigned char *) s,i,&st.size)) {
-	  ret = mail_search_string (&st,t,&stream->private.search.string);
-	  fs_give ((void **) &st.data);
+      ret = mail_search_part (stream,(unsigned char *) s,i,body->encoding,t);
+    }
+    break;
+  }
+  return ret;
+}
+
+/* Mail search body text part
+ * Accepts: MAIL stream
+ *	    body part text
+ *	    size of body part text
+ *	    body part encoding
+ *	    character set of body part
+ * Returns: T if search found a match
+ *
+ * When there is a search automaton, the part is decoded, converted to
+ * UTF-8 and searched a piece at a time, so that memory use is bounded by
+ * the piece size rather than the part size.  Only an incomplete UTF-8
+ * character at the end of a piece is carried over to the next, since the
+ * automaton state spans pieces.  Text in a multi-byte character set can
+ * only be split safely at a line end, so a partial line is carried over
+ * instead; if it grows beyond the piece size the whole part is searched at
+ * once.  Decoding stops once every search string is found.
+ */
+
+#define SEARCHPIECE 16384	/* minimum size of body text piece */
+				/* BASE64 alphabet character */
+#define isb64(c) (isalnum (c) || ((c) == '+') || ((c) == '/') || ((c) == '='))
+
+long mail_search_part (MAILSTREAM *stream,unsigned char *s,unsigned long i,
+		       unsigned short encoding,char *charset)
+{
+  unsigned long j,k;
+  unsigned int state = 0;
+  unsigned char *t,*e,*buf;
+  SIZEDTEXT st,c,u;
+  MSEARCH *ms = (MSEARCH *) stream->private.search.match;
+  const CHARSET *cs = charset ? utf8_charset (charset) : NIL;
+				/* split at line ends if multi-byte */
+  long lines = cs && (cs->type >= CT_EUC) && (cs->type != CT_UTF8);
+				/* can't split 16 or 32-bit text */
+  if (!ms || (cs && ((cs->type == CT_UCS2) || (cs->type == CT_UCS4) ||
+		     (cs->type == CT_UTF16))))
+    return mail_search_whole (stream,s,i,encoding,charset);
+  for (c.data = NIL,c.size = 0,e = s + i;
+       (s < e) && stream->private.search.want; s = t) {
+    t = mail_search_cut (s,e,encoding);
+    switch (encoding) {		/* decode this piece */
+    case ENCBASE64:
+      st.data = buf = (unsigned char *) rfc822_base64 (s,t - s,&st.size);
+      break;
+    case ENCQUOTEDPRINTABLE:
+      st.data = buf = rfc822_qprint (s,t - s,&st.size);
+      break;
+    default:			/* no decoding needed */
+      buf = NIL;
+      st.data = s;
+      st.size = t - s;
+      break;
+    }
+    if (!st.data) break;	/* decoding failed */
+    if (c.size) {		/* prepend text carried over */
+      fs_resize ((void **) &c.data,c.size + st.size);
+      memcpy (c.data + c.size,st.data,st.size);
+      if (buf) fs_give ((void **) &buf);
+      st.data = buf = c.data;
+      st.size += c.size;
+      c.data = NIL;
+      c.size = 0;
+    }
+    if (t < e) {		/* carry split character unless at end */
+      if (lines) {		/* back up to the last line end */
+	for (k = st.size; k && (st.data[k - 1] != '\012'); --k);
+				/* line too long, search whole part */
+	if ((st.size - k) > SEARCHPIECE) {
+	  if (buf) fs_give ((void **) &buf);
+	  return mail_search_whole (stream,e - i,i,encoding,charset);
 	}
-	break;
-      default:
-	st.data = (unsigned char *) s;
-	st.size = i;
-	ret = mail_search_string (&st,t,&stream->private.search.string);
-	break;
       }
+      else {			/* back up over UTF-8 continuation bytes */
+	for (k = j = st.size; j && ((k - j) < 3) &&
+	       ((st.data[j - 1] & 0xc0) == 0x80); --j);
+				/* lead byte of incomplete character? */
+	if (j-- && ((st.data[j] & 0xc0) == 0xc0) &&
+	    ((k - j) < ((st.data[j] >= 0xf0) ? 4 :
+			(st.data[j] >= 0xe0) ? 3 : 2))) k = j;
+      }
+      if (c.size = st.size - k)
+	memcpy (c.data = (unsigned char *) fs_get (c.size),st.data + k,c.size);
+      st.size = k;
+    }
+    if (st.size) {		/* convert to UTF-8 as best we can */
+      if (!utf8_text (&st,charset,&u,U8T_CANONICAL))
+	utf8_text (&st,NIL,&u,U8T_CANONICAL);
+      stream->private.search.want =
+	msearch (ms,u.data,u.size,stream->private.search.want,&state);
+      if (u.data != st.data) fs_give ((void **) &u.data);
+    }
+    if (buf) fs_give ((void **) &buf);
+  }
+  if (c.data) fs_give ((void **) &c.data);
+  return stream->private.search.want ? NIL : LONGT;
+}
+
+
+/* Mail search body text part all at once
+ * Accepts: MAIL stream
+ *	    body part text
+ *	    size of body part text
+ *	    body part encoding
+ *	    character set of body part
+ * Returns: T if search found a match
+ */
+
+long mail_search_whole (MAILSTREAM *stream,unsigned char *s,unsigned long i,
+			unsigned short encoding,char *charset)
+{
+  SIZEDTEXT st;
+  long ret = NIL;
+  switch (encoding) {		/* what encoding? */
+  case ENCBASE64:
+    if (st.data = (unsigned char *) rfc822_base64 (s,i,&st.size)) {
+      ret = mail_search_keys (stream,&st,charset);
+      fs_give ((void **) &st.data);
+    }
+    break;
+  case ENCQUOTEDPRINTABLE:
+    if (st.data = rfc822_qprint (s,i,&st.size)) {
+      ret = mail_search_keys (stream,&st,charset);
+      fs_give ((void **) &st.data);
     }
     break;
+  default:
+    st.data = s;
+    st.size = i;
+    ret = mail_search_keys (stream,&st,charset);
+    break;
   }
   return ret;
 }
+
+
+/* Mail search find end of body text piece
+ * Accepts: start of piece
+ *	    end of body text
+ *	    body part encoding
+ * Returns: end of piece
+ *
+ * A piece ends at the first line end after SEARCHPIECE bytes, so that
+ * no encoded character is split.  A BASE64 piece must also hold a whole
+ * number of quanta.
+ */
+
+unsigned char *mail_search_cut (unsigned char *s,unsigned char *e,
+				unsigned short encoding)
+{
+  unsigned long n = 0;
+  unsigned char *t = s + SEARCHPIECE;
+  if ((e - s) <= SEARCHPIECE) return e;
+  if (encoding == ENCBASE64)	/* count BASE64 characters so far */
+    for (t = s; t < s + SEARCHPIECE; ++t) if (isb64 (*t)) ++n;
+  while (t < e) switch (*t++) {
+  case '\012':			/* line end, at quantum boundary? */
+    if (!(n & 3)) return t;
+    break;
+  default:
+    if ((encoding == ENCBASE64) && isb64 (t[-1])) ++n;
+    break;
+  }
+  return e;
+}
 
 /* Mail search text
  * Accepts: sized text to search
@@ -3841,6 +4201,44 @@ long mail_search_string_work (SIZEDTEXT *s,STRINGLIST **st)
   }
   return *st ? NIL : LONGT;
 }
+
+/* Mail search text for search strings
+ * Accepts: MAIL stream
+ *	    sized text to search
+ *	    character set of sized text
+ * Returns: T if search found a match
+ */
+
+long mail_search_keys (MAILSTREAM *stream,SIZEDTEXT *s,char *charset)
+{
+  SIZEDTEXT u;
+  long ret;
+				/* convert to UTF-8 as best we can */
+  if (!utf8_text (s,charset,&u,U8T_CANONICAL))
+    utf8_text (s,NIL,&u,U8T_CANONICAL);
+  ret = mail_search_keys_work (stream,&u);
+  if (u.data != s->data) fs_give ((void **) &u.data);
+  return ret;
+}
+
+
+/* Mail search text for search strings worker routine
+ * Accepts: MAIL stream
+ *	    sized text to search
+ * Returns: T if search found a match
+ *
+ * The text is scanned once for all of the strings not yet found, using the
+ * search automaton if there is one.
+ */
+
+long mail_search_keys_work (MAILSTREAM *stream,SIZEDTEXT *s)
+{
+  MSEARCH *ms = (MSEARCH *) stream->private.search.match;
+  if (!ms) return mail_search_string_work (s,&stream->private.search.string);
+  return (stream->private.search.want =
+	  msearch (ms,s->data,s->size,stream->private.search.want,NIL)) ?
+    NIL : LONGT;
+}
 
 
 /* Mail search keyword
@@ -3953,14 +4351,14 @@ char *mail_search_gets (readfn_t f,void *stream,unsigned long size,
 				/* read first buffer */
   (*f) (stream,st.size = i = min (size,(long) MAILTMPLEN),tmp);
 				/* search for text */
-  if (mail_search_string (&st,NIL,&md->stream->private.search.string))
+  if (mail_search_keys (md->stream,&st,NIL))
     md->stream->private.search.result = T;
   else if (size -= i) {		/* more to do, blat slop down */
     memmove (tmp,tmp+MAILTMPLEN-SEARCHSLOP,(size_t) SEARCHSLOP);
     do {			/* read subsequent buffers one at a time */
       (*f) (stream,i = min (size,(long) MAILTMPLEN),tmp+SEARCHSLOP);
       st.size = i + SEARCHSLOP;
-      if (mail_search_string (&st,NIL,&md->stream->private.search.string))
+      if (mail_search_keys (md->stream,&st,NIL))
 	md->stream->private.search.result = T;
       else memmove (tmp,tmp+MAILTMPLEN,(size_t) SEARCHSLOP);
     }
@@ -4265,7 +4663,7 @@ unsigned long *mail_sort_cache (MAILSTREAM *stream,SORTPGM *pgm,SORTCACHE **sc,
 {
   unsigned long i,*ret;
 				/* pass 3: sort messages */
-  qsort ((void *) sc,pgm->nmsgs,sizeof (SORTCACHE *),mail_sort_compare);
+  if (pgm->nmsgs > 1) mail_sort_keys (sc,pgm->nmsgs,pgm);
 				/* optional post sorting */
   if (pgm->postsort) (*pgm->postsort) ((void *) sc);
 				/* pass 4: return results */
@@ -4277,6 +4675,173 @@ unsigned long *mail_sort_cache (MAILSTREAM *stream,SORTPGM *pgm,SORTCACHE **sc,
   return ret;
 }
 
+/* Mail sort key prefix
+ *
+ * Each message's sort program keys are packed into a fixed-width byte
+ * string which orders the same way as mail_sort_compare() so far as it
+ * goes.  A numeric key is the big-endian value in as many bytes as the
+ * largest value of that key needs, and a string key is a 1 byte followed
+ * by the string and a 0 byte, or just a 0 byte for a missing string.  A
+ * reversed key has its bytes complemented.  The message number follows the
+ * keys if there is room.  The packed keys are sorted by radix sort, and
+ * only messages whose packed keys are identical are compared with
+ * mail_sort_compare().
+ */
+
+#define SORTKEYLEN 24		/* length of packed sort key */
+
+typedef struct sort_key {
+  unsigned char key[SORTKEYLEN];/* packed sort key */
+  SORTCACHE *sc;		/* sortcache entry */
+} SORTKEY;
+
+
+/* Mail sort sortcache vector by packed keys
+ * Accepts: sortcache vector
+ *	    number of entries in vector
+ *	    sort program
+ */
+
+void mail_sort_keys (SORTCACHE **sc,unsigned long nmsgs,SORTPGM *pgm)
+{
+  unsigned long i,j,k,v,*count;
+  unsigned long len = 0;
+  int *width;
+  SORTPGM *pg;
+  SORTKEY *keys,*tmp,*src,*dst,*swap;
+				/* one more for message number */
+  for (j = 1,pg = pgm; pg; pg = pg->next) ++j;
+  width = (int *) memset (fs_get (j * sizeof (int)),0,j * sizeof (int));
+  for (i = 0,v = 0; i < nmsgs; ++i) v |= sc[i]->num;
+  for (--j; v; v >>= 8) ++width[j];
+				/* bytes needed by each numeric key */
+  for (pg = pgm,j = 0; pg; pg = pg->next,++j) {
+    for (i = 0,v = 0; i < nmsgs; ++i) switch (pg->function) {
+    case SORTDATE:
+      v |= sc[i]->date;
+      break;
+    case SORTARRIVAL:
+      v |= sc[i]->arrival;
+      break;
+    case SORTSIZE:
+      v |= sc[i]->size;
+      break;
+    }
+    for (; v; v >>= 8) ++width[j];
+  }
+  keys = (SORTKEY *) fs_get (nmsgs * sizeof (SORTKEY));
+  tmp = (SORTKEY *) fs_get (nmsgs * sizeof (SORTKEY));
+  for (i = 0; i < nmsgs; ++i) {	/* pack the keys */
+    keys[i].sc = sc[i];
+    len = max (len,mail_sort_key (keys[i].key,sc[i],pgm,width));
+  }
+				/* count all key bytes in one pass */
+  i = len * 256 * sizeof (unsigned long);
+  count = (unsigned long *) memset (fs_get (i),0,i);
+  for (i = 0; i < nmsgs; ++i) for (j = 0; j < len; ++j)
+    ++count[(j << 8) + keys[i].key[j]];
+				/* least significant byte first radix sort */
+  for (src = keys,dst = tmp; len--; ) {
+    unsigned long *c = count + (len << 8);
+				/* skip byte if all the same */
+    if (c[src->key[len]] == nmsgs) continue;
+    for (i = 0,j = 0; i < 256; ++i) {
+      k = c[i];
+      c[i] = j;
+      j += k;
+    }
+    for (i = 0; i < nmsgs; ++i) dst[c[src[i].key[len]]++] = src[i];
+    swap = src;			/* sorted data now in destination */
+    src = dst;
+    dst = swap;
+  }
+				/* compare runs of identical keys */
+  for (i = 0; i < nmsgs; i = j) {
+    for (j = i + 1; (j < nmsgs) && !memcmp (src[i].key,src[j].key,SORTKEYLEN);
+	 ++j);
+    if ((j - i) > 1)
+      qsort ((void *) (src + i),j - i,sizeof (SORTKEY),mail_sort_key_compare);
+  }
+  for (i = 0; i < nmsgs; ++i) {	/* return sorted sortcache vector */
+    sc[i] = src[i].sc;
+    sc[i]->sorted = T;
+  }
+  pgm->progress.sorted = nmsgs;	/* all messages sorted */
+  fs_give ((void **) &keys);
+  fs_give ((void **) &tmp);
+  fs_give ((void **) &count);
+  fs_give ((void **) &width);
+}
+
+
+/* Mail pack sort key
+ * Accepts: packed key buffer
+ *	    sortcache entry
+ *	    sort program
+ *	    bytes needed by each numeric key, then by message number
+ * Returns: length of packed key
+ */
+
+unsigned long mail_sort_key (unsigned char *key,SORTCACHE *sc,SORTPGM *pgm,
+			     int *width)
+{
+  int i;
+  unsigned long v;
+  unsigned char x,*s;
+  unsigned char *k = key;
+  unsigned char *end = key + SORTKEYLEN;
+  memset (key,0,SORTKEYLEN);
+  for (; pgm && (k < end); pgm = pgm->next,++width) {
+    x = pgm->reverse ? 0xff : 0;/* complement bytes if reversed */
+    s = NIL;
+    switch (pgm->function) {
+    case SORTDATE:		/* numeric keys */
+    case SORTARRIVAL:
+    case SORTSIZE:
+      v = (pgm->function == SORTDATE) ? sc->date :
+	((pgm->function == SORTARRIVAL) ? sc->arrival : sc->size);
+      for (i = *width; i-- && (k < end); ) *k++ = ((v >> (i * 8)) & 0xff) ^ x;
+      continue;
+    case SORTFROM:		/* string keys */
+      s = (unsigned char *) sc->from;
+      break;
+    case SORTTO:
+      s = (unsigned char *) sc->to;
+      break;
+    case SORTCC:
+      s = (unsigned char *) sc->cc;
+      break;
+    case SORTSUBJECT:
+      s = (unsigned char *) sc->subject;
+      break;
+    default:			/* unknown keys compare equal */
+      continue;
+    }
+    if (s) {			/* string present */
+      *k++ = 1 ^ x;
+      while (*s && (k < end)) *k++ = *s++ ^ x;
+    }
+    if (k < end) *k++ = x;	/* tie off string */
+  }
+				/* message number breaks ties */
+  if (!pgm) for (i = *width; i-- && (k < end); )
+    *k++ = (sc->num >> (i * 8)) & 0xff;
+  return k - key;
+}
+
+
+/* Mail compare packed sort keys
+ * Accepts: first packed key
+ *	    second packed key
+ * Returns: -1 if a1 < a2, 0 if a1 == a2, 1 if a1 > a2
+ */
+
+int mail_sort_key_compare (const void *a1,const void *a2)
+{
+  return mail_sort_compare ((void *) &((SORTKEY *) a1)->sc,
+			    (void *) &((SORTKEY *) a2)->sc);
+}
+
 /* Mail load sortcache
  * Accepts: mail stream, already searched
  *	    sort program
@@ -4865,6 +5430,34 @@ THREADNODE *mail_thread_orderedsubject (MAILSTREAM *stream,char *charset,
 #define CHILD(data) ((container_t) (data)[3])
 #define SETCHILD(data,value) ((container_t) (data[3] = value))
 
+/*  The id_table is an open-addressing hash table of interned message-ids,
+ * which is kept on the stream so that a later THREAD need only intern the
+ * message-ids of messages which arrived since.  Entries are kept in order
+ * of interning, and the table slots hold entry indices so that the table
+ * can be probed without chasing chains.  The container of an entry is reset
+ * when it is first used by a pass; entries no pass has used recently are
+ * dropped when the table is next compacted.
+ */
+
+#define IDTABMIN 1024		/* minimum number of id_table slots */
+
+typedef struct id_entry {
+  char *name;			/* interned message-id */
+  unsigned long hash;		/* hash code of message-id */
+  unsigned long stamp;		/* last pass to use this entry */
+  void *data[THREADLINKS+1];	/* container */
+} IDENTRY;
+
+typedef struct id_table {
+  unsigned long size;		/* number of slots (a power of two) */
+  unsigned long *slot;		/* entry index + 1, or 0 if slot is empty */
+  unsigned long nent;		/* number of entries */
+  unsigned long maxent;		/* size of entry vector */
+  unsigned long live;		/* number of entries used this pass */
+  unsigned long stamp;		/* current pass */
+  IDENTRY *ent;			/* entry vector */
+} IDTABLE;
+
 THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
 				    SEARCHPGM *spg,long flags,sorter_t sorter)
 {
@@ -4872,15 +5465,15 @@ THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
   ENVELOPE *env;
   SORTCACHE *s;
   STRINGLIST *st;
-  HASHENT *he;
   THREADNODE **tc,*cur,*lst,*nxt,*sis,*msg;
   container_t con,nxc,prc,sib;
+  IDTABLE *idt;
   void **sub;
   char *t,tmp[MAILTMPLEN];
   unsigned long j,nmsgs;
   unsigned long i = stream->nmsgs * sizeof (SORTCACHE *);
   SORTCACHE **sc = (SORTCACHE **) memset (fs_get ((size_t) i),0,(size_t) i);
-  HASHTAB *ht = hash_create (REFHASHSIZE);
+  HASHTAB *ht;
   THREADNODE *root = NIL;
   if (spg) {			/* only if a search needs to be done */
     int silent = stream->silent;
@@ -4890,6 +5483,7 @@ THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
     stream->silent = silent;	/* restore silence state */
   }
 
+  mail_thread_id_pass (stream);/* start new pass over message-id table */
 				/* create SORTCACHE vector of requested msgs */
   for (i = 1, nmsgs = 0; i <= stream->nmsgs; ++i)
     if (mail_elt (stream,i)->searched)
@@ -4949,18 +5543,21 @@ THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
     if (s->unique && (s->unique != s->message_id))
       fs_give ((void **) &s->unique);
     s->unique = s->message_id ?	/* don't permit Message ID duplicates */
-      (hash_lookup (ht,s->message_id) ? cpystr (tmp) : s->message_id) :
-	(s->message_id = cpystr (tmp));
-				/* add unique string to hash table */
-    hash_add (ht,s->unique,s,THREADLINKS);
+      (((sub = mail_thread_id (stream,s->message_id,NIL)) && CACHE (sub)) ?
+       cpystr (tmp) : s->message_id) : (s->message_id = cpystr (tmp));
+				/* add unique string to message-id table */
+    mail_thread_id (stream,s->unique,T)[0] = (void *) s;
+				/* intern references so containers stay put */
+    for (st = s->references; st && st->text.data; st = st->next)
+      mail_thread_id (stream,(char *) st->text.data,T);
   }
 			/* Step 1 */
   for (i = 0; i < nmsgs; ++i) {	/* for each message in sortcache */
 			/* Step 1A */
     if ((st = (s = sc[i])->references) && st->text.data)
-      for (con = hash_lookup_and_add (ht,(char *) st->text.data,NIL,
-				      THREADLINKS); st = st->next; con = nxc) {
-	nxc = hash_lookup_and_add (ht,(char *) st->text.data,NIL,THREADLINKS);
+      for (con = mail_thread_id (stream,(char *) st->text.data,T);
+	   st = st->next; con = nxc) {
+	nxc = mail_thread_id (stream,(char *) st->text.data,T);
 				/* only if no parent & won't introduce loop */
 	if (!PARENT (nxc) && !mail_thread_check_child (con,nxc)) {
 	  SETPARENT (nxc,con);	/* establish parent/child link */
@@ -4971,7 +5568,7 @@ THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
       }
     else con = NIL;		/* else message has no ancestors */
 			/* Step 1B */
-    if ((prc = PARENT ((nxc = hash_lookup (ht,s->unique)))) &&
+    if ((prc = PARENT ((nxc = mail_thread_id (stream,s->unique,NIL)))) &&
 	(prc != con)) {		/* break links if have a different parent */
       SETPARENT (nxc,NIL);	/* easy if direct child */
       if (nxc == CHILD (prc)) SETCHILD (prc,SIBLING (nxc));
@@ -4998,19 +5595,19 @@ THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
   fs_give ((void **) &sc);	/* finished with sortcache vector */
 
 			/* Step 2 */
-				/* search hash table for parentless messages */
-  for (i = 0, prc = con = NIL; i < ht->size; i++)
-    for (he = ht->table[i]; he; he = he->next)
-      if (!PARENT ((nxc = he->data))) {
+				/* search id table for parentless messages */
+  for (i = 0, prc = con = NIL, idt = (IDTABLE *) stream->private.idtab;
+       i < idt->nent; i++)
+    if ((idt->ent[i].stamp == idt->stamp) &&
+	!PARENT ((nxc = idt->ent[i].data))) {
 				/* sibling of previous parentless message */
-	if (con) con = SETSIBLING (con,nxc);
-	else prc = con = nxc;	/* first parentless message */
-      }
+      if (con) con = SETSIBLING (con,nxc);
+      else prc = con = nxc;	/* first parentless message */
+    }
   /*  Once the dummy containers are pruned, we no longer need the parent
-   * information, so we can convert the containers to THREADNODEs.  Since
-   * we don't need the id_table any more either, we can reset the hash table
-   * and reuse it as a subject_table.  Resetting the hash table will also
-   * destroy the containers.
+   * information, so we can convert the containers to THREADNODEs.  The
+   * containers stay in the id_table, and are reset when the message-id is
+   * next used by a later pass.
    */
 			/* Step 3 */
 				/* prune dummies, convert to threadnode */
@@ -5028,7 +5625,7 @@ THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
     root = tc[0];		/* establish new root */
   }
 			/* Step 5A */
-  hash_reset (ht);		/* discard containers, reset ht */
+  ht = hash_create (REFHASHSIZE);
 			/* Step 5B */
   for (cur = root; cur; cur = cur->branch)
     if ((t = (nxt = (cur->sc ? cur : cur->next))->sc->subject) && *t) {
@@ -5108,6 +5705,122 @@ THREADNODE *mail_thread_references (MAILSTREAM *stream,char *charset,
   return root;			/* return sorted list */
 }
 
+/* Mail thread message-id table pass
+ * Accepts: mail stream
+ *
+ * Compacts the table first if most of its entries are no longer used.
+ */
+
+void mail_thread_id_pass (MAILSTREAM *stream)
+{
+  unsigned long i,j;
+  IDTABLE *idt = (IDTABLE *) stream->private.idtab;
+  if (!idt) {			/* instantiate table if first pass */
+    idt = (IDTABLE *) memset (fs_get (sizeof (IDTABLE)),0,sizeof (IDTABLE));
+    stream->private.idtab = (void *) idt;
+    mail_thread_id_rehash (idt,IDTABMIN);
+  }
+				/* mostly stale entries? */
+  else if ((idt->nent > IDTABMIN) && ((idt->nent - idt->live) > idt->live)) {
+    for (i = j = 0; i < idt->nent; ++i) {
+      if (idt->ent[i].stamp != idt->stamp)
+	fs_give ((void **) &idt->ent[i].name);
+      else if (i != j++) idt->ent[j - 1] = idt->ent[i];
+    }
+    idt->nent = j;		/* new number of entries */
+    for (i = IDTABMIN; i < (j * 2); i <<= 1);
+    mail_thread_id_rehash (idt,i);
+  }
+  idt->live = 0;		/* no entries used yet in new pass */
+  ++idt->stamp;
+}
+
+
+/* Mail thread message-id table rehash
+ * Accepts: message-id table
+ *	    new number of slots
+ */
+
+void mail_thread_id_rehash (void *table,unsigned long size)
+{
+  unsigned long i,j;
+  unsigned long mask = size - 1;
+  IDTABLE *idt = (IDTABLE *) table;
+  if (idt->slot) fs_give ((void **) &idt->slot);
+  idt->slot = (unsigned long *)
+    memset (fs_get (size * sizeof (unsigned long)),0,
+	    size * sizeof (unsigned long));
+  idt->size = size;
+  for (i = 0; i < idt->nent; ++i) {
+    for (j = idt->ent[i].hash & mask; idt->slot[j]; j = (j + 1) & mask);
+    idt->slot[j] = i + 1;
+  }
+}
+
+/* Mail thread message-id table lookup
+ * Accepts: mail stream
+ *	    message-id
+ *	    T to add if not used yet in this pass
+ * Returns: container of message-id, or NIL if not found
+ *
+ * Adding an entry may move the containers of other entries.
+ */
+
+void **mail_thread_id (MAILSTREAM *stream,char *id,long add)
+{
+  unsigned long i,j,h,mask;
+  unsigned char *s;
+  IDENTRY *ent;
+  IDTABLE *idt = (IDTABLE *) stream->private.idtab;
+				/* FNV-1a hash of message-id */
+  for (h = 2166136261UL, s = (unsigned char *) id; *s; h *= 16777619UL)
+    h ^= *s++;
+  h &= 0xffffffff;		/* same hash on all architectures */
+  for (i = h & (mask = idt->size - 1); j = idt->slot[i]; i = (i + 1) & mask)
+    if (((ent = idt->ent + j - 1)->hash == h) && !strcmp (ent->name,id)) {
+      if (ent->stamp != idt->stamp) {
+	if (!add) return NIL;	/* not used yet in this pass */
+	memset (ent->data,0,sizeof (ent->data));
+	ent->stamp = idt->stamp;/* reset container for this pass */
+	++idt->live;
+      }
+      return ent->data;
+    }
+  if (!add) return NIL;		/* not found */
+  if (idt->nent == idt->maxent) {/* grow entry vector if full */
+    idt->maxent = max (idt->maxent * 2,IDTABMIN);
+    fs_resize ((void **) &idt->ent,idt->maxent * sizeof (IDENTRY));
+  }
+  if ((idt->nent * 2) >= idt->size) {
+    mail_thread_id_rehash (idt,idt->size * 2);
+    for (i = h & (mask = idt->size - 1); idt->slot[i]; i = (i + 1) & mask);
+  }
+  idt->slot[i] = ++idt->nent;	/* new entry */
+  (ent = idt->ent + idt->nent - 1)->name = cpystr (id);
+  ent->hash = h;
+  ent->stamp = idt->stamp;
+  memset (ent->data,0,sizeof (ent->data));
+  ++idt->live;
+  return ent->data;
+}
+
+
+/* Mail thread message-id table free
+ * Accepts: mail stream
+ */
+
+void mail_thread_id_free (MAILSTREAM *stream)
+{
+  unsigned long i;
+  IDTABLE *idt = (IDTABLE *) stream->private.idtab;
+  if (idt) {
+    for (i = 0; i < idt->nent; ++i) fs_give ((void **) &idt->ent[i].name);
+    if (idt->ent) fs_give ((void **) &idt->ent);
+    if (idt->slot) fs_give ((void **) &idt->slot);
+    fs_give ((void **) &stream->private.idtab);
+  }
+}
+
 /* Fetch overview callback to load sortcache for threading
  * Accepts: MAIL stream
  *	    UID of this message
@@ -5834,6 +6547,7 @@ void mail_free_cache (MAILSTREAM *stream)
   mail_gc (stream,GC_ELT | GC_ENV | GC_TEXTS);
 				/* flush the cache */
   (*mailcache) (stream,(long) 0,CH_INIT);
+  mail_thread_id_free (stream);	/* flush threading message-id table */
 }
 
 
@@ -5848,10 +6562,32 @@ void mail_free_elt (MESSAGECACHE **elt)
     mail_gc_msg (&(*elt)->private.msg,GC_ENV | GC_TEXTS);
     if (mailfreeeltsparep && (*elt)->sparep)
       (*mailfreeeltsparep) (&(*elt)->sparep);
-    fs_give ((void **) elt);
+				/* slab elts are reclaimed by the cache */
+    if ((*elt)->private.slab) *elt = NIL;
+    else fs_give ((void **) elt);
   }
   else *elt = NIL;		/* else simply drop pointer */
 }
+
+
+/* Mail garbage collect sortcache entry
+ * Accepts: pointer to sortcache entry pointer
+ */
+
+void mail_free_sortcache (SORTCACHE **sc)
+{
+  if (*sc) {
+    if ((*sc)->from) fs_give ((void **) &(*sc)->from);
+    if ((*sc)->to) fs_give ((void **) &(*sc)->to);
+    if ((*sc)->cc) fs_give ((void **) &(*sc)->cc);
+    if ((*sc)->subject) fs_give ((void **) &(*sc)->subject);
+    if ((*sc)->unique && ((*sc)->unique != (*sc)->message_id))
+      fs_give ((void **) &(*sc)->unique);
+    if ((*sc)->message_id) fs_give ((void **) &(*sc)->message_id);
+    if ((*sc)->references) mail_free_stringlist (&(*sc)->references);
+    fs_give ((void **) sc);
+  }
+}
 
 /* Mail garbage collect envelope
  * Accepts: pointer to envelope pointer
@@ -6143,7 +6879,8 @@ static NETDRIVER tcpdriver = {
   tcp_host,			/* return host name */
   tcp_remotehost,		/* return remote host name */
   tcp_port,			/* return port number */
-  tcp_localhost			/* return local host name */
+  tcp_localhost,		/* return local host name */
+  tcp_getsome			/* get some data */
 };
 
 
@@ -6267,6 +7004,20 @@ long net_getbuffer (void *st,unsigned long size,char *buffer)
 }
 
 
+/* Network receive some data
+ * Accepts: Network stream
+ *	    maximum size in bytes
+ *	    buffer to read into
+ * Returns: number of bytes read, 0 if failure
+ */
+
+unsigned long net_getsome (NETSTREAM *stream,unsigned long size,char *buffer)
+{
+  return stream->dtb->getsome ?
+    (*stream->dtb->getsome) (stream->stream,size,buffer) : 0;
+}
+
+
 /* Network send null-terminated string
  * Accepts: Network stream
  *	    string pointer
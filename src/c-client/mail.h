@@ -142,6 +142,8 @@
 #define SET_RFC822OUTPUTFULL (long) 160
 #define GET_BLOCKENVINIT (long) 161
 #define SET_BLOCKENVINIT (long) 162
+#define GET_NETDEFLATE (long) 163
+#define SET_NETDEFLATE (long) 164
 
 	/* 2xx: environment */
 #define GET_USERNAME (long) 201
@@ -354,6 +356,30 @@
 #define SET_SCANCONTENTS (long) 573
 #define GET_MHALLOWINBOX (long) 574
 #define SET_MHALLOWINBOX (long) 575
+#define GET_UNIXINDEXDIR (long) 576
+#define SET_UNIXINDEXDIR (long) 577
+#define GET_UNIXMMAP (long) 578
+#define SET_UNIXMMAP (long) 579
+#define GET_MIXTEXTINDEX (long) 580
+#define SET_MIXTEXTINDEX (long) 581
+#define GET_SORTCACHEDIR (long) 582
+#define SET_SORTCACHEDIR (long) 583
+#define GET_HIGHESTMODSEQ (long) 584
+#define SET_HIGHESTMODSEQ (long) 585
+#define GET_MIXBURPBUDGET (long) 586
+#define SET_MIXBURPBUDGET (long) 587
+#define GET_MBXFLAGSYNC (long) 588
+#define SET_MBXFLAGSYNC (long) 589
+#define GET_LISTCACHEDIR (long) 590
+#define SET_LISTCACHEDIR (long) 591
+#define GET_STATUSCACHEDIR (long) 592
+#define SET_STATUSCACHEDIR (long) 593
+#define GET_LISTENWORKERS (long) 594
+#define SET_LISTENWORKERS (long) 595
+#define GET_LISTENSESSIONS (long) 596
+#define SET_LISTENSESSIONS (long) 597
+#define GET_SSLSESSIONCACHEDIR (long) 598
+#define SET_SSLSESSIONCACHEDIR (long) 599
 
 /* Driver flags */
 
@@ -500,6 +526,8 @@
 #define SA_UIDNEXT (long) 0x8	/* next UID to be assigned */
 				/* UID validity value */
 #define SA_UIDVALIDITY (long) 0x10
+				/* highest modification sequence */
+#define SA_HIGHESTMODSEQ (long) 0x20
 				/* set OP_DEBUG on any created stream */
 #define SA_DEBUG (long) 0x10000000
 				/* use multiple newsrcs */
@@ -827,6 +855,7 @@ typedef struct message_cache {
     unsigned int dirty : 1;	/* driver internal use */
     unsigned int filter : 1;	/* driver internal use */
     unsigned int ghost : 1;	/* driver internal use */
+    unsigned int slab : 1;	/* allocated in a cache slab */
   } private;
 			/* internal date */
   unsigned int day : 5;		/* day of month (1-31) */
@@ -954,6 +983,7 @@ SEARCHPGM {			/* search program */
   unsigned long smaller;	/* smaller than this size */
   unsigned long older;		/* older than this interval */
   unsigned long younger;	/* younger than this interval */
+  unsigned long modseq;		/* modified at or after this sequence */
   unsigned short sentbefore;	/* sent before this date */
   unsigned short senton;	/* sent on this date */
   unsigned short sentsince;	/* sent since this date */
@@ -993,6 +1023,7 @@ typedef struct mbx_status {
   unsigned long unseen;		/* number of unseen messages */
   unsigned long uidnext;	/* next UID to be assigned */
   unsigned long uidvalidity;	/* UID validity value */
+  unsigned long highestmodseq;	/* highest modification sequence */
 } MAILSTATUS;
 
 /* Sort program */
@@ -1122,8 +1153,13 @@ typedef struct mail_stream {
       STRINGLIST *string;	/* string(s) to search */
       long result;		/* search result */
       char *text;		/* cache of fetched text */
+      void *match;		/* automaton for string(s) to search */
+      void *automata;		/* automata made by this search */
+      unsigned long want;	/* mask of string(s) not yet found */
     } search;
     STRING string;		/* stringstruct return hack */
+    void *cache;		/* cache manager private data */
+    void *idtab;		/* threading message-id table */
   } private;
 			/* reserved for use by main program */
   void *sparep;			/* spare pointer */
@@ -1190,6 +1226,7 @@ NETDRIVER {
   char *(*remotehost) (void *stream);
   unsigned long (*port) (void *stream);
   char *(*localhost) (void *stream);
+  unsigned long (*getsome) (void *stream,unsigned long size,char *buffer);
 };
 
 
@@ -1352,6 +1389,7 @@ typedef void (*freeenvelopesparep_t) (void **sparep);
 typedef void (*freebodysparep_t) (void **sparep);
 typedef void (*freestreamsparep_t) (void **sparep);
 typedef void *(*sslstart_t) (void *stream,char *host,unsigned long flags);
+typedef NETSTREAM *(*netdeflate_t) (NETSTREAM *stream);
 typedef long (*sslcertificatequery_t) (char *reason,char *host,char *cert);
 typedef void (*sslfailure_t) (char *host,char *reason,unsigned long flags);
 typedef void (*logouthook_t) (void *data);
@@ -1501,6 +1539,8 @@ DRIVER {
   long (*append) (MAILSTREAM *stream,char *mailbox,append_t af,void *data);
 				/* garbage collect stream */
   void (*gc) (MAILSTREAM *stream,long gcflags);
+				/* watch mailbox for changes */
+  int (*watch) (MAILSTREAM *stream);
 };
 
 
@@ -1604,6 +1644,8 @@ void mm_nocritical (MAILSTREAM *stream);
 long mm_diskerror (MAILSTREAM *stream,long errcode,long serious);
 void mm_fatal (char *string);
 void *mm_cache (MAILSTREAM *stream,unsigned long msgno,long op);
+void *mm_cache_slab (MAILSTREAM *stream,unsigned long msgno,long op);
+void mail_cache_slab_close (MAILSTREAM *stream);
 
 extern STRINGDRIVER mail_string;
 void mail_versioncheck (char *version);
@@ -1672,6 +1714,7 @@ long mail_search_default (MAILSTREAM *stream,char *charset,SEARCHPGM *pgm,
 			  long flags);
 long mail_ping (MAILSTREAM *stream);
 void mail_check (MAILSTREAM *stream);
+int mail_watch (MAILSTREAM *stream);
 long mail_expunge_full (MAILSTREAM *stream,char *sequence,long options);
 long mail_copy_full (MAILSTREAM *stream,char *sequence,char *mailbox,
 		     long options);
@@ -1709,6 +1752,14 @@ long mail_search_body (MAILSTREAM *stream,unsigned long msgno,BODY *body,
 		       char *prefix,unsigned long section,long flags);
 long mail_search_string (SIZEDTEXT *s,char *charset,STRINGLIST **st);
 long mail_search_string_work (SIZEDTEXT *s,STRINGLIST **st);
+long mail_search_keys (MAILSTREAM *stream,SIZEDTEXT *s,char *charset);
+long mail_search_keys_work (MAILSTREAM *stream,SIZEDTEXT *s);
+long mail_search_part (MAILSTREAM *stream,unsigned char *s,unsigned long i,
+		       unsigned short encoding,char *charset);
+long mail_search_whole (MAILSTREAM *stream,unsigned char *s,unsigned long i,
+			unsigned short encoding,char *charset);
+unsigned char *mail_search_cut (unsigned char *s,unsigned char *e,
+				unsigned short encoding);
 long mail_search_keyword (MAILSTREAM *stream,MESSAGECACHE *elt,STRINGLIST *st,
 			  long flag);
 long mail_search_addr (ADDRESS *adr,STRINGLIST *st);
@@ -1727,6 +1778,10 @@ unsigned long *mail_sort_cache (MAILSTREAM *stream,SORTPGM *pgm,SORTCACHE **sc,
 				long flags);
 unsigned long *mail_sort_msgs (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
 			       SORTPGM *pgm,long flags);
+void mail_sort_keys (SORTCACHE **sc,unsigned long nmsgs,SORTPGM *pgm);
+unsigned long mail_sort_key (unsigned char *key,SORTCACHE *sc,SORTPGM *pgm,
+			     int *width);
+int mail_sort_key_compare (const void *a1,const void *a2);
 SORTCACHE **mail_sort_loadcache (MAILSTREAM *stream,SORTPGM *pgm);
 unsigned int mail_strip_subject (char *t,char **ret);
 char *mail_strip_subject_wsp (char *s);
@@ -1747,6 +1802,10 @@ void mail_thread_loadcache (MAILSTREAM *stream,unsigned long uid,OVERVIEW *ov,
 			    unsigned long msgno);
 char *mail_thread_parse_msgid (char *s,char **ss);
 STRINGLIST *mail_thread_parse_references (char *s,long flag);
+void mail_thread_id_pass (MAILSTREAM *stream);
+void mail_thread_id_rehash (void *table,unsigned long size);
+void **mail_thread_id (MAILSTREAM *stream,char *id,long add);
+void mail_thread_id_free (MAILSTREAM *stream);
 long mail_thread_check_child (container_t mother,container_t daughter);
 container_t mail_thread_prune_dummy (container_t msg,container_t ane);
 container_t mail_thread_prune_dummy_work (container_t msg,container_t ane);
@@ -1782,6 +1841,7 @@ void mail_free_body_parameter (PARAMETER **parameter);
 void mail_free_body_part (PART **part);
 void mail_free_cache (MAILSTREAM *stream);
 void mail_free_elt (MESSAGECACHE **elt);
+void mail_free_sortcache (SORTCACHE **sc);
 void mail_free_envelope (ENVELOPE **env);
 void mail_free_address (ADDRESS **address);
 void mail_free_stringlist (STRINGLIST **string);
@@ -1809,6 +1869,7 @@ NETSTREAM *net_aopen (NETDRIVER *dv,NETMBX *mb,char *service,char *usrbuf);
 char *net_getline (NETSTREAM *stream);
 				/* stream must be void* for use as readfn_t */
 long net_getbuffer (void *stream,unsigned long size,char *buffer);
+unsigned long net_getsome (NETSTREAM *stream,unsigned long size,char *buffer);
 long net_soutr (NETSTREAM *stream,char *string);
 long net_sout (NETSTREAM *stream,char *string,unsigned long size);
 void net_close (NETSTREAM *stream);
@@ -1822,8 +1883,11 @@ long sm_unsubscribe (char *mailbox);
 char *sm_read (char *sbname,void **sdb);
 
 void ssl_onceonlyinit (void);
+void zlib_onceonlyinit (void);
 char *ssl_start_tls (char *s);
 void ssl_server_init (char *server);
+void ssl_server_prepare (char *server);
+char *deflate_start (char *s);
 
 
 /* Server I/O functions */
@@ -1833,6 +1897,7 @@ char *PSIN (char *s,int n);
 long PSINR (char *s,unsigned long n);
 int PBOUT (int c);
 long INWAIT (long seconds);
+long INWATCH (long seconds,int fd);
 int PSOUT (char *s);
 int PSOUTR (SIZEDTEXT *s);
 int PFLUSH (void);
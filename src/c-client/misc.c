@@ -255,25 +255,147 @@ long search (unsigned char *base,long basec,unsigned char *pat,long patc)
  *	    pattern string
  *	    length of pattern string
  * Returns: T if pattern exists inside base, else NIL
+ *
+ * This is the Horspool simplification: the skip is taken from the base
+ * character aligned with the end of the pattern, by how far from the end
+ * of the pattern that character last occurs.
  */
 
 long ssearch (unsigned char *base,long basec,unsigned char *pat,long patc)
 {
   long i,j,k;
-  int c;
-  unsigned char mask[256];
+  long skip[256];
 				/* validate arguments */
   if (base && (basec > 0) && pat && (basec >= patc)) {
     if (patc <= 0) return T;	/* empty pattern always succeeds */
-    memset (mask,0,256);	/* initialize search validity mask */
-    for (i = 0; i < patc; i++) mask[pat[i]] = T;
+				/* initialize skip table */
+    for (i = 0; i < 256; i++) skip[i] = patc;
+    for (i = 0, --patc; i < patc; i++) skip[pat[i]] = patc - i;
 				/* Boyer-Moore type search */
-    for (i = --patc, c = pat[i]; i < basec; i += (mask[c] ? 1 : (j + 1)))
-      for (j = patc,c = base[k = i]; (c == pat[j]); j--,c = base[--k])
+    for (i = patc; i < basec; i += skip[base[i]])
+      for (j = patc,k = i; base[k] == pat[j]; j--,k--)
 	if (!j) return T;	/* found a match! */
   }
   return NIL;			/* pattern not found */
 }
+
+/* Create multiple string search automaton
+ * Accepts: string list of patterns
+ * Returns: automaton, or NIL if too many or too long patterns
+ *
+ * This is an Aho-Corasick automaton with its failure transitions folded
+ * into a complete transition table, so that the base string is scanned
+ * once for all of the patterns, taking one table lookup per character.
+ */
+
+MSEARCH *msearch_create (STRINGLIST *pat)
+{
+  unsigned long i,j,c,m,n,r,u;
+  unsigned long *fail,*queue;
+  STRINGLIST *sl,**tail;
+  MSEARCH *ms;
+				/* count patterns and trie states needed */
+  for (sl = pat, i = 0, n = 1; sl; sl = sl->next, i++) n += sl->text.size;
+  if (!i || (i > MSEARCHMAXKEYS) || (n > MSEARCHMAXSTATES)) return NIL;
+  ms = (MSEARCH *) memset (fs_get (sizeof (MSEARCH)),0,sizeof (MSEARCH));
+  ms->out = (unsigned long *) memset (fs_get (n * sizeof (unsigned long)),0,
+				      n * sizeof (unsigned long));
+  ms->delta = (unsigned int *)
+    memset (fs_get (n * 256 * sizeof (unsigned int)),0,
+	    n * 256 * sizeof (unsigned int));
+				/* build trie, keeping copy of patterns */
+  for (sl = pat, tail = &ms->pat, i = 0, n = 1; sl; sl = sl->next, i++) {
+    *tail = mail_newstringlist ();
+    textcpy (&(*tail)->text,&sl->text);
+    tail = &(*tail)->next;
+    ms->all |= 1UL << i;	/* note pattern in mask */
+    if (!sl->text.size) ms->empty |= 1UL << i;
+    else {			/* state 0 is root, never a goto target */
+      for (j = r = 0; j < sl->text.size; j++, r = u)
+	if (!(u = ms->delta[(r << 8) + sl->text.data[j]]))
+	  u = ms->delta[(r << 8) + sl->text.data[j]] = n++;
+      ms->out[r] |= 1UL << i;	/* pattern ends at this state */
+    }
+  }
+  fail = (unsigned long *) fs_get (n * sizeof (unsigned long));
+  queue = (unsigned long *) fs_get (n * sizeof (unsigned long));
+				/* root children fail to root */
+  for (c = m = j = 0; c < 256; c++)
+    if (u = ms->delta[c]) fail[queue[m++] = u] = 0;
+  while (j < m) {		/* breadth first from depth 1 */
+    r = queue[j++];
+    for (c = 0; c < 256; c++) {
+      if (u = ms->delta[(r << 8) + c]) {
+	fail[queue[m++] = u] = ms->delta[(fail[r] << 8) + c];
+	ms->out[u] |= ms->out[fail[u]];
+      }
+				/* fold in failure transition */
+      else ms->delta[(r << 8) + c] = ms->delta[(fail[r] << 8) + c];
+    }
+  }
+  fs_give ((void **) &queue);
+  fs_give ((void **) &fail);
+  return ms;
+}
+
+/* Test multiple string search automaton patterns
+ * Accepts: automaton
+ *	    string list of patterns
+ * Returns: T if automaton was created from these patterns, else NIL
+ */
+
+long msearch_pattern (MSEARCH *ms,STRINGLIST *pat)
+{
+  STRINGLIST *sl;
+  for (sl = ms->pat; sl && pat; sl = sl->next, pat = pat->next)
+    if ((sl->text.size != pat->text.size) ||
+	memcmp (sl->text.data,pat->text.data,sl->text.size)) return NIL;
+  return (sl || pat) ? NIL : LONGT;
+}
+
+
+/* Multiple string search
+ * Accepts: automaton
+ *	    base string
+ *	    length of base string
+ *	    mask of patterns still wanted
+ *	    pointer to automaton state carried from preceding base, or NIL
+ * Returns: mask of wanted patterns not found inside base
+ *
+ * The search ends as soon as every wanted pattern has been found.  A base
+ * given in pieces is searched as one string if the state is carried.
+ */
+
+unsigned long msearch (MSEARCH *ms,unsigned char *base,unsigned long basec,
+		       unsigned long want,unsigned int *state)
+{
+  unsigned long m;
+  unsigned int r = state ? *state : 0;
+				/* empty pattern matches any non-empty base */
+  if (basec) want &= ~ms->empty;
+  while (want && basec--)
+    if ((m = ms->out[r = ms->delta[(r << 8) + *base++]]) & want) want &= ~m;
+  if (state) *state = r;	/* note state for next piece */
+  return want;
+}
+
+
+/* Destroy multiple string search automata
+ * Accepts: pointer to automaton list
+ */
+
+void msearch_destroy (MSEARCH **ms)
+{
+  MSEARCH *nxt;
+  while (*ms) {
+    nxt = (*ms)->next;
+    mail_free_stringlist (&(*ms)->pat);
+    fs_give ((void **) &(*ms)->out);
+    fs_give ((void **) &(*ms)->delta);
+    fs_give ((void **) ms);
+    *ms = nxt;
+  }
+}
 
 /* Create a hash table
  * Accepts: size of new table (note: should be a prime)
@@ -50,6 +50,23 @@ HASHTAB {
 };
 
 
+/* Multiple string search automaton */
+
+#define MSEARCHMAXKEYS 32	/* most patterns in one automaton */
+#define MSEARCHMAXSTATES 1024	/* most states in one automaton */
+
+#define MSEARCH struct msearch_automaton
+
+MSEARCH {
+  MSEARCH *next;		/* next automaton in a list */
+  STRINGLIST *pat;		/* patterns automaton was created from */
+  unsigned long all;		/* mask of all patterns */
+  unsigned long empty;		/* mask of empty patterns */
+  unsigned long *out;		/* mask of patterns found at each state */
+  unsigned int *delta;		/* 256 transitions from each state */
+};
+
+
 /* KLUDGE ALERT!!!
  *
  * Yes, write() is overridden here instead of in osdep.  This
@@ -92,6 +109,11 @@ long min (long i,long j);
 long max (long i,long j);
 long search (unsigned char *base,long basec,unsigned char *pat,long patc);
 long ssearch (unsigned char *base,long basec,unsigned char *pat,long patc);
+MSEARCH *msearch_create (STRINGLIST *pat);
+long msearch_pattern (MSEARCH *ms,STRINGLIST *pat);
+unsigned long msearch (MSEARCH *ms,unsigned char *base,unsigned long basec,
+		       unsigned long want,unsigned int *state);
+void msearch_destroy (MSEARCH **ms);
 HASHTAB *hash_create (size_t size);
 void hash_destroy (HASHTAB **hashtab);
 void hash_reset (HASHTAB *hashtab);
@@ -197,7 +197,8 @@ DRIVER nntpdriver = {
   nntp_expunge,			/* expunge deleted messages */
   nntp_copy,			/* copy messages to another mailbox */
   nntp_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -578,6 +579,7 @@ long nntp_status (MAILSTREAM *stream,char *mbx,long flags)
     else status.recent = status.unseen = status.messages;
 				/* UID validity is a constant */
     status.uidvalidity = stream->uid_validity;
+    status.highestmodseq = 0;	/* no modsequences */
 				/* pass status to main program */
     mm_status (stream,mbx,&status);
     ret = T;			/* succes */
@@ -153,7 +153,8 @@ DRIVER pop3driver = {
   pop3_expunge,			/* expunge deleted messages */
   pop3_copy,			/* copy messages to another mailbox */
   pop3_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -362,6 +363,7 @@ long pop3_status (MAILSTREAM *stream,char *mbx,long flags)
 	if (!mail_elt (tstream,i)->seen) status.unseen++;
     status.uidnext = tstream->uid_last + 1;
     status.uidvalidity = tstream->uid_validity;
+    status.highestmodseq = 0;	/* no modsequences */
 				/* pass status to main program */
     mm_status (tstream,mbx,&status);
     if (stream != tstream) mail_close (tstream);
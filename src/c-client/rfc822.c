@@ -1895,13 +1895,14 @@ long rfc822_output_text (RFC822BUFFER *buf,BODY *body)
 
 #define WSP 0176		/* NUL, TAB, LF, FF, CR, SPC */
 #define JNK 0177
-#define PAD 0100
+#define PAD 0100		/* bit also set in WSP and JNK */
 
 void *rfc822_base64 (unsigned char *src,unsigned long srcl,unsigned long *len)
 {
   char c,*s,tmp[MAILTMPLEN];
   void *ret = fs_get ((size_t) ((*len = 4 + ((srcl * 3) / 4))) + 1);
   char *d = (char *) ret;
+  unsigned long q;
   int e;
   static char decode[256] = {
    WSP,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,WSP,WSP,JNK,WSP,WSP,JNK,JNK,
@@ -1921,12 +1922,21 @@ void *rfc822_base64 (unsigned char *src,unsigned long srcl,unsigned long *len)
    JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
    JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK
   };
-				/* initialize block */
-  memset (ret,0,((size_t) *len) + 1);
   *len = 0;			/* in case we return an error */
 
-				/* simple-minded decode */
-  for (e = 0; srcl--; ) switch (c = decode[*src++]) {
+  for (e = 0; srcl--; )		/* quantum of four data characters? */
+    if (!e && (srcl >= 3) && !((decode[src[0]] | decode[src[1]] |
+				decode[src[2]] | decode[src[3]]) & PAD)) {
+      q = (decode[src[0]] << 18) | (decode[src[1]] << 12) |
+	(decode[src[2]] << 6) | decode[src[3]];
+      *d++ = (char) (q >> 16);	/* install all three bytes at once */
+      *d++ = (char) (q >> 8);
+      *d++ = (char) q;
+      src += 4;			/* skip past quantum */
+      srcl -= 3;
+    }
+				/* else simple-minded decode */
+    else switch (c = decode[*src++]) {
   default:			/* valid BASE64 data character */
     switch (e++) {		/* install based on quantum position */
     case 0:
@@ -2052,24 +2062,33 @@ unsigned char *rfc822_qprint (unsigned char *src,unsigned long srcl,
   unsigned char *d = ret;
   unsigned char *t = d;
   unsigned char *s = src;
+  unsigned char *se = src + srcl;
+  unsigned char *u;
   unsigned char c,e;
   *len = 0;			/* in case we return an error */
 				/* until run out of characters */
-  while (((unsigned long) (s - src)) < srcl) {
+  while (s < se) {
+				/* copy run of ordinary characters */
+    for (u = s; (s < se) && (*s != '=') && (*s != ' ') && (*s != '\015') &&
+	   (*s != '\012'); s++);
+    if (s != u) {
+      memcpy (d,u,s - u);
+      t = d += s - u;		/* note point of non-space */
+      if (s == se) break;	/* all done if end of data */
+    }
     switch (c = *s++) {		/* what type of character is it? */
     case '=':			/* quoting character */
-      if (((unsigned long) (s - src)) < srcl) switch (c = *s++) {
+      if (s < se) switch (c = *s++) {
       case '\0':		/* end of data */
 	s--;			/* back up pointer */
 	break;
       case '\015':		/* non-significant line break */
-	if ((((unsigned long) (s - src)) < srcl) && (*s == '\012')) s++;
+	if ((s < se) && (*s == '\012')) s++;
       case '\012':		/* bare LF */
 	t = d;			/* accept any leading spaces */
 	break;
       default:			/* two hex digits then */
-	if (isxdigit (c) && (((unsigned long) (s - src)) < srcl) &&
-	    isxdigit(*s)) {
+	if (isxdigit (c) && (s < se) && isxdigit(*s)) {
 	  e = *s++;		/* eat second hex digit now */
 	  *d++ = hex2byte (c,e);/* merge the two hex digits */
 	}
@@ -40,6 +40,7 @@ struct ssl_driver {		/* must parallel NETDRIVER in mail.h */
   char *(*remotehost) (SSLSTREAM *stream);
   unsigned long (*port) (SSLSTREAM *stream);
   char *(*localhost) (SSLSTREAM *stream);
+  unsigned long (*getsome) (SSLSTREAM *stream,unsigned long size,char *buffer);
 };
 
 
@@ -47,9 +48,6 @@ struct ssl_driver {		/* must parallel NETDRIVER in mail.h */
 
 typedef struct ssl_stdiostream {
   SSLSTREAM *sslstream;		/* SSL stream */
-  int octr;			/* output counter */
-  char *optr;			/* output pointer */
-  char obuf[SSLBUFLEN];		/* output buffer */
 } SSLSTDIOSTREAM;
 
 
@@ -60,6 +58,7 @@ SSLSTREAM *ssl_aopen (NETMBX *mb,char *service,char *usrbuf);
 char *ssl_getline (SSLSTREAM *stream);
 long ssl_getbuffer (SSLSTREAM *stream,unsigned long size,char *buffer);
 long ssl_getdata (SSLSTREAM *stream);
+unsigned long ssl_getsome (SSLSTREAM *stream,unsigned long size,char *buffer);
 long ssl_soutr (SSLSTREAM *stream,char *string);
 long ssl_sout (SSLSTREAM *stream,char *string,unsigned long size);
 void ssl_close (SSLSTREAM *stream);
@@ -68,3 +67,4 @@ char *ssl_remotehost (SSLSTREAM *stream);
 unsigned long ssl_port (SSLSTREAM *stream);
 char *ssl_localhost (SSLSTREAM *stream);
 long ssl_server_input_wait (long seconds);
+long ssl_server_input_watch (long seconds,int fd);
@@ -42,6 +42,7 @@ TCPSTREAM *tcp_aopen (NETMBX *mb,char *service,char *usrbuf);
 char *tcp_getline (TCPSTREAM *stream);
 long tcp_getbuffer (TCPSTREAM *stream,unsigned long size,char *buffer);
 long tcp_getdata (TCPSTREAM *stream);
+unsigned long tcp_getsome (TCPSTREAM *stream,unsigned long size,char *buffer);
 long tcp_soutr (TCPSTREAM *stream,char *string);
 long tcp_sout (TCPSTREAM *stream,char *string,unsigned long size);
 void tcp_close (TCPSTREAM *stream);
@@ -55,5 +56,6 @@ long tcp_clientport (void);
 char *tcp_serveraddr (void);
 char *tcp_serverhost (void);
 long tcp_serverport (void);
+int tcp_listen (char *service,int *fd,int n);
 char *tcp_canonical (char *name);
 long tcp_isclienthost (char *host);
@@ -56,6 +56,8 @@ extern int errno;		/* just in case */
 
 
 #define MAXNLIBADCOMMAND 3	/* limit on number of NLI bad commands */
+#define LISTENWORKERS 4		/* default standalone server workers */
+#define MAXLISTENWORKERS 1000	/* maximum standalone server workers */
 #define MAXTAG 50		/* maximum tag length */
 #define LITSTKLEN 20		/* length of literal stack */
 #define MAXCLIENTLIT 10000	/* maximum non-APPEND client literal size
@@ -111,11 +113,27 @@ typedef struct msg_data {
   char *date;			/* current date */
   STRING *message;		/* stringstruct of message */
 } MSGDATA;
+
+
+/* QRESYNC select parameters */
+
+typedef struct qresync_args {
+  unsigned long uidvalidity;	/* client's UID validity, 0 if none */
+  unsigned long modseq;		/* client's last known mod-sequence */
+  unsigned char *uids;		/* client's known UIDs, NIL if all */
+  int condstore;		/* enable CONDSTORE if select succeeds */
+} QRESYNCARGS;
+
+
+/* Mailbox has mod-sequences */
+
+#define MODSEQOK (stream && stream->dtb && (stream->dtb->flags & DR_MODSEQ))
 
 /* Function prototypes */
 
 int main (int argc,char *argv[]);
 void ping_mailbox (unsigned long uid);
+void flags_changed (MAILSTREAM *stream,unsigned long msgno);
 time_t palert (char *file,time_t oldtime);
 void msg_string_init (STRING *s,void *data,unsigned long size);
 char msg_string_next (STRING *s);
@@ -140,6 +158,8 @@ unsigned char *parse_tag (unsigned char *cmd,unsigned char **ret);
 unsigned char *snarf (unsigned char **arg);
 unsigned char *snarf_base64 (unsigned char **arg);
 unsigned char *snarf_list (unsigned char **arg);
+long list_return (unsigned char *arg,long *status);
+long status_flags (unsigned char *arg);
 STRINGLIST *parse_stringlist (unsigned char **s,int *list);
 unsigned long uidmax (MAILSTREAM *stream);
 long parse_criteria (SEARCHPGM *pgm,unsigned char **arg,unsigned long maxmsg,
@@ -152,9 +172,11 @@ long crit_set (SEARCHSET **set,unsigned char **arg,unsigned long maxima);
 long crit_number (unsigned long *number,unsigned char **arg);
 long crit_string (STRINGLIST **string,unsigned char **arg);
 
-void fetch (char *t,unsigned long uid);
+void fetch (char *t,unsigned long uid,long modseq);
 typedef void (*fetchfn_t) (unsigned long i,void *args);
-void fetch_work (char *t,unsigned long uid,fetchfn_t f[],void *fa[]);
+void fetch_work (char *t,unsigned long uid,long modseq,fetchfn_t f[],
+		 void *fa[]);
+char *fetch_modifiers (char *t);
 void fetch_bodystructure (unsigned long i,void *args);
 void fetch_body (unsigned long i,void *args);
 void fetch_body_part_mime (unsigned long i,void *args);
@@ -170,6 +192,7 @@ void fetch_flags (unsigned long i,void *args);
 void put_flag (int *c,char *s);
 void fetch_internaldate (unsigned long i,void *args);
 void fetch_uid (unsigned long i,void *args);
+void fetch_modseq (unsigned long i,void *args);
 void fetch_rfc822 (unsigned long i,void *args);
 void fetch_rfc822_header (unsigned long i,void *args);
 void fetch_rfc822_size (unsigned long i,void *args);
@@ -195,6 +218,8 @@ void pbodypartstring (unsigned long msgno,char *id,SIZEDTEXT *st,STRING *bs,
 void ptext (SIZEDTEXT *s,STRING *st);
 void pthread (THREADNODE *thr);
 void pcapability (long flag);
+long status_mailbox (char *name,long flags,long snarl);
+void list_status (long flags);
 long nameok (char *ref,char *name);
 char *bboardname (char *cmd,char *name);
 long isnewsproxy (char *name);
@@ -211,6 +236,14 @@ void appenduid (char *mailbox,unsigned long uidvalidity,SEARCHSET *set);
 char *referral (MAILSTREAM *stream,char *url,long code);
 void mm_list_work (char *what,int delimiter,char *name,long attributes);
 char *lasterror (void);
+unsigned long highestmodseq (void);
+long parse_modifier (char **arg,char *name,unsigned long *value,
+		     long *vanished);
+long parse_select (unsigned char *arg,QRESYNCARGS *qr);
+void qresync_select (QRESYNCARGS *qr);
+void vanished (SEARCHSET *set);
+long set_member (SEARCHSET *set,unsigned long n);
+char *unchanged_since (unsigned long since,unsigned long uid);
 
 /* Global storage */
 
@@ -233,12 +266,24 @@ int critical = NIL;		/* non-zero if in critical code */
 int quell_events = NIL;		/* non-zero if in FETCH response */
 int existsquelled = NIL;	/* non-zero if an EXISTS was quelled */
 int proxylist = NIL;		/* doing a proxy LIST */
+long liststatus = NIL;		/* status items for LIST-STATUS */
+STRINGLIST *liststatusnames = NIL;
+				/* tail of LIST-STATUS names */
+STRINGLIST **liststatustail = &liststatusnames;
+int condstore = NIL;		/* CONDSTORE enabled */
+int qresync = NIL;		/* QRESYNC enabled */
+int searchmodseq = NIL;		/* SEARCH has MODSEQ criterion */
+int tagmodseq = NIL;		/* HIGHESTMODSEQ in tagged response */
 MAILSTREAM *stream = NIL;	/* mailbox stream */
 DRIVER *curdriver = NIL;	/* note current driver */
 MAILSTREAM *tstream = NIL;	/* temporary mailbox stream */
 unsigned int nflags = 0;	/* current number of keywords */
 unsigned long nmsgs =0xffffffff;/* last reported # of messages and recent */
 unsigned long recent = 0xffffffff;
+unsigned long *chgflags = NIL;	/* messages with flags to report */
+unsigned long nchgflags = 0;	/* number of messages in chgflags */
+unsigned long chgflagsmax = 0;	/* allocated size of chgflags */
+int chgflagsall = NIL;		/* too many, check all messages */
 char *nntpproxy = NIL;		/* NNTP proxy name */
 unsigned char *user = NIL;	/* user name */
 unsigned char *pass = NIL;	/* password */
@@ -267,6 +312,7 @@ SIZEDTEXT lastst = {NIL,0};	/* last sizedtext */
 unsigned long cauidvalidity = 0;/* UIDVALIDITY for COPYUID/APPENDUID */
 SEARCHSET *csset = NIL;		/* COPYUID source set */
 SEARCHSET *caset = NIL;		/* COPYUID/APPENDUID destination set */
+SEARCHSET *modset = NIL;	/* STORE MODIFIED set */
 jmp_buf jmpenv;			/* stack context for setjmp */
 
 
@@ -283,9 +329,12 @@ char *badcmd = "%.80s BAD Command unrecognized: %.80s\015\012";
 char *badcml = "%.80s BAD Command unrecognized\015\012";
 char *misarg = "%.80s BAD Missing or invalid argument to %.80s\015\012";
 char *badarg = "%.80s BAD Argument given to %.80s when none expected\015\012";
+char *badsel = "%.80s BAD Unknown or invalid %.80s parameters\015\012";
+char *badenb = "%.80s BAD %.80s not allowed with a mailbox selected\015\012";
 char *badseq = "%.80s BAD Bogus sequence in %.80s: %.80s\015\012";
 char *badatt = "%.80s BAD Bogus attribute list in %.80s\015\012";
 char *badbin = "%.80s BAD Syntax error in binary specifier\015\012";
+char *badmodseq = "%.80s BAD Mailbox has no mod-sequences for %.80s\015\012";
 
 /* Message string driver for message stringstructs */
 
@@ -306,6 +355,7 @@ int main (int argc,char *argv[])
   logouthook_t lgoh;
   int ret = 0;
   time_t autologouttime = 0;
+  int startzip = NIL;
   char *pgmname;
 				/* if case we get borked immediately */
   if (setjmp (jmpenv)) _exit (1);
@@ -315,9 +365,26 @@ int main (int argc,char *argv[])
 				/* set service name before linkage */
   mail_parameters (NIL,SET_SERVICENAME,(void *) "imap");
 #include "linkage.c"
-  rfc822_date (tmp);		/* get date/time at startup */
+				/* standalone server? */
+  if ((argc > 1) && !strcmp (argv[1],"-d")) {
+    long workers = LISTENWORKERS;
+    long sessions = 0;
+    char *r;
+    if ((argc > 4) ||
+	((argc > 2) && (((workers = strtol (argv[2],&r,10)) < 1) || *r ||
+			(workers > MAXLISTENWORKERS))) ||
+	((argc > 3) && (((sessions = strtol (argv[3],&r,10)) < 0) || *r))) {
+      fprintf (stderr,"usage: %s -d [workers [sessions]]\n"
+	       "  workers must be from 1 to %d, sessions 0 or more\n",
+	       pgmname,MAXLISTENWORKERS);
+      exit (1);
+    }
+    mail_parameters (NIL,SET_LISTENWORKERS,(void *) workers);
+    mail_parameters (NIL,SET_LISTENSESSIONS,(void *) sessions);
+  }
 				/* initialize server */
   server_init (pgmname,"imap","imaps",clkint,kodint,hupint,trmint,staint);
+  rfc822_date (tmp);		/* get date/time at session startup */
 				/* forbid automatic untagged expunge */
   mail_parameters (NIL,SET_EXPUNGEATPING,NIL);
 				/* arm proxy copy callback */
@@ -651,23 +718,60 @@ int main (int argc,char *argv[])
       case OPEN:		/* valid only when mailbox open */
 				/* fetch mailbox attributes */
 	if (!strcmp (cmd,"FETCH") || !strcmp (cmd,"UID FETCH")) {
+	  unsigned long since = 0;
+	  long changed = NIL;
+	  long vanish = NIL;
+	  char *mods;
 	  if (!(arg && (s = strtok_r (arg," ",&sstate)) &&
 		(t = strtok_r (NIL,"\015\012",&sstate))))
 	    response = misarg;
+				/* CHANGEDSINCE modifier? */
+	  else if ((mods = fetch_modifiers ((char *) t)) &&
+		   !((changed = parse_modifier (&mods,"CHANGEDSINCE",
+						&since,(uid && qresync) ?
+						&vanish : NIL)) && !*mods))
+	    response = badatt;
+	  else if (changed && !MODSEQOK) response = badmodseq;
 	  else if (uid ? mail_uid_sequence (stream,s) :
-		   mail_sequence (stream,s)) fetch (t,uid);
+		   mail_sequence (stream,s)) {
+	    if (changed) {	/* only messages changed since */
+	      condstore = T;	/* this enables CONDSTORE */
+	      if (vanish) {	/* report expunged UIDs first */
+		SEARCHSET *set = NIL;
+		if (crit_set (&set,&s,stream->uid_last) && !*s) vanished (set);
+		mail_free_searchset (&set);
+	      }
+	      for (i = 1; i <= nmsgs; i++)
+		if (mail_elt (stream,i)->private.mod <= since)
+		  mail_elt (stream,i)->sequence = NIL;
+	    }
+	    fetch (t,uid,changed);
+	  }
 	  else response = badseq;
 	}
 				/* store mailbox attributes */
 	else if (!strcmp (cmd,"STORE") || !strcmp (cmd,"UID STORE")) {
+	  unsigned long since = 0;
+	  long unchanged = NIL;
+	  char *seq = NIL;
 				/* must have three arguments */
 	  if (!(arg && (s = strtok_r (arg," ",&sstate)) &&
+				/* possibly with UNCHANGEDSINCE modifier */
+		((*sstate != '(') ||
+		 ((unchanged = parse_modifier (&sstate,"UNCHANGEDSINCE",&since,
+					       NIL)) && (*sstate++ == ' '))) &&
 		(v = strtok_r (NIL," ",&sstate)) &&
 		(t = strtok_r (NIL,"\015\012",&sstate)))) response = misarg;
+	  else if (unchanged && !MODSEQOK) response = badmodseq;
 	  else if (!(uid ? mail_uid_sequence (stream,s) :
 		     mail_sequence (stream,s))) response = badseq;
 	  else {
 	    f = ST_SET | (uid ? ST_UID : NIL)|((v[5]&&v[6]) ? ST_SILENT : NIL);
+	    if (unchanged) {	/* conditional store */
+	      condstore = T;	/* this enables CONDSTORE */
+	      f &= ~ST_UID;	/* unchanged messages are by number */
+	      s = seq = unchanged_since (since,uid);
+	    }
 	    if (!strcmp (ucase (v),"FLAGS") || !strcmp (v,"FLAGS.SILENT")) {
 	      strcpy (tmp,"\\Answered \\Flagged \\Deleted \\Draft \\Seen");
 	      for (i = 0, u = tmp;
@@ -677,23 +781,40 @@ int main (int argc,char *argv[])
 		  *u++ = ' ';	/* write next flag */
 		  strcpy (u,v);
 		}
-	      mail_flag (stream,s,tmp,f & ~ST_SET);
+	      if (s) mail_flag (stream,s,tmp,f & ~ST_SET);
 	    }
 	    else if (!strcmp (v,"-FLAGS") || !strcmp (v,"-FLAGS.SILENT"))
 	      f &= ~ST_SET;	/* clear flags */
 	    else if (strcmp (v,"+FLAGS") && strcmp (v,"+FLAGS.SILENT")) {
+	      if (seq) fs_give ((void **) &seq);
+	      if (modset) mail_free_searchset (&modset);
 	      response = badatt;
 	      break;
 	    }
 				/* find last keyword */
 	    for (i = 0; (i < NUSERFLAGS) && stream->user_flags[i]; i++);
-	    mail_flag (stream,s,t,f);
+	    if (s) mail_flag (stream,s,t,f);
 				/* any new keywords appeared? */
 	    if (i < NUSERFLAGS && stream->user_flags[i]) new_flags (stream);
 				/* return flags if silence not wanted */
-	    if (uid ? mail_uid_sequence (stream,s) : mail_sequence (stream,s))
-	      for (i = 1; i <= nmsgs; i++) if (mail_elt(stream,i)->sequence)
-		mail_elt (stream,i)->spare2 = (f & ST_SILENT) ? NIL : T;
+	    if (s && ((f & ST_UID) ? mail_uid_sequence (stream,s) :
+		      mail_sequence (stream,s)))
+	      for (i = 1; i <= nmsgs; i++) if (mail_elt(stream,i)->sequence) {
+		if (!(f & ST_SILENT)) flags_changed (stream,i);
+		else {		/* silent, but CONDSTORE wants modseq */
+		  mail_elt (stream,i)->spare2 = NIL;
+		  if (condstore && MODSEQOK) {
+		    PSOUT ("* ");
+		    pnum (i);
+		    PSOUT (" FETCH (");
+		    fetch_uid (i,NIL);
+		    PBOUT (' ');
+		    fetch_modseq (i,NIL);
+		    PSOUT (")\015\012");
+		  }
+		}
+	      }
+	    if (seq) fs_give ((void **) &seq);
 	  }
 	}
 
@@ -716,6 +837,8 @@ int main (int argc,char *argv[])
 	    mail_expunge_full (stream,arg,arg ? EX_UID : NIL);
 				/* remember last checkpoint */
 	    lastcheck = time (0);
+				/* CONDSTORE wants new HIGHESTMODSEQ */
+	    tagmodseq = condstore && MODSEQOK;
 	  }
 	}
 				/* close mailbox */
@@ -908,12 +1031,19 @@ int main (int argc,char *argv[])
 	  }
 				/* must have arguments here */
 	  if (!(arg && *arg)) break;
+	  searchmodseq = NIL;	/* no MODSEQ criterion seen yet */
 	  if (parse_criteria (pgm = mail_newsearchpgm (),&arg,nmsgs,
 			      uidmax (stream),0) && !*arg) {
 	    response = win;	/* looks good, try the search */
 	    mail_search_full (stream,charset,pgm,SE_FREE);
 				/* output search results if success */
 	    if (response == win) {
+	      unsigned long maxmod = 0;
+	      if (searchmodseq)	/* MODSEQ criterion wants highest match */
+		for (i = 1; i <= nmsgs; ++i)
+		  if (mail_elt (stream,i)->searched &&
+		      (mail_elt (stream,i)->private.mod > maxmod))
+		    maxmod = mail_elt (stream,i)->private.mod;
 	      if (retval) {	/* ESEARCH desired */
 		PSOUT ("* ESEARCH (TAG ");
 		pstring (tag);
@@ -1002,6 +1132,10 @@ int main (int argc,char *argv[])
 		  PSOUT (" COUNT ");
 		  pnum (j);
 		}
+		if (maxmod) {	/* highest mod-sequence if MODSEQ */
+		  PSOUT (" MODSEQ ");
+		  pnum (maxmod);
+		}
 	      }
 	      else {		/* standard search */
 		PSOUT ("* SEARCH");
@@ -1010,6 +1144,11 @@ int main (int argc,char *argv[])
 		    PBOUT (' ');
 		    pnum (uid ? mail_uid (stream,i) : i);
 		  }
+		if (maxmod) {	/* highest mod-sequence if MODSEQ */
+		  PSOUT (" (MODSEQ ");
+		  pnum (maxmod);
+		  PBOUT (')');
+		}
 	      }
 	      CRLF;
 	    }
@@ -1023,9 +1162,12 @@ int main (int argc,char *argv[])
 				/* select new mailbox */
 	  if (!(strcmp (cmd,"SELECT") && strcmp (cmd,"EXAMINE") &&
 		strcmp (cmd,"BBOARD"))) {
-				/* single argument */
+	  QRESYNCARGS qr;
+	  memset (&qr,0,sizeof (QRESYNCARGS));
+				/* mailbox and optional parameters */
 	  if (!(s = snarf (&arg))) response = misarg;
-	  else if (arg) response = badarg;
+	  else if (arg && (*cmd == 'B')) response = badarg;
+	  else if (arg && !parse_select (arg,&qr)) response = badsel;
 	  else if (nameok (NIL,s = bboardname (cmd,s))) {
 	    DRIVER *factory = mail_valid (NIL,s,NIL);
 	    f = anonymous ? OP_ANONYMOUS | OP_READONLY :
@@ -1037,6 +1179,10 @@ int main (int argc,char *argv[])
 	    if (lastst.data) fs_give ((void **) &lastst.data);
 	    nflags = 0;		/* force update */
 	    nmsgs = recent = 0xffffffff;
+	    nchgflags = 0;	/* forget flag changes in old mailbox */
+	    chgflagsall = NIL;
+	    if (qresync && (state == OPEN))
+	      PSOUT ("* OK [CLOSED] Previous mailbox closed\015\012");
 	    if (factory && !strcmp (factory->name,"phile") &&
 		(stream = mail_open (stream,s,f | OP_SILENT)) &&
 		(response == win)) {
@@ -1072,6 +1218,8 @@ int main (int argc,char *argv[])
 
 	    if (stream && (response == win)) {
 	      state = OPEN;	/* note state open */
+				/* parameter enables CONDSTORE */
+	      if (qr.condstore) condstore = T;
 	      if (lastsel) fs_give ((void **) &lastsel);
 				/* canonicalize INBOX */
 	      if (!compare_cstring (s,"#MHINBOX"))
@@ -1084,6 +1232,13 @@ int main (int argc,char *argv[])
 		syslog (LOG_INFO,"Anonymous select of %.80s host=%.80s",
 			stream->mailbox,tcp_clienthost ());
 	      lastcheck = 0;	/* no last check */
+	      if (qr.uidvalidity) {
+		ping_mailbox (uid);	/* report mailbox state first */
+				/* resynchronize if same UID validity */
+		if ((state == OPEN) && MODSEQOK &&
+		    (qr.uidvalidity == stream->uid_validity))
+		  qresync_select (&qr);
+	      }
 	    }
 	    else {		/* failed, nuke old selection */
 	      if (stream) stream = mail_close (stream);
@@ -1124,7 +1279,8 @@ int main (int argc,char *argv[])
 				/* get reference and mailbox argument */
 	  if (!((s = snarf (&arg)) && (t = snarf_list (&arg))))
 	    response = misarg;
-	  else if (arg) response = badarg;
+				/* RETURN options for LIST-STATUS */
+	  else if (arg && !list_return (arg,&f)) response = badarg;
 				/* make sure anonymous can't do bad things */
 	  else if (nameok (s,t)) {
 	    if (newsproxypattern (s,t,tmp,LONGT)) {
@@ -1132,6 +1288,12 @@ int main (int argc,char *argv[])
 	      mail_list (NIL,"",tmp);
 	      proxylist = NIL;
 	    }
+	    else if (arg && f) {/* collect names, then status of each */
+	      liststatus = f;
+	      mail_list (NIL,s,t);
+	      liststatus = NIL;
+	      list_status (f);
+	    }
 	    else mail_list (NIL,s,t);
 	  }
 	  if (stream)		/* allow untagged EXPUNGE */
@@ -1201,61 +1363,13 @@ int main (int argc,char *argv[])
 		(t = strchr (arg,')')) && (t - arg) && !t[1]))
 	    response = misarg;
 	  else {
-	    f = NIL;		/* initially no flags */
 	    *t = '\0';		/* tie off flag string */
-				/* read flags */
-	    t = strtok_r (ucase (arg)," ",&sstate);
-	    do {		/* parse each one; unknown generate warning */
-	      if (!strcmp (t,"MESSAGES")) f |= SA_MESSAGES;
-	      else if (!strcmp (t,"RECENT")) f |= SA_RECENT;
-	      else if (!strcmp (t,"UNSEEN")) f |= SA_UNSEEN;
-	      else if (!strcmp (t,"UIDNEXT")) f |= SA_UIDNEXT;
-	      else if (!strcmp (t,"UIDVALIDITY")) f |= SA_UIDVALIDITY;
-	      else {
-		PSOUT ("* NO Unknown status flag ");
-		PSOUT (t);
-		CRLF;
-	      }
-	    } while (t = strtok_r (NIL," ",&sstate));
+	    f = status_flags (arg);
 	    ping_mailbox (uid);	/* in case the fool did STATUS on open mbx */
 	    PFLUSH ();		/* make sure stdout is dumped in case slave */
-	    if (!compare_cstring (s,"INBOX")) s = "INBOX";
-	    else if (!compare_cstring (s,"#MHINBOX")) s = "#MHINBOX";
 	    if (state == LOGOUT) response = lose;
 				/* get mailbox status */
-	    else if (lastsel && (!strcmp (s,lastsel) ||
-				 (stream && !strcmp (s,stream->mailbox)))) {
-	      unsigned long unseen;
-				/* snarl at cretins which do this */
-	      PSOUT ("* NO CLIENT BUG DETECTED: STATUS on selected mailbox: ");
-	      PSOUT (s);
-	      CRLF;
-	      tmp[0] = ' '; tmp[1] = '\0';
-	      if (f & SA_MESSAGES)
-		sprintf (tmp + strlen (tmp)," MESSAGES %lu",stream->nmsgs);
-	      if (f & SA_RECENT)
-		sprintf (tmp + strlen (tmp)," RECENT %lu",stream->recent);
-	      if (f & SA_UNSEEN) {
-		for (i = 1,unseen = 0; i <= stream->nmsgs; i++)
-		  if (!mail_elt (stream,i)->seen) unseen++;
-		sprintf (tmp + strlen (tmp)," UNSEEN %lu",unseen);
-	      }
-	      if (f & SA_UIDNEXT)
-		sprintf (tmp + strlen (tmp)," UIDNEXT %lu",stream->uid_last+1);
-	      if (f & SA_UIDVALIDITY)
-		sprintf (tmp + strlen(tmp)," UIDVALIDITY %lu",
-			 stream->uid_validity);
-	      tmp[1] = '(';
-	      strcat (tmp,")\015\012");
-	      PSOUT ("* STATUS ");
-	      pastring (s);
-	      PSOUT (tmp);
-	    }
-	    else if (isnewsproxy (s)) {
-	      sprintf (tmp,"{%.300s/nntp}%.300s",nntpproxy,(char *) s+6);
-	      if (!mail_status (NIL,tmp,f)) response = lose;
-	    }
-	    else if (!mail_status (NIL,s,f)) response = lose;
+	    else if (!status_mailbox (s,f,LONGT)) response = lose;
 	  }
 	  if (stream)		/* allow untagged EXPUNGE */
 	    mail_parameters (stream,SET_ONETIMEEXPUNGEATPING,(void *) stream);
@@ -1379,18 +1493,53 @@ int main (int argc,char *argv[])
 	    mail_parameters (stream,SET_ONETIMEEXPUNGEATPING,(void *) stream);
 	}
 
+				/* enable extensions */
+	else if (!strcmp (cmd,"ENABLE")) {
+	  if (!arg) response = misarg;
+				/* RFC 5161 only allows before SELECT */
+	  else if (state != SELECT) response = badenb;
+	  else {		/* report only those newly enabled */
+	    PSOUT ("* ENABLED");
+	    for (s = strtok_r (ucase (arg)," ",&sstate); s;
+		 s = strtok_r (NIL," ",&sstate)) {
+	      if (!strcmp (s,"CONDSTORE") && !condstore) {
+		condstore = T;
+		PSOUT (" CONDSTORE");
+	      }
+	      else if (!strcmp (s,"QRESYNC") && !qresync) {
+		condstore = qresync = T;
+		PSOUT (" QRESYNC");
+	      }
+	    }
+	    CRLF;
+	  }
+	}
+
+				/* start compression */
+	else if (!strcmp (cmd,"COMPRESS")) {
+	  if (!(s = snarf (&arg))) response = misarg;
+	  else if (arg || compare_cstring (s,"DEFLATE")) response = badarg;
+	  else if (lsterr = deflate_start (NIL)) response = lose;
+	  else startzip = T;	/* start after the response is sent */
+	}
+
 				/* idle mode */
 	else if (!strcmp (cmd,"IDLE")) {
 				/* no arguments */
 	  if (arg) response = badarg;
 	  else {		/* tell client ready for argument */
 	    unsigned long donefake = 0;
+	    long wake = NIL;
+	    int wd = -1;
+	    time_t tick = 0;
 	    PSOUT ("+ Waiting for DONE\015\012");
 	    PFLUSH ();		/* dump output buffer */
 				/* inactivity countdown */
 	    i = ((TIMEOUT) / (IDLETIMER)) + 1;
 	    do {		/* main idle loop */
 	      if (!donefake) {	/* don't ping mailbox if faking */
+				/* watch for changes from now on */
+		wd = (state == OPEN) ? mail_watch (stream) : -1;
 		mail_parameters (stream,SET_ONETIMEEXPUNGEATPING,
 				 (void *) stream);
 		ping_mailbox (uid);
@@ -1411,19 +1560,27 @@ int main (int argc,char *argv[])
 		CRLF;
 		fs_give ((void **) &lstwrn);
 	      }
-	      if (!(i % 2)) {	/* prevent NAT timeouts */
-		sprintf (tmp,"* OK Timeout in %lu minutes\015\012",
-			 (i * IDLETIMER) / 60);
-		PSOUT (tmp);
-	      }
+	      if (!wake) {	/* woken up by the timer? */
+		if (!(i % 2)) {	/* prevent NAT timeouts */
+		  sprintf (tmp,"* OK Timeout in %lu minutes\015\012",
+			   (i * IDLETIMER) / 60);
+		  PSOUT (tmp);
+		}
 				/* two minutes before the end... */
-	      if ((state == OPEN) && (i <= 2)) {
-		sprintf (tmp,"* %lu EXISTS\015\012* %lu RECENT\015\012",
-			 donefake = nmsgs + 1,recent + 1);
-		PSOUT (tmp);	/* prod client to wake up */
+		if ((state == OPEN) && (i <= 2)) {
+		  sprintf (tmp,"* %lu EXISTS\015\012* %lu RECENT\015\012",
+			   donefake = nmsgs + 1,recent + 1);
+		  PSOUT (tmp);	/* prod client to wake up */
+		  wd = -1;	/* no more pings, so stop watching */
+		}
+				/* next timer wakeup */
+		tick = time (0) + IDLETIMER;
 	      }
 	      PFLUSH ();	/* dump output buffer */
-	    } while ((state != LOGOUT) && !INWAIT (IDLETIMER) && --i);
+				/* a mailbox change doesn't count down */
+	    } while ((state != LOGOUT) &&
+		     (((wake = INWATCH (max (tick - time (0),1),wd)) < 0) ||
+		      (!wake && --i)));
 
 				/* time to exit idle loop */
 	    if (state != LOGOUT) {
@@ -1536,11 +1693,22 @@ int main (int argc,char *argv[])
 	  pset (&caset);
 	  PSOUT ("] ");
 	}
+	else if (modset) {	/* messages STORE UNCHANGEDSINCE skipped? */
+	  PSOUT ("[MODIFIED ");
+	  pset (&modset);
+	  PSOUT ("] ");
+	}
+	else if (tagmodseq) {	/* new HIGHESTMODSEQ after expunge? */
+	  PSOUT ("[HIGHESTMODSEQ ");
+	  pnum (highestmodseq ());
+	  PSOUT ("] ");
+	}
 	else if (lstref) {	/* have a referral? */
 	  PSOUT ("[REFERRAL ");
 	  PSOUT (lstref);
 	  PSOUT ("] ");
 	}
+	tagmodseq = NIL;	/* cancel response for future */
 	if (lsterr || lstwrn) PSOUT (lasterror ());
 	else {
 	  PSOUT (cmd);
@@ -1562,6 +1730,10 @@ int main (int argc,char *argv[])
       }
     }
     PFLUSH ();			/* make sure output blatted */
+    if (startzip) {		/* COMPRESS response sent, now compress */
+      startzip = NIL;
+      if (s = (unsigned char *) deflate_start ("DEFLATE")) fatal ((char *) s);
+    }
 
     if (autologouttime) {	/* have an autologout in effect? */
 				/* cancel if no longer waiting for login */
@@ -1595,7 +1767,7 @@ int main (int argc,char *argv[])
 
 void ping_mailbox (unsigned long uid)
 {
-  unsigned long i;
+  unsigned long i,j;
   char tmp[MAILTMPLEN];
   if (state == OPEN) {
     if (!mail_ping (stream)) {	/* make sure stream still alive */
@@ -1632,6 +1804,12 @@ void ping_mailbox (unsigned long uid)
       PSOUT ("] UID validity status\015\012* OK [UIDNEXT ");
       pnum (stream->uid_last + 1);
       PSOUT ("] Predicted next UID\015\012");
+      if (MODSEQOK) {		/* report mod-sequences if we have them */
+	PSOUT ("* OK [HIGHESTMODSEQ ");
+	pnum (highestmodseq ());
+	PSOUT ("] Highest\015\012");
+      }
+      else PSOUT ("* OK [NOMODSEQ] No permanent mod-sequences\015\012");
       if (stream->uid_nosticky) {
 	PSOUT ("* NO [UIDNOTSTICKY] Non-permanent unique identifiers: ");
 	PSOUT (stream->mailbox);
@@ -1645,17 +1823,27 @@ void ping_mailbox (unsigned long uid)
 				/* first report any new flags */
       if ((nflags < NUSERFLAGS) && stream->user_flags[nflags])
 	new_flags (stream);
-      for (i = 1; i <= nmsgs; i++) if (mail_elt (stream,i)->spare2) {
-	PSOUT ("* ");
-	pnum (i);
-	PSOUT (" FETCH (");
-	fetch_flags (i,NIL);	/* output changed flags */
-	if (uid) {		/* need to include UIDs in response? */
-	  PBOUT (' ');
-	  fetch_uid (i,NIL);
+				/* then any changed flags */
+      for (j = 0; chgflagsall ? (j < nmsgs) : (j < nchgflags); j++)
+	if (((i = chgflagsall ? j + 1 : chgflags[j]) <= nmsgs) &&
+	    mail_elt (stream,i)->spare2) {
+	  PSOUT ("* ");
+	  pnum (i);
+	  PSOUT (" FETCH (");
+	  fetch_flags (i,NIL);	/* output changed flags */
+				/* need to include UIDs in response? */
+	  if (uid || condstore) {
+	    PBOUT (' ');
+	    fetch_uid (i,NIL);
+	  }
+	  if (condstore && MODSEQOK) {
+	    PBOUT (' ');	/* CONDSTORE wants new mod-sequence */
+	    fetch_modseq (i,NIL);
+	  }
+	  PSOUT (")\015\012");
 	}
-	PSOUT (")\015\012");
-      }
+      nchgflags = 0;		/* all changes reported */
+      chgflagsall = NIL;
     }
     else {			/* driver changed */
       new_flags (stream);	/* send mailbox flags */
@@ -1701,6 +1889,33 @@ void ping_mailbox (unsigned long uid)
       useralerttime = palert (mailboxfile (tmp,USERALERTFILE),useralerttime);
   }
 }
+
+
+/* Note message with changed flags to report
+ * Accepts: MAIL stream
+ *	    message number
+ */
+
+void flags_changed (MAILSTREAM *stream,unsigned long msgno)
+{
+  MESSAGECACHE *elt = mail_elt (stream,msgno);
+  if (!elt->spare2) {		/* not already pending? */
+    elt->spare2 = T;		/* note flags need reporting */
+    if (chgflagsall);		/* already checking all messages */
+				/* more changes than messages? */
+    else if (nchgflags >= stream->nmsgs) chgflagsall = T;
+    else {			/* grow list if necessary */
+      if (nchgflags >= chgflagsmax) {
+	chgflagsmax = chgflagsmax ? chgflagsmax * 2 : 64;
+	if (chgflags) fs_resize ((void **) &chgflags,
+				 chgflagsmax * sizeof (unsigned long));
+	else chgflags = (unsigned long *)
+	       fs_get (chgflagsmax * sizeof (unsigned long));
+      }
+      chgflags[nchgflags++] = msgno;
+    }
+  }
+}
 
 /* Print an alert file
  * Accepts: path of alert file
@@ -2307,6 +2522,65 @@ unsigned char *snarf_list (unsigned char **arg)
   return ((c == ' ') || !c) ? s : NIL;
 }
 
+/* Parse LIST return options
+ * Accepts: argument text
+ *	    pointer to return status flags
+ * Returns: T if valid, NIL if bad syntax
+ *
+ * Only the CHILDREN option (which is always in effect) and the STATUS
+ * option of LIST-STATUS (RFC 5819) are supported.
+ */
+
+long list_return (unsigned char *arg,long *status)
+{
+  unsigned char *s;
+  *status = NIL;		/* initially no status wanted */
+  if (strncmp (ucase (arg),"RETURN (",8)) return NIL;
+  for (arg += 8; *arg != ')';) {
+    if (!strncmp (arg,"CHILDREN",8)) arg += 8;
+    else if (!strncmp (arg,"STATUS (",8) && (s = strchr (arg += 8,')')) &&
+	     (s != arg)) {
+      *s = '\0';		/* tie off status item list */
+      *status |= status_flags (arg);
+      arg = s + 1;
+    }
+    else return NIL;		/* unknown or malformed option */
+    if (*arg == ' ') ++arg;	/* skip delimiter between options */
+    else if (*arg != ')') return NIL;
+  }
+  return arg[1] ? NIL : LONGT;	/* must be end of command */
+}
+
+
+/* Parse status items
+ * Accepts: status item list
+ * Returns: status flags
+ */
+
+long status_flags (unsigned char *arg)
+{
+  char *t,*r;
+  long ret = NIL;		/* initially no flags */
+  for (t = strtok_r (ucase (arg)," ",&r); t; t = strtok_r (NIL," ",&r)) {
+				/* parse each one; unknown generate warning */
+    if (!strcmp (t,"MESSAGES")) ret |= SA_MESSAGES;
+    else if (!strcmp (t,"RECENT")) ret |= SA_RECENT;
+    else if (!strcmp (t,"UNSEEN")) ret |= SA_UNSEEN;
+    else if (!strcmp (t,"UIDNEXT")) ret |= SA_UIDNEXT;
+    else if (!strcmp (t,"UIDVALIDITY")) ret |= SA_UIDVALIDITY;
+    else if (!strcmp (t,"HIGHESTMODSEQ")) {
+      ret |= SA_HIGHESTMODSEQ;
+      condstore = T;		/* this enables CONDSTORE */
+    }
+    else {
+      PSOUT ("* NO Unknown status flag ");
+      PSOUT (t);
+      CRLF;
+    }
+  }
+  return ret;
+}
+
 /* Get a list of header lines
  * Accepts: pointer to string pointer
  *	    pointer to list flag
@@ -2464,6 +2738,19 @@ long parse_criterion (SEARCHPGM *pgm,unsigned char **arg,unsigned long maxmsg,
       if (!strcmp (s+1,"ARGER") && c == ' ' && *++tail)
 	ret = crit_number (&pgm->larger,&tail);
       break;
+    case 'M':			/* possible MODSEQ */
+      if (!strcmp (s+1,"ODSEQ") && c == ' ' && *++tail && MODSEQOK) {
+	if (*tail == '"') {	/* skip over entry name and type */
+	  for (++tail; *tail && (*tail != '"'); ++tail)
+	    if ((*tail == '\\') && tail[1]) ++tail;
+	  if ((*tail++ != '"') || (*tail++ != ' ')) break;
+	  while (*tail && (*tail != ' ')) ++tail;
+	  if (*tail++ != ' ') break;
+	}
+	if (ret = crit_number (&pgm->modseq,&tail))
+	  searchmodseq = condstore = T;
+      }
+      break;
     case 'N':			/* possible NEW, NOT */
       if (!strcmp (s+1,"EW")) ret = pgm->recent = pgm->unseen = T;
       else if (!strcmp (s+1,"OT") && c == ' ' && *++tail) {
@@ -2713,18 +3000,19 @@ long crit_string (STRINGLIST **string,unsigned char **arg)
 /* Fetch message data
  * Accepts: string of data items to be fetched (must be writeable)
  *	    UID fetch flag
+ *	    MODSEQ fetch flag
  */
 
 #define MAXFETCH 100
 
-void fetch (char *t,unsigned long uid)
+void fetch (char *t,unsigned long uid,long modseq)
 {
   fetchfn_t f[MAXFETCH +2];
   void *fa[MAXFETCH + 2];
   int k;
   memset ((void *) f,NIL,sizeof (f));
   memset ((void *) fa,NIL,sizeof (fa));
-  fetch_work (t,uid,f,fa);	/* do the work */
+  fetch_work (t,uid,modseq,f,fa);/* do the work */
 				/* clean up arguments */
   for (k = 1; f[k]; k++) if (fa[k]) (*f[k]) (0,fa[k]);
 }
@@ -2733,11 +3021,13 @@ void fetch (char *t,unsigned long uid)
 /* Fetch message data worker routine
  * Accepts: string of data items to be fetched (must be writeable)
  *	    UID fetch flag
+ *	    MODSEQ fetch flag
  *	    function dispatch vector
  *	    function argument vector
  */
 
-void fetch_work (char *t,unsigned long uid,fetchfn_t f[],void *fa[])
+void fetch_work (char *t,unsigned long uid,long modseq,fetchfn_t f[],
+		 void *fa[])
 {
   unsigned char *s,*v;
   unsigned long i;
@@ -2750,6 +3040,10 @@ void fetch_work (char *t,unsigned long uid,fetchfn_t f[],void *fa[])
     fa[k] = NIL;		/* no argument */
     f[k++] = fetch_uid;		/* push a UID fetch on the stack */
   }
+  if (modseq) {			/* CHANGEDSINCE implies MODSEQ */
+    fa[k] = NIL;
+    f[k++] = fetch_modseq;
+  }
 
 				/* process macros */
   if (!strcmp (ucase (t),"ALL"))
@@ -2769,6 +3063,17 @@ void fetch_work (char *t,unsigned long uid,fetchfn_t f[],void *fa[])
       if (!uid) f[k++] = fetch_uid;
     }
     else if (!strcmp (s,"FLAGS")) f[k++] = fetch_flags;
+    else if (!strcmp (s,"MODSEQ")) {
+      if (!MODSEQOK) {		/* mailbox must have mod-sequences */
+	response = badmodseq;
+	return;
+      }
+      condstore = T;		/* this enables CONDSTORE */
+      if (!modseq) {		/* no-op if implicit */
+	modseq = T;
+	f[k++] = fetch_modseq;
+      }
+    }
     else if (!strcmp (s,"INTERNALDATE")) f[k++] = fetch_internaldate;
     else if (!strcmp (s,"RFC822.SIZE")) f[k++] = fetch_rfc822_size;
     else if (!strcmp (s,"ENVELOPE")) {
@@ -3317,6 +3622,10 @@ void changed_flags (unsigned long i,int f)
   if (!f && mail_elt (stream,i)->seen) {
     PBOUT (' ');		/* yes, delimit with space */
     fetch_flags (i,NIL);	/* output flags */
+    if (condstore && MODSEQOK) {
+      PBOUT (' ');		/* flag change made a new mod-sequence */
+      fetch_modseq (i,NIL);
+    }
   }
 }
 
@@ -3349,6 +3658,19 @@ void fetch_uid (unsigned long i,void *args)
   PSOUT ("UID ");
   pnum (mail_uid (stream,i));
 }
+
+
+/* Fetch modification sequence
+ * Accepts: message number
+ *	    extra argument
+ */
+
+void fetch_modseq (unsigned long i,void *args)
+{
+  PSOUT ("MODSEQ (");
+  pnum (mail_elt (stream,i)->private.mod);
+  PBOUT (')');
+}
 
 /* Fetch complete RFC-822 format message
  * Accepts: message number
@@ -3850,8 +4172,10 @@ void pbodypartstring (unsigned long msgno,char *id,SIZEDTEXT *st,STRING *bs,
 	st->data += ta->first;	/* move to desired position */
 	st->size -= ta->first;	/* reduced size */
       }
-      else if (bs && (SIZE (bs) >= ta->first))
+      else if (bs && (SIZE (bs) >= ta->first)) {
 	SETPOS (bs,ta->first + GETPOS (bs));
+	st->size -= ta->first;	/* reduced size */
+      }
       else st->size = 0;	/* shouldn't happen */
       if (ta->last && (st->size > ta->last)) st->size = ta->last;
     }
@@ -3875,10 +4199,34 @@ void pbodypartstring (unsigned long msgno,char *id,SIZEDTEXT *st,STRING *bs,
 
 void ptext (SIZEDTEXT *txt,STRING *st)
 {
+  SIZEDTEXT t;
   unsigned char c,*s;
   unsigned long i = txt->size;
-  if (s = txt->data) while (i && ((PBOUT ((c = *s++) ? c : 0x80) != EOF))) --i;
-  else if (st) while (i && (PBOUT ((c = SNX (st)) ? c : 0x80) != EOF)) --i;
+  if (s = txt->data) while (i) {/* write runs of text between NULs */
+    t.data = s;
+    t.size = (s = memchr (s,'\0',i)) ? s - t.data : i;
+    if (t.size && (PSOUTR (&t) == EOF)) break;
+    if (i -= t.size) {		/* at a NUL */
+      if (PBOUT (0x80) == EOF) break;
+      s++;
+      i--;
+    }
+  }
+  else if (st) while (i) {	/* write stringstruct a chunk at a time */
+				/* last byte in chunk is left for SNX */
+    t.size = (st->cursize > 1) ? min (i,st->cursize - 1) : 0;
+    t.data = (unsigned char *) st->curpos;
+    if (t.size && (s = memchr (t.data,'\0',t.size)))
+      t.size = s - t.data;
+    if (t.size) {		/* write this part of the chunk */
+      if (PSOUTR (&t) == EOF) break;
+      st->curpos += t.size;
+      st->cursize -= t.size;
+      i -= t.size;
+    }
+    else if (PBOUT ((c = SNX (st)) ? c : 0x80) == EOF) break;
+    else --i;
+  }
 				/* failed to complete? */
   if (i) ioerror (stdout,"writing text");
 }
@@ -3936,12 +4284,15 @@ void pcapability (long flag)
 #ifdef ESEARCH
     PSOUT (" ESEARCH");
 #endif
-    PSOUT (" WITHIN SORT");
+    PSOUT (" WITHIN SORT ENABLE CONDSTORE QRESYNC LIST-STATUS");
     while (thr) {		/* threaders */
       PSOUT (" THREAD=");
       PSOUT (thr->name);
       thr = thr->next;
     }
+				/* compression available */
+    if (!(s = deflate_start (NIL))) PSOUT (" COMPRESS=DEFLATE");
+    else fs_give ((void **) &s);
     if (!anonymous) PSOUT (" MULTIAPPEND");
     PSOUT (" SCAN");		/* private extension */
   }
@@ -3962,6 +4313,85 @@ void pcapability (long flag)
   }
 }
 
+/* Return status of mailbox
+ * Accepts: mailbox name
+ *	    status flags
+ *	    non-zero to complain about STATUS of selected mailbox
+ * Returns: T on success, NIL on failure
+ */
+
+long status_mailbox (char *name,long flags,long snarl)
+{
+  unsigned long i,unseen;
+  char tmp[MAILTMPLEN];
+  if (!compare_cstring (name,"INBOX")) name = "INBOX";
+  else if (!compare_cstring (name,"#MHINBOX")) name = "#MHINBOX";
+  if (lastsel && (!strcmp (name,lastsel) ||
+		  (stream && !strcmp (name,stream->mailbox)))) {
+    if (snarl) {		/* snarl at cretins which do this */
+      PSOUT ("* NO CLIENT BUG DETECTED: STATUS on selected mailbox: ");
+      PSOUT (name);
+      CRLF;
+    }
+    tmp[0] = ' '; tmp[1] = '\0';
+    if (flags & SA_MESSAGES)
+      sprintf (tmp + strlen (tmp)," MESSAGES %lu",stream->nmsgs);
+    if (flags & SA_RECENT)
+      sprintf (tmp + strlen (tmp)," RECENT %lu",stream->recent);
+    if (flags & SA_UNSEEN) {
+      for (i = 1,unseen = 0; i <= stream->nmsgs; i++)
+	if (!mail_elt (stream,i)->seen) unseen++;
+      sprintf (tmp + strlen (tmp)," UNSEEN %lu",unseen);
+    }
+    if (flags & SA_UIDNEXT)
+      sprintf (tmp + strlen (tmp)," UIDNEXT %lu",stream->uid_last+1);
+    if (flags & SA_UIDVALIDITY)
+      sprintf (tmp + strlen(tmp)," UIDVALIDITY %lu",stream->uid_validity);
+    if (flags & SA_HIGHESTMODSEQ)
+      sprintf (tmp + strlen(tmp)," HIGHESTMODSEQ %lu",highestmodseq ());
+    tmp[1] = '(';
+    strcat (tmp,")\015\012");
+    PSOUT ("* STATUS ");
+    pastring (name);
+    PSOUT (tmp);
+    return LONGT;
+  }
+  if (isnewsproxy (name)) {
+    sprintf (tmp,"{%.300s/nntp}%.300s",nntpproxy,(char *) name+6);
+    return mail_status (NIL,tmp,flags);
+  }
+  return mail_status (NIL,name,flags);
+}
+
+/* Return status of mailboxes found by LIST-STATUS
+ * Accepts: status flags
+ *
+ * The LIST responses are all sent first, then the STATUS of each selectable
+ * mailbox.  A mailbox whose status can't be had is just left out, and does
+ * not fail the LIST.
+ */
+
+void list_status (long flags)
+{
+  STRINGLIST *sl;
+  char *r = response;
+  PFLUSH ();			/* client can see the LIST responses now */
+  while (sl = liststatusnames) {
+    liststatusnames = sl->next;
+    if (state != LOGOUT) {	/* unless lost the connection */
+      status_mailbox ((char *) sl->text.data,flags,NIL);
+      if (response != r) {	/* forget any error */
+	response = r;
+	if (lsterr) fs_give ((void **) &lsterr);
+      }
+      PFLUSH ();
+    }
+    sl->next = NIL;		/* free this name only */
+    mail_free_stringlist (&sl);
+  }
+  liststatustail = &liststatusnames;
+}
+
 /* Anonymous users may only use these mailboxes in these namespaces */
 
 char *oktab[] = {"#news.", "#ftp/", "#public/", 0};
@@ -4336,6 +4766,245 @@ char *referral (MAILSTREAM *stream,char *url,long code)
   return NIL;			/* don't chase referrals for now */
 }
 
+/* Get highest mod-sequence of selected mailbox
+ * Returns: highest mod-sequence, or 0 if mailbox has none
+ */
+
+unsigned long highestmodseq (void)
+{
+  return MODSEQOK ? (unsigned long)
+    mail_parameters (stream,GET_HIGHESTMODSEQ,(void *) stream) : 0;
+}
+
+
+/* Split modifiers from FETCH attribute list
+ * Accepts: attribute list (must be writeable)
+ * Returns: modifier list, or NIL if none
+ *
+ * The attribute list is tied off before the modifiers.
+ */
+
+char *fetch_modifiers (char *t)
+{
+  int depth = 0;
+  for (; *t; t++) switch (*t) {
+  case '"':			/* skip over quoted string */
+    while (*++t != '"') if (!*t || ((*t == '\\') && !*++t)) return NIL;
+    break;
+  case '(': case '[':		/* nest list or section */
+    depth++;
+    break;
+  case ')': case ']':		/* unnest list or section */
+    depth--;
+    break;
+  case ' ':			/* space outside list ends attributes */
+    if (!depth) {
+      *t++ = '\0';		/* tie off attributes */
+      return t;
+    }
+    break;
+  }
+  return NIL;
+}
+
+
+/* Parse a FETCH or STORE modifier list
+ * Accepts: pointer to modifier list pointer
+ *	    modifier name
+ *	    where to return modifier value
+ *	    where to return VANISHED flag, or NIL if not permitted
+ * Returns: T if success with list pointer updated, NIL if error
+ */
+
+long parse_modifier (char **arg,char *name,unsigned long *value,
+		     long *vanished)
+{
+  long ret = NIL;
+  unsigned long i = strlen (name);
+  char *s,*t;
+  if ((**arg == '(') && (t = strchr (s = *arg + 1,')'))) {
+    *t = '\0';			/* tie off and canonicalize modifiers */
+    if (!strncmp (ucase (s),name,i) && (s[i] == ' ') && isdigit (s[i+1])) {
+      *value = strtoul (s + i + 1,&s,10);
+      if (vanished && !strcmp (s," VANISHED")) {
+	*vanished = T;		/* UID FETCH wants VANISHED response */
+	s += 9;
+      }
+      if (!*s) {		/* must be end of list */
+	*arg = t + 1;		/* skip past list */
+	ret = LONGT;
+      }
+    }
+    *t = ')';			/* restore delimiter */
+  }
+  return ret;
+}
+
+/* Parse SELECT/EXAMINE parameters
+ * Accepts: parameter list
+ *	    where to return QRESYNC parameters
+ * Returns: T if success, NIL if error
+ */
+
+long parse_select (unsigned char *arg,QRESYNCARGS *qr)
+{
+  int c;
+  if (*arg++ != '(') return NIL;
+  ucase (arg);			/* parameters are case-independent */
+  do {
+    if (!strncmp (arg,"CONDSTORE",9)) {
+      qr->condstore = T;	/* this enables CONDSTORE */
+      arg += 9;
+    }
+				/* QRESYNC (uidvalidity modseq ...) */
+    else if (qresync && !strncmp (arg,"QRESYNC (",9) && isdigit (arg[9]) &&
+	     (qr->uidvalidity = strtoul (arg + 9,(char **) &arg,10)) &&
+	     (*arg++ == ' ') && isdigit (*arg)) {
+      qr->modseq = strtoul (arg,(char **) &arg,10);
+      if (*arg == ' ') {	/* known UIDs follow? */
+	for (qr->uids = ++arg; isdigit (*arg) || (*arg == ':') ||
+	       (*arg == ',') || (*arg == '*'); arg++);
+	c = *arg;		/* tie off known UIDs */
+	*arg++ = '\0';
+				/* ignore sequence match data */
+	if ((c == ' ') && (*arg++ == '(') && (arg = strchr (arg,')')) &&
+	    *++arg) c = *arg++;
+	if (c != ')') return NIL;
+      }
+      else if (*arg++ != ')') return NIL;
+      qr->condstore = T;	/* QRESYNC implies CONDSTORE */
+    }
+    else return NIL;		/* unknown parameter */
+  } while (*arg == ' ' && *++arg);
+  return ((*arg == ')') && !arg[1]) ? LONGT : NIL;
+}
+
+
+/* Resynchronize mailbox for QRESYNC
+ * Accepts: QRESYNC parameters
+ */
+
+void qresync_select (QRESYNCARGS *qr)
+{
+  unsigned long i;
+  unsigned char *s = qr->uids ? qr->uids : (unsigned char *) "1:*";
+  SEARCHSET *set = NIL;
+  if (crit_set (&set,&s,stream->uid_last) && !*s) {
+    vanished (set);		/* report expunged UIDs first */
+				/* then messages changed since */
+    for (i = 1; i <= stream->nmsgs; i++)
+      if ((mail_elt (stream,i)->private.mod > qr->modseq) &&
+	  set_member (set,mail_uid (stream,i))) {
+	PSOUT ("* ");
+	pnum (i);
+	PSOUT (" FETCH (");
+	fetch_uid (i,NIL);
+	PBOUT (' ');
+	fetch_flags (i,NIL);
+	PBOUT (' ');
+	fetch_modseq (i,NIL);
+	PSOUT (")\015\012");
+      }
+  }
+  mail_free_searchset (&set);
+}
+
+/* Report expunged UIDs
+ * Accepts: set of UIDs known to client
+ */
+
+void vanished (SEARCHSET *set)
+{
+  unsigned long i,j,k,first,last;
+  SEARCHSET *ret = NIL;
+  SEARCHSET **tail = &ret;
+  for (; set; set = set->next) {
+    first = set->first;		/* normalize range */
+    last = set->last ? set->last : first;
+    if (first > last) {
+      i = first;
+      first = last;
+      last = i;
+    }
+    if (!first) first = 1;	/* can't know about UIDs not yet assigned */
+    if (last > stream->uid_last) last = stream->uid_last;
+				/* find first message with UID in range */
+    for (i = 1, j = stream->nmsgs + 1; i < j; )
+      if (mail_uid (stream,k = (i + j) / 2) < first) i = k + 1;
+      else j = k;
+				/* gaps between messages are expunged UIDs */
+    for (; first <= last; first = k + 1, i++) {
+      k = (i <= stream->nmsgs) ? mail_uid (stream,i) : last + 1;
+      if (k > first) {		/* found a gap? */
+	*tail = mail_newsearchset ();
+	(*tail)->first = first;
+	if ((j = min (k - 1,last)) > first) (*tail)->last = j;
+	tail = &(*tail)->next;
+      }
+    }
+  }
+  if (ret) {			/* output if any expunged */
+    PSOUT ("* VANISHED (EARLIER) ");
+    pset (&ret);
+    CRLF;
+  }
+}
+
+/* Test for membership in a set
+ * Accepts: set
+ *	    number to test
+ * Returns: T if number in set, else NIL
+ */
+
+long set_member (SEARCHSET *set,unsigned long n)
+{
+  for (; set; set = set->next)
+    if (set->last ? (((n >= set->first) && (n <= set->last)) ||
+		     ((n >= set->last) && (n <= set->first))) :
+	(n == set->first)) return LONGT;
+  return NIL;
+}
+
+
+/* Drop messages changed since a mod-sequence from STORE
+ * Accepts: mod-sequence
+ *	    UID STORE flag
+ * Returns: fs_get'd sequence of messages remaining, or NIL if none
+ *
+ * The dropped messages are left in modset for the MODIFIED response.
+ */
+
+char *unchanged_since (unsigned long since,unsigned long uid)
+{
+  unsigned long i,j,k;
+  char *s,*ret = NIL;
+  SEARCHSET *tail = NIL;
+  MESSAGECACHE *elt;
+  if (modset) mail_free_searchset (&modset);
+  for (i = 1, j = 0; i <= nmsgs; i++)
+    if ((elt = mail_elt (stream,i))->sequence) {
+      if (elt->private.mod > since) {
+	elt->sequence = NIL;	/* changed, drop from STORE */
+	tail = mail_append_set (tail ? tail : (modset = mail_newsearchset ()),
+				uid ? mail_uid (stream,i) : i);
+      }
+      else j++;			/* count unchanged messages */
+    }
+  if (j) {			/* make sequence of unchanged messages */
+				/* worst case is j ranges of two numbers */
+    s = ret = (char *) fs_get (j * 44 + 1);
+    for (i = 1; i <= nmsgs; i++) if (mail_elt (stream,i)->sequence) {
+      for (k = i; (k < nmsgs) && mail_elt (stream,k + 1)->sequence; k++);
+      if (k > i) sprintf (s,"%lu:%lu,",i,k);
+      else sprintf (s,"%lu,",i);
+      s += strlen (s);
+      i = k;			/* skip past range */
+    }
+    s[-1] = '\0';		/* flush trailing comma */
+  }
+  return ret;
+}
+
 /* Co-routines from MAIL library */
 
 
@@ -4380,12 +5049,25 @@ void mm_expunged (MAILSTREAM *s,unsigned long number)
 {
   if (quell_events) fatal ("Impossible EXPUNGE event");
   if (s != tstream) {
-    PSOUT ("* ");
-    pnum (number);
-    PSOUT (" EXPUNGE\015\012");
+    if (qresync) {		/* QRESYNC reports UIDs instead */
+      PSOUT ("* VANISHED ");
+      pnum (mail_uid (s,number));
+    }
+    else {
+      PSOUT ("* ");
+      pnum (number);
+      PSOUT (" EXPUNGE");
+    }
+    CRLF;
   }
   nmsgs--;
   existsquelled = T;		/* do EXISTS when command done */
+  if ((s != tstream) && !chgflagsall) {
+    unsigned long i,j;		/* renumber pending flag changes */
+    for (i = j = 0; i < nchgflags; i++) if (chgflags[i] != number)
+      chgflags[j++] = chgflags[i] - ((chgflags[i] > number) ? 1 : 0);
+    nchgflags = j;
+  }
 }
 
 
@@ -4396,7 +5078,7 @@ void mm_expunged (MAILSTREAM *s,unsigned long number)
 
 void mm_flags (MAILSTREAM *s,unsigned long number)
 {
-  if (s != tstream) mail_elt (s,number)->spare2 = T;
+  if (s != tstream) flags_changed (s,number);
 }
 
 /* Mailbox found
@@ -4408,6 +5090,13 @@ void mm_flags (MAILSTREAM *s,unsigned long number)
 void mm_list (MAILSTREAM *stream,int delimiter,char *name,long attributes)
 {
   mm_list_work ("LIST",delimiter,name,attributes);
+				/* note selectable mailbox for LIST-STATUS */
+  if (liststatus && !(attributes & (LATT_NOSELECT|LATT_REFERRAL))) {
+    *liststatustail = mail_newstringlist ();
+    (*liststatustail)->text.data = (unsigned char *) cpystr (name);
+    (*liststatustail)->text.size = strlen (name);
+    liststatustail = &(*liststatustail)->next;
+  }
 }
 
 
@@ -4444,6 +5133,8 @@ void mm_status (MAILSTREAM *stream,char *mailbox,MAILSTATUS *status)
       sprintf (tmp + strlen (tmp)," UIDNEXT %lu",status->uidnext);
     if (status->flags & SA_UIDVALIDITY)
       sprintf (tmp + strlen(tmp)," UIDVALIDITY %lu",status->uidvalidity);
+    if (status->flags & SA_HIGHESTMODSEQ)
+      sprintf (tmp + strlen(tmp)," HIGHESTMODSEQ %lu",status->highestmodseq);
     PSOUT ("* STATUS ");
     pastring (mailbox);
     PSOUT (" (");
@@ -44,6 +44,11 @@ extern int errno;		/* just in case */
 #define TIMEOUT 60*10
 
 
+/* Standalone server */
+#define LISTENWORKERS 4		/* default number of workers */
+#define MAXLISTENWORKERS 1000	/* maximum number of workers */
+
+
 /* Server states */
 
 #define AUTHORIZATION 0
@@ -115,6 +120,23 @@ int main (int argc,char *argv[])
 				/* set service name before linkage */
   mail_parameters (NIL,SET_SERVICENAME,(void *) "pop");
 #include "linkage.c"
+				/* standalone server? */
+  if ((argc > 1) && !strcmp (argv[1],"-d")) {
+    long workers = LISTENWORKERS;
+    long sessions = 0;
+    char *r;
+    if ((argc > 4) ||
+	((argc > 2) && (((workers = strtol (argv[2],&r,10)) < 1) || *r ||
+			(workers > MAXLISTENWORKERS))) ||
+	((argc > 3) && (((sessions = strtol (argv[3],&r,10)) < 0) || *r))) {
+      fprintf (stderr,"usage: %s -d [workers [sessions]]\n"
+	       "  workers must be from 1 to %d, sessions 0 or more\n",
+	       pgmname,MAXLISTENWORKERS);
+      exit (1);
+    }
+    mail_parameters (NIL,SET_LISTENWORKERS,(void *) workers);
+    mail_parameters (NIL,SET_LISTENSESSIONS,(void *) sessions);
+  }
 				/* initialize server */
   server_init (pgmname,"pop3","pop3s",clkint,kodint,hupint,trmint,NIL);
   mail_parameters (NIL,SET_BLOCKENVINIT,VOIDT);
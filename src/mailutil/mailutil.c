@@ -42,6 +42,7 @@ int kwcopyp = NIL;		/* flag saying keyword copy */
 int ignorep = NIL;		/* flag saying ignore keywords */
 int critical = NIL;		/* flag saying in critical code */
 int trycreate = NIL;		/* [TRYCREATE] seen */
+int errorp = NIL;		/* flag saying error logged */
 char *suffix = NIL;		/* suffer merge mode suffix text */
 int ddelim = -1;		/* destination delimiter */
 FILE *f = NIL;
@@ -51,6 +52,7 @@ FILE *f = NIL;
 char *usage2 = "usage: %s %s\n\n%s\n";
 char *usage3 = "usage: %s %s %s\n\n%s\n";
 char *usgchk = "check [MAILBOX]";
+char *usgcmp = "compact MAILBOX";
 char *usgcre = "create MAILBOX";
 char *usgdel = "delete MAILBOX";
 char *usgren = "rename SOURCE DESTINATION";
@@ -257,6 +259,19 @@ int main (int argc,char *argv[])
 			  src,SA_MESSAGES | SA_RECENT | SA_UNSEEN))
       retcode = 0;
   }
+  else if (!strcmp (cmd,"compact")) {
+    if (!src || dst || merge || rwcopyp || kwcopyp || ignorep)
+      printf (usage2,pgm,usgcmp,stdsw);
+    else {			/* reclaim all expunged space at once */
+      mail_parameters (NIL,SET_MIXBURPBUDGET,NIL);
+      if ((source = mail_open (NIL,src,(debugp ? OP_DEBUG : NIL))) &&
+	  !source->rdonly) {
+	errorp = NIL;		/* fails if check logs an error */
+	mail_check (source);
+	if (!errorp) retcode = 0;
+      }
+    }
+  }
   else if (!strcmp (cmd,"create")) {
     if (!src || dst || merge || rwcopyp || kwcopyp || ignorep)
       printf (usage2,pgm,usgcre,stdsw);
@@ -411,6 +426,8 @@ int main (int argc,char *argv[])
     printf (usage2,pgm,"command [switches] arguments",stdsw);
     printf ("\nCommands:\n %s\n",usgchk);
     puts   ("   ;; report number of messages and new messages");
+    printf (" %s\n",usgcmp);
+    puts   ("   ;; reclaim space of expunged messages");
     printf (" %s\n",usgcre);
     puts   ("   ;; create new mailbox");
     printf (" %s\n",usgdel);
@@ -861,6 +878,7 @@ void mm_log (char *string,long errflg)
     break;
   case ERROR:			/* error */
   default:
+    errorp = T;			/* note error for caller */
     fprintf (stderr,"%s\n",string);
     break;
   }
@@ -43,6 +43,17 @@ char *ssl_start_tls (char *server)
 {
   return cpystr ("This server does not support TLS");
 }
+
+
+/* Start compression
+ * Accepts: NIL to probe, else algorithm name
+ * Returns: cpystr'd error string if compression is not possible, else NIL
+ */
+
+char *deflate_start (char *s)
+{
+  return cpystr ("This server does not support compression");
+}
 
 /* Get character
  * Returns: character or EOF
@@ -99,6 +110,20 @@ long INWAIT (long seconds)
 {
   return server_input_wait (seconds);
 }
+
+
+/* Wait for input or mailbox change
+ * Accepts: timeout in seconds
+ *	    descriptor from mail_watch(), or -1
+ * Returns: T if have input on stdin, else NIL
+ *
+ * Mailbox changes are not watched on this system.
+ */
+
+long INWATCH (long seconds,int fd)
+{
+  return server_input_wait (seconds);
+}
 
 /* Put character
  * Accepts: character
@@ -34,6 +34,29 @@ extern int errno;		/* just in case */
 #include <sys/stat.h>
 #include "dummy.h"
 #include "misc.h"
+
+/* Listing cache record */
+
+typedef struct list_record {
+  char *name;			/* name of entry in directory */
+  time_t mtime;			/* directory time of attributes, 0 if none */
+  long attributes;		/* directory attributes */
+  unsigned int dir : 1;		/* entry is a directory */
+  struct list_record *next;	/* next record */
+} LISTRECORD;
+
+
+/* Listing cache of one directory */
+
+typedef struct list_cache {
+  time_t mtime;			/* directory time */
+  time_t now;			/* time cache was loaded */
+  unsigned int valid : 1;	/* records are current */
+  unsigned int dirty : 1;	/* records need to be written */
+  LISTRECORD *records;		/* records */
+  LISTRECORD **tail;		/* where to append next record */
+  char file[MAILTMPLEN];	/* cache file name */
+} LISTCACHE;
 
 /* Function prototypes */
 
@@ -41,8 +64,15 @@ DRIVER *dummy_valid (char *name);
 void *dummy_parameters (long function,void *value);
 void dummy_list_work (MAILSTREAM *stream,char *dir,char *pat,char *contents,
 		      long level);
+void dummy_list_dir (MAILSTREAM *stream,char *dir,char *name,char *pat,
+		     char *contents,long level,LISTCACHE *lc,LISTRECORD *lr);
 long dummy_listed (MAILSTREAM *stream,char delimiter,char *name,
 		   long attributes,char *contents);
+long dummy_list_attributes (char *name,long attributes,DRIVER **d);
+LISTCACHE *dummy_cache_load (char *dir);
+LISTRECORD *dummy_cache_add (LISTCACHE *lc,char *name,int dir);
+void dummy_cache_flush (LISTCACHE *lc);
+void dummy_cache_close (LISTCACHE **lc);
 long dummy_subscribe (MAILSTREAM *stream,char *mailbox);
 MAILSTREAM *dummy_open (MAILSTREAM *stream);
 void dummy_close (MAILSTREAM *stream,long options);
@@ -93,7 +123,8 @@ DRIVER dummydriver = {
   dummy_expunge,		/* expunge deleted messages */
   dummy_copy,			/* copy messages to another mailbox */
   dummy_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -270,14 +301,19 @@ void dummy_list_work (MAILSTREAM *stream,char *dir,char *pat,char *contents,
 {
   DRIVER *drivers;
   dirfmttest_t dt;
-  DIR *dp;
+  DIR *dp = NIL;
   struct direct *d;
   struct stat sbuf;
   char tmp[MAILTMPLEN],path[MAILTMPLEN];
   size_t len = 0;
+  LISTCACHE *lc;
+  LISTRECORD *lr;
 				/* punt if bogus name */
   if (!mailboxdir (tmp,dir,NIL)) return;
-  if (dp = opendir (tmp)) {	/* do nothing if can't open directory */
+				/* listing cache can't search contents */
+  lc = contents ? NIL : dummy_cache_load (tmp);
+				/* do nothing if can't open directory */
+  if ((lc && lc->valid) || (dp = opendir (tmp))) {
 				/* see if a non-namespace directory format */
     for (drivers = (DRIVER *) mail_parameters (NIL,GET_DRIVERS,NIL), dt = NIL;
 	 dir && !dt && drivers; drivers = drivers->next)
@@ -287,55 +323,255 @@ void dummy_list_work (MAILSTREAM *stream,char *dir,char *pat,char *contents,
 				/* list it if at top-level */
     if (!level && dir && pmatch_full (dir,pat,'/') && !pmatch (dir,"INBOX"))
       dummy_listed (stream,'/',dir,dt ? NIL : LATT_NOSELECT,contents);
-
+
+    if (!dir || dir[(len = strlen (dir)) - 1] == '/') {
+				/* list from cache if it is current */
+      if (!dp) for (lr = lc->records; lr; lr = lr->next) {
+	if (lr->dir)
+	  dummy_list_dir (stream,dir,lr->name,pat,contents,level,lc,lr);
+	else {			/* ordinary name */
+	  if (dir) sprintf (tmp,"%s%s",dir,lr->name);
+	  else strcpy (tmp,lr->name);
+	  if (pmatch_full (tmp,pat,'/') && compare_cstring (tmp,"INBOX"))
+	    dummy_listed (stream,'/',tmp,LATT_NOINFERIORS,contents);
+	}
+      }
 				/* scan directory, ignore . and .. */
-    if (!dir || dir[(len = strlen (dir)) - 1] == '/') while (d = readdir (dp))
-      if ((!(dt && (*dt) (d->d_name))) &&
-	  ((d->d_name[0] != '.') ||
-	   (((long) mail_parameters (NIL,GET_HIDEDOTFILES,NIL)) ? NIL :
-	    (d->d_name[1] && (((d->d_name[1] != '.') || d->d_name[2]))))) &&
-	  ((len + strlen (d->d_name)) <= NETMAXMBX)) {
+      else while (d = readdir (dp))
+	if ((!(dt && (*dt) (d->d_name))) &&
+	    ((d->d_name[0] != '.') ||
+	     (((long) mail_parameters (NIL,GET_HIDEDOTFILES,NIL)) ? NIL :
+	      (d->d_name[1] && (((d->d_name[1] != '.') || d->d_name[2]))))) &&
+	    ((len + strlen (d->d_name)) <= NETMAXMBX)) {
 				/* see if name is useful */
-	if (dir) sprintf (tmp,"%s%s",dir,d->d_name);
-	else strcpy (tmp,d->d_name);
+	  if (dir) sprintf (tmp,"%s%s",dir,d->d_name);
+	  else strcpy (tmp,d->d_name);
 				/* make sure useful and can get info */
-	if ((pmatch_full (strcpy (path,tmp),pat,'/') ||
-	     pmatch_full (strcat (path,"/"),pat,'/') ||
-	     dmatch (path,pat,'/')) &&
-	    mailboxdir (path,dir,"x") && (len = strlen (path)) &&
-	    strcpy (path+len-1,d->d_name) && !stat (path,&sbuf)) {
+	  if ((lc || pmatch_full (strcpy (path,tmp),pat,'/') ||
+	       pmatch_full (strcat (path,"/"),pat,'/') ||
+	       dmatch (path,pat,'/')) &&
+	      mailboxdir (path,dir,"x") && (len = strlen (path)) &&
+	      strcpy (path+len-1,d->d_name) && !stat (path,&sbuf)) {
 				/* only interested in file type */
-	  switch (sbuf.st_mode & S_IFMT) {
-	  case S_IFDIR:		/* directory? */
-				/* form with trailing / */
-	    sprintf (path,"%s/",tmp);
-				/* skip listing if INBOX */
-	    if (!pmatch (tmp,"INBOX")) {
-	      if (pmatch_full (tmp,pat,'/')) {
-		if (!dummy_listed (stream,'/',tmp,LATT_NOSELECT,contents))
-		  break;
-	      }
-				/* try again with trailing / */
-	      else if (pmatch_full (path,pat,'/') &&
-		       !dummy_listed (stream,'/',path,LATT_NOSELECT,contents))
-		break;
-	    }
-	    if (dmatch (path,pat,'/') &&
-		(level < (long) mail_parameters (NIL,GET_LISTMAXLEVEL,NIL)))
-	      dummy_list_work (stream,path,pat,contents,level+1);
-	    break;
-	  case S_IFREG:		/* ordinary name */
+	    switch (sbuf.st_mode & S_IFMT) {
+	    case S_IFDIR:	/* directory? */
+	      dummy_list_dir (stream,dir,d->d_name,pat,contents,level,lc,
+			      lc ? dummy_cache_add (lc,d->d_name,T) : NIL);
+	      break;
+	    case S_IFREG:	/* ordinary name */
+				/* listing cache doesn't know marks */
+	      if (lc) dummy_cache_add (lc,d->d_name,NIL);
 	    /* Must use ctime for systems that don't update mtime properly */
-	    if (pmatch_full (tmp,pat,'/') && compare_cstring (tmp,"INBOX"))
-	      dummy_listed (stream,'/',tmp,LATT_NOINFERIORS +
-			    ((sbuf.st_size && (sbuf.st_atime < sbuf.st_ctime))?
-			     LATT_MARKED : LATT_UNMARKED),contents);
-	    break;
+	      if (pmatch_full (tmp,pat,'/') && compare_cstring (tmp,"INBOX"))
+		dummy_listed (stream,'/',tmp,LATT_NOINFERIORS +
+			      (lc ? NIL : (sbuf.st_size &&
+					   (sbuf.st_atime < sbuf.st_ctime)) ?
+			       LATT_MARKED : LATT_UNMARKED),contents);
+	      break;
+	    }
+	  }
+	}
+				/* cache what the scan found */
+      if (dp && lc) lc->dirty = T;
+    }
+    if (dp) closedir (dp);	/* all done, flush directory */
+  }
+  if (lc) dummy_cache_close (&lc);
+}
+
+/* Dummy list subdirectory
+ * Accepts: mail stream
+ *	    directory name
+ *	    name of subdirectory in directory
+ *	    search pattern
+ *	    string to scan
+ *	    search level
+ *	    listing cache or NIL
+ *	    listing cache record of subdirectory if listing cache
+ */
+
+void dummy_list_dir (MAILSTREAM *stream,char *dir,char *name,char *pat,
+		     char *contents,long level,LISTCACHE *lc,LISTRECORD *lr)
+{
+  DRIVER *d;
+  struct stat sbuf;
+  char tmp[MAILTMPLEN],path[MAILTMPLEN];
+  size_t len;
+  if (dir) sprintf (tmp,"%s%s",dir,name);
+  else strcpy (tmp,name);
+  sprintf (path,"%s/",tmp);	/* form with trailing / */
+				/* skip listing if INBOX */
+  if (!pmatch (tmp,"INBOX") &&
+      (pmatch_full (tmp,pat,'/') || pmatch_full (path,pat,'/'))) {
+    if (!lc) {			/* try again with trailing / */
+      if (!dummy_listed (stream,'/',pmatch_full (tmp,pat,'/') ? tmp : path,
+			 LATT_NOSELECT,contents)) return;
+    }
+    else {			/* cached attributes still good? */
+      if (!(mailboxdir (path,dir,"x") && (len = strlen (path)) &&
+	    strcpy (path+len-1,name) && !stat (path,&sbuf)))
+	sbuf.st_mtime = 0;	/* no, always look inside */
+      if (!lr->mtime || (lr->mtime != sbuf.st_mtime)) {
+	lr->attributes = dummy_list_attributes (tmp,LATT_NOSELECT,&d);
+				/* only keep if directory settled */
+	lr->mtime = (sbuf.st_mtime < lc->now) ? sbuf.st_mtime : 0;
+	lc->dirty = T;
+      }
+      sprintf (path,"%s/",tmp);
+      mm_list (stream,'/',pmatch_full (tmp,pat,'/') ? tmp : path,
+	       lr->attributes);
+    }
+  }
+  if (dmatch (path,pat,'/') &&
+      (level < (long) mail_parameters (NIL,GET_LISTMAXLEVEL,NIL)))
+    dummy_list_work (stream,path,pat,contents,level+1);
+}
+
+/* Dummy load listing cache
+ * Accepts: directory file name
+ * Returns: listing cache, or NIL if not caching
+ *
+ * A listing cache file holds the names and types of the entries of one
+ * directory, with the attributes of those subdirectories which have been
+ * listed, so that a later LIST need not stat each entry or look inside each
+ * subdirectory.  It is named by the directory device and inode and is only
+ * used while the directory modification time is unchanged.  The attributes
+ * of a subdirectory are likewise only used while its own modification time
+ * is unchanged.  Nothing is cached about a directory modified during the
+ * second in which it was looked at.
+ */
+
+LISTCACHE *dummy_cache_load (char *dir)
+{
+  int fd,isdir;
+  long attributes;
+  time_t mtime;
+  char *s,*t,*end,*data;
+  char *cdir = (char *) mail_parameters (NIL,GET_LISTCACHEDIR,NIL);
+  long hide = (long) mail_parameters (NIL,GET_HIDEDOTFILES,NIL);
+  struct stat sbuf,fbuf;
+  LISTCACHE *lc;
+  LISTRECORD *lr;
+				/* do nothing if not caching */
+  if (!cdir || ((strlen (cdir) + strlen (myhomedir ())) > (MAILTMPLEN - 40)) ||
+      stat (dir,&sbuf) || ((sbuf.st_mode & S_IFMT) != S_IFDIR)) return NIL;
+  lc = (LISTCACHE *) memset (fs_get (sizeof (LISTCACHE)),0,sizeof (LISTCACHE));
+  lc->tail = &lc->records;
+  lc->mtime = sbuf.st_mtime;
+  lc->now = time (0);
+				/* relative names are in home directory */
+  if (*cdir == '/') strcpy (lc->file,cdir);
+  else sprintf (lc->file,"%s/%s",myhomedir (),cdir);
+				/* create cache directory if necessary */
+  if (stat (lc->file,&fbuf) && mkdir (lc->file,S_IRWXU)) {
+    fs_give ((void **) &lc);
+    return NIL;
+  }
+				/* cache named by directory device and inode */
+  sprintf (lc->file + strlen (lc->file),"/%lx.%lx.list",
+	   (unsigned long) sbuf.st_dev,(unsigned long) sbuf.st_ino);
+  if ((fd = open (lc->file,O_RDONLY,NIL)) < 0) return lc;
+				/* must be our own file */
+  if (!fstat (fd,&fbuf) && (fbuf.st_uid == geteuid ())) {
+    end = (data = (char *) fs_get (fbuf.st_size + 1)) + fbuf.st_size;
+    *end = '\0';		/* tie off data */
+				/* only load if directory unchanged */
+    if ((read (fd,data,fbuf.st_size) == fbuf.st_size) && (*data == 'L') &&
+	isxdigit (data[1]) &&
+	((time_t) strtoul (data+1,&s,16) == sbuf.st_mtime) &&
+	(*s++ == ':') && isdigit (*s) && (strtol (s,&s,10) == hide) &&
+	(*s++ == '\015') && (*s++ == '\012'))
+      for (lc->valid = T; lc->valid && (s < end); s = t + 2) {
+	if ((t = strstr (s,"\015\012")) && ((*s == 'D') || (*s == 'F')) &&
+	    isxdigit (s[1])) {
+	  *t = '\0';		/* tie off record line */
+	  isdir = (*s++ == 'D');
+	  mtime = (time_t) strtoul (s,&s,16);
+	  if ((*s++ == ':') && isxdigit (*s) &&
+	      ((attributes = strtol (s,&s,16)) >= 0) && (*s++ == ':') && *s) {
+	    lr = dummy_cache_add (lc,s,isdir);
+	    lr->mtime = mtime;
+	    lr->attributes = attributes;
+	    continue;
 	  }
 	}
+	lc->valid = NIL;	/* cache damaged */
       }
-    closedir (dp);		/* all done, flush directory */
+    fs_give ((void **) &data);
+  }
+  close (fd);
+  if (!lc->valid) dummy_cache_flush (lc);
+  return lc;
+}
+
+/* Dummy add listing cache record
+ * Accepts: listing cache
+ *	    name of entry in directory
+ *	    non-zero if entry is a directory
+ * Returns: new record
+ */
+
+LISTRECORD *dummy_cache_add (LISTCACHE *lc,char *name,int dir)
+{
+  LISTRECORD *lr = (LISTRECORD *) memset (fs_get (sizeof (LISTRECORD)),0,
+					  sizeof (LISTRECORD));
+  lr->name = cpystr (name);
+  lr->dir = dir;
+  *lc->tail = lr;		/* append to list */
+  lc->tail = &lr->next;
+  return lr;
+}
+
+
+/* Dummy flush listing cache records
+ * Accepts: listing cache
+ */
+
+void dummy_cache_flush (LISTCACHE *lc)
+{
+  LISTRECORD *lr;
+  while (lr = lc->records) {
+    lc->records = lr->next;
+    fs_give ((void **) &lr->name);
+    fs_give ((void **) &lr);
+  }
+  lc->tail = &lc->records;
+}
+
+/* Dummy write and close listing cache
+ * Accepts: pointer to listing cache
+ *
+ * The new cache is written to a temporary file which is then renamed, so
+ * sessions reading the cache never see a partial file.
+ */
+
+void dummy_cache_close (LISTCACHE **lc)
+{
+  int i;
+  FILE *f;
+  LISTRECORD *lr;
+  char tmp[MAILTMPLEN];
+				/* only write if directory settled */
+  if ((*lc)->dirty && ((*lc)->mtime < (*lc)->now)) {
+    for (lr = (*lc)->records; lr && !strpbrk (lr->name,"\015\012");
+	 lr = lr->next);
+				/* can't cache names with newlines */
+    if (!lr && ((strlen ((*lc)->file) + 20) < MAILTMPLEN)) {
+      sprintf (tmp,"%.*s.%lx",MAILTMPLEN - 20,(*lc)->file,
+	       (unsigned long) getpid ());
+      if (f = fopen (tmp,"wb")) {
+	fprintf (f,"L%08lx:%ld\015\012",(unsigned long) (*lc)->mtime,
+		 (long) mail_parameters (NIL,GET_HIDEDOTFILES,NIL));
+	for (lr = (*lc)->records; lr; lr = lr->next)
+	  fprintf (f,"%c%08lx:%lx:%s\015\012",lr->dir ? 'D' : 'F',
+		   (unsigned long) lr->mtime,lr->attributes,lr->name);
+	i = ferror (f);		/* always close file */
+	if (fclose (f) || i || rename (tmp,(*lc)->file)) unlink (tmp);
+      }
+    }
   }
+  dummy_cache_flush (*lc);
+  fs_give ((void **) lc);
 }
 
 /* Scan file for contents
@@ -404,21 +640,43 @@ long dummy_listed (MAILSTREAM *stream,char delimiter,char *name,
 		   long attributes,char *contents)
 {
   DRIVER *d;
+  unsigned long csiz;
+  struct stat sbuf;
+  char *s,tmp[MAILTMPLEN];
+  attributes = dummy_list_attributes (name,attributes,&d);
+  if (!contents ||		/* notify main program */
+      (!(attributes & LATT_NOSELECT) && (csiz = strlen (contents)) &&
+       (s = mailboxfile (tmp,name)) &&
+       (*s || (s = mail_parameters (NIL,GET_INBOXPATH,tmp))) &&
+       !stat (s,&sbuf) && (d || (csiz <= sbuf.st_size)) &&
+       SAFE_SCAN_CONTENTS (d,tmp,contents,csiz,sbuf.st_size)))
+    mm_list (stream,delimiter,name,attributes);
+  return T;
+}
+
+
+/* Mailbox attributes
+ * Accepts: mailbox name
+ *	    attributes known so far
+ *	    pointer to return driver of \NoSelect name, or NIL
+ * Returns: attributes with children and selectability determined
+ */
+
+long dummy_list_attributes (char *name,long attributes,DRIVER **d)
+{
   DIR *dp;
   struct direct *dr;
   dirfmttest_t dt;
-  unsigned long csiz;
-  struct stat sbuf;
   int nochild;
-  char *s,tmp[MAILTMPLEN];
+  char tmp[MAILTMPLEN];
   if (!(attributes & LATT_NOINFERIORS) && mailboxdir (tmp,name,NIL) &&
       (dp = opendir (tmp))) {	/* if not \NoInferiors */
 				/* locate dirfmttest if any */
-    for (d = (DRIVER *) mail_parameters (NIL,GET_DRIVERS,NIL), dt = NIL;
-	 !dt && d; d = d->next)
-      if (!(d->flags & DR_DISABLE) && (d->flags & DR_DIRFMT) &&
-	  (*d->valid) (name))
-	dt = mail_parameters ((*d->open) (NIL),GET_DIRFMTTEST,NIL);
+    for (*d = (DRIVER *) mail_parameters (NIL,GET_DRIVERS,NIL), dt = NIL;
+	 !dt && *d; *d = (*d)->next)
+      if (!((*d)->flags & DR_DISABLE) && ((*d)->flags & DR_DIRFMT) &&
+	  (*(*d)->valid) (name))
+	dt = mail_parameters ((*(*d)->open) (NIL),GET_DIRFMTTEST,NIL);
 				/* scan directory for children */
     for (nochild = T; nochild && (dr = readdir (dp)); )
       if ((!(dt && (*dt) (dr->d_name))) &&
@@ -429,17 +687,10 @@ long dummy_listed (MAILSTREAM *stream,char delimiter,char *name,
     attributes |= nochild ? LATT_HASNOCHILDREN : LATT_HASCHILDREN;
     closedir (dp);		/* all done, flush directory */
   }
-  d = NIL;			/* don't \NoSelect dir if it has a driver */
-  if ((attributes & LATT_NOSELECT) && (d = mail_valid (NIL,name,NIL)) &&
-      (d != &dummydriver)) attributes &= ~LATT_NOSELECT;
-  if (!contents ||		/* notify main program */
-      (!(attributes & LATT_NOSELECT) && (csiz = strlen (contents)) &&
-       (s = mailboxfile (tmp,name)) &&
-       (*s || (s = mail_parameters (NIL,GET_INBOXPATH,tmp))) &&
-       !stat (s,&sbuf) && (d || (csiz <= sbuf.st_size)) &&
-       SAFE_SCAN_CONTENTS (d,tmp,contents,csiz,sbuf.st_size)))
-    mm_list (stream,delimiter,name,attributes);
-  return T;
+  *d = NIL;			/* don't \NoSelect dir if it has a driver */
+  if ((attributes & LATT_NOSELECT) && (*d = mail_valid (NIL,name,NIL)) &&
+      (*d != &dummydriver)) attributes &= ~LATT_NOSELECT;
+  return attributes;
 }
 
 /* Dummy create mailbox
@@ -70,9 +70,15 @@ static char *sysInbox = NIL;	/* system inbox name */
 static char *newsActive = NIL;	/* news active file */
 static char *newsSpool = NIL;	/* news spool */
 static char *blackBoxDir = NIL;	/* black box directory name */
+static char *sortcacheDir = NIL;/* sort cache directory name */
+static char *listcacheDir = NIL;/* list cache directory name */
+				/* status cache directory name */
+static char *statuscacheDir = NIL;
 				/* black box default home directory */
 static char *blackBoxDefaultHome = NIL;
 static char *sslCApath = NIL;	/* non-standard CA path */
+				/* SSL session cache directory name */
+static char *sslSessionDir = NIL;
 static short anonymous = NIL;	/* is anonymous */
 static short blackBox = NIL;	/* is a black box */
 static short closedBox = NIL;	/* is a closed box (uses chroot() jail) */
@@ -109,6 +115,11 @@ static short allowuserconfig = NIL;
 				/* 1 = disable plaintext, 2 = if not SSL */
 static long disablePlaintext = NIL;
 static long list_max_level = 20;/* maximum level of list recursion */
+				/* standalone server worker processes */
+static long listenWorkers = 0;
+				/* sessions per worker, 0 = no limit */
+static long listenSessions = 0;
+static pid_t *listenPids = NIL;	/* standalone server worker process IDs */
 				/* facility for syslog */
 static int syslog_facility = LOG_MAIL;
 
@@ -327,6 +338,24 @@ void *env_parameters (long function,void *value)
   case GET_PUBLICHOME:
     ret = (void *) publicHome;
     break;
+  case SET_SORTCACHEDIR:
+    if (sortcacheDir) fs_give ((void **) &sortcacheDir);
+    if (value) sortcacheDir = cpystr ((char *) value);
+  case GET_SORTCACHEDIR:
+    ret = (void *) sortcacheDir;
+    break;
+  case SET_LISTCACHEDIR:
+    if (listcacheDir) fs_give ((void **) &listcacheDir);
+    if (value) listcacheDir = cpystr ((char *) value);
+  case GET_LISTCACHEDIR:
+    ret = (void *) listcacheDir;
+    break;
+  case SET_STATUSCACHEDIR:
+    if (statuscacheDir) fs_give ((void **) &statuscacheDir);
+    if (value) statuscacheDir = cpystr ((char *) value);
+  case GET_STATUSCACHEDIR:
+    ret = (void *) statuscacheDir;
+    break;
   case SET_SHAREDHOME:
     if (sharedHome) fs_give ((void **) &sharedHome);
     sharedHome = cpystr ((char *) value);
@@ -346,6 +375,12 @@ void *env_parameters (long function,void *value)
   case GET_SSLCAPATH:
     ret = (void *) sslCApath;
     break;
+  case SET_SSLSESSIONCACHEDIR:
+    if (sslSessionDir) fs_give ((void **) &sslSessionDir);
+    if (value) sslSessionDir = cpystr ((char *) value);
+  case GET_SSLSESSIONCACHEDIR:
+    ret = (void *) sslSessionDir;
+    break;
   case SET_LISTMAXLEVEL:
     list_max_level = (long) value;
   case GET_LISTMAXLEVEL:
@@ -407,6 +442,16 @@ void *env_parameters (long function,void *value)
   case GET_LOCKTIMEOUT:
     ret = (void *) locktimeout;
     break;
+  case SET_LISTENWORKERS:
+    listenWorkers = (long) value;
+  case GET_LISTENWORKERS:
+    ret = (void *) listenWorkers;
+    break;
+  case SET_LISTENSESSIONS:
+    listenSessions = (long) value;
+  case GET_LISTENSESSIONS:
+    ret = (void *) listenSessions;
+    break;
   case SET_DISABLEFCNTLLOCK:
     fcntlhangbug = value ? T : NIL;
   case GET_DISABLEFCNTLLOCK:
@@ -576,6 +621,8 @@ void server_init (char *server,char *service,char *sslservice,
     int mask;
     openlog (myServerName = cpystr (server),LOG_PID,syslog_facility);
     fclose (stderr);		/* possibly save a process ID */
+				/* standalone server returns in session */
+    if (listenWorkers > 0) server_listen (server,service,sslservice);
     dorc (NIL,NIL);		/* do systemwide configuration */
     switch (mask = umask (022)){/* check old umask */
     case 0:			/* definitely unreasonable */
@@ -614,6 +661,127 @@ void server_init (char *server,char *service,char *sslservice,
   }
 }
 
+/* Standalone server worker
+ * Accepts: vector of listening sockets
+ *	    number of sockets in vector
+ *
+ * Only returns in a session process.
+ */
+
+static void server_listen_worker (int *fd,int n)
+{
+  int i,sock,maxfd;
+  long sessions;
+  fd_set rfd;
+  struct timeval tmo;
+  pid_t listener = getppid ();
+				/* session processes reap themselves */
+  arm_signal (SIGCHLD,SIG_IGN);
+  for (i = maxfd = 0; i < n; ++i) if (fd[i] > maxfd) maxfd = fd[i];
+  for (sessions = 0; (getppid () == listener) &&
+	 (!listenSessions || (sessions < listenSessions)); ) {
+    FD_ZERO (&rfd);
+    for (i = 0; i < n; ++i) FD_SET (fd[i],&rfd);
+    tmo.tv_sec = 60; tmo.tv_usec = 0;
+    if (select (maxfd + 1,&rfd,NIL,NIL,&tmo) > 0)
+      for (i = 0; i < n; ++i) if (FD_ISSET (fd[i],&rfd) &&
+				  ((sock = accept (fd[i],NIL,NIL)) >= 0))
+	switch (fork ()) {
+	case -1:		/* can't fork, drop the connection */
+	  syslog (LOG_ERR,"Unable to start session: %.80s",strerror (errno));
+	  close (sock);
+	  break;
+	case 0:			/* session */
+	  arm_signal (SIGCHLD,SIG_DFL);
+	  for (i = 0; i < n; ++i) close (fd[i]);
+	  fcntl (sock,F_SETFL,fcntl (sock,F_GETFL,0) & ~O_NONBLOCK);
+	  dup2 (sock,0);	/* connection is stdin and stdout */
+	  dup2 (sock,1);
+	  if (sock > 1) close (sock);
+	  setsid ();		/* detach from listener */
+	  return;
+	default:		/* worker counts its sessions */
+	  close (sock);
+	  ++sessions;
+	  break;
+	}
+  }
+  exit (0);			/* time for a fresh worker */
+}
+
+
+/* Standalone server stop
+ */
+
+static void server_listen_stop (void)
+{
+  long i;
+  for (i = 0; i < listenWorkers; ++i)
+    if (listenPids[i]) kill (listenPids[i],SIGTERM);
+  _exit (0);
+}
+
+/* Standalone server listener
+ * Accepts: server name
+ *	    /etc/services service name
+ *	    alternate /etc/services service name
+ *
+ * The listener binds the service ports and keeps a pool of worker processes
+ * waiting for connections on them.  A worker forks a session process for
+ * each connection it accepts, and exits after the configured number of
+ * sessions so that the listener starts a fresh one.  This only returns in
+ * a session process, with the connection on stdin and stdout; everything
+ * else a server does at startup is then done exactly as when started by
+ * inetd.
+ */
+
+void server_listen (char *server,char *service,char *sslservice)
+{
+  int fd[4];
+  int n = tcp_listen (sslservice,fd,tcp_listen (service,fd,0));
+  long i,spawned = 0;
+  time_t then = 0;
+  pid_t pid;
+  if (!n) {			/* must have at least one port */
+    syslog (LOG_ALERT,"%s unable to listen on any port",server);
+    exit (1);
+  }
+  ssl_server_prepare (server);	/* load certificates once for all sessions */
+  listenPids = (pid_t *) memset (fs_get (listenWorkers * sizeof (pid_t)),0,
+				 listenWorkers * sizeof (pid_t));
+  arm_signal (SIGHUP,server_listen_stop);
+  arm_signal (SIGINT,server_listen_stop);
+  arm_signal (SIGTERM,server_listen_stop);
+  syslog (LOG_INFO,"%s listening with %ld workers",server,listenWorkers);
+  for (;;) {			/* start any missing workers */
+    for (i = 0; i < listenWorkers; ++i) if (!listenPids[i]) {
+				/* don't spin if workers die at once */
+      if (then != time (0)) spawned = 0,then = time (0);
+      else if (++spawned > listenWorkers) sleep (1);
+      switch (pid = fork ()) {
+      case -1:			/* can't fork, try again later */
+	syslog (LOG_ERR,"%s unable to start worker: %.80s",server,
+		strerror (errno));
+	sleep (1);
+	break;
+      case 0:			/* worker, returns in session */
+	arm_signal (SIGHUP,SIG_DFL);
+	arm_signal (SIGINT,SIG_DFL);
+	arm_signal (SIGTERM,SIG_DFL);
+	fs_give ((void **) &listenPids);
+	server_listen_worker (fd,n);
+	return;
+      default:			/* listener notes its worker */
+	listenPids[i] = pid;
+	break;
+      }
+    }
+				/* wait for a worker to exit */
+    if ((pid = wait (NIL)) > 0) for (i = 0; i < listenWorkers; ++i)
+      if (listenPids[i] == pid) listenPids[i] = 0;
+  }
+}
+
 /* Wait for stdin input
  * Accepts: timeout in seconds
  * Returns: T if have input on stdin, else NIL
@@ -633,6 +801,67 @@ long server_input_wait (long seconds)
   } while (((err = select (1,&rfd,0,&efd,&tmo)) < 0) && (errno = EINTR));
   return err ? LONGT : NIL;
 }
+
+
+/* Wait for stdin input or mailbox change
+ * Accepts: timeout in seconds
+ *	    descriptor from watch_file(), or -1
+ * Returns: T if have input on stdin, -1 if change, else NIL
+ */
+
+long server_input_watch (long seconds,int fd)
+{
+  int err;
+  fd_set rfd,efd;
+  struct timeval tmo;
+  if (fd < 0) return server_input_wait (seconds);
+  do {
+    FD_ZERO (&rfd);
+    FD_ZERO (&efd);
+    FD_SET (0,&rfd);
+    FD_SET (0,&efd);
+    FD_SET (fd,&rfd);
+    tmo.tv_sec = seconds; tmo.tv_usec = 0;
+  } while (((err = select (fd+1,&rfd,0,&efd,&tmo)) < 0) && (errno == EINTR));
+  if (err <= 0) return err ? LONGT : NIL;
+				/* client input takes precedence */
+  return (FD_ISSET (0,&rfd) || FD_ISSET (0,&efd)) ? LONGT : -1;
+}
+
+
+/* Watch file or directory for changes
+ * Accepts: pointer to watch descriptor, -1 if not watching yet
+ *	    file or directory name
+ *	    non-NIL to also watch for changed contents
+ * Returns: watch descriptor, or -1 if changes can't be watched
+ *
+ * Notifications already pending on an existing descriptor are discarded.
+ * Attribute changes and opens are never watched, so that a session's own
+ * reads of the mailbox do not wake it up.
+ */
+
+int watch_file (int *wd,char *name,long modify)
+{
+#ifdef IN_MODIFY
+  char tmp[MAILTMPLEN];
+				/* drain notifications */
+  if (*wd >= 0) while (read (*wd,tmp,MAILTMPLEN) > 0);
+  else if ((*wd = inotify_init ()) >= 0) {
+    fcntl (*wd,F_SETFL,O_NONBLOCK);
+    fcntl (*wd,F_SETFD,FD_CLOEXEC);
+    if (inotify_add_watch (*wd,name,(modify ? IN_MODIFY : 0)|IN_CREATE|
+			   IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|
+			   IN_DELETE_SELF|IN_MOVE_SELF) < 0) {
+      close (*wd);		/* can't watch it, try again next time */
+      *wd = -1;
+    }
+  }
+  return *wd;
+#else
+  return -1;			/* no change notification on this system */
+#endif
+}
+
 
 /* Return UNIX password entry for user name
  * Accepts: user name string
@@ -1747,6 +1976,25 @@ void dorc (char *file,long flag)
 	  mail_parameters (NIL,SET_SASLUSESPTRNAME,(void *) atol (k));
 	else if (!compare_cstring (s,"set network-filesystem-stat-bug"))
 	  netfsstatbug = atoi (k);
+	else if (!compare_cstring (s,"set unix-index-directory"))
+	  mail_parameters (NIL,SET_UNIXINDEXDIR,(void *) k);
+	else if (!compare_cstring (s,"set unix-mmap-read"))
+	  mail_parameters (NIL,SET_UNIXMMAP,(void *) atol (k));
+	else if (!compare_cstring (s,"set mix-text-index"))
+	  mail_parameters (NIL,SET_MIXTEXTINDEX,(void *) atol (k));
+	else if (!compare_cstring (s,"set mix-burp-budget"))
+	  mail_parameters (NIL,SET_MIXBURPBUDGET,(void *) atol (k));
+	else if (!compare_cstring (s,"set mbx-flag-sync"))
+	  mail_parameters (NIL,SET_MBXFLAGSYNC,(void *) atol (k));
+	else if (!compare_cstring (s,"set sort-cache-directory"))
+	  mail_parameters (NIL,SET_SORTCACHEDIR,(void *) k);
+	else if (!compare_cstring (s,"set list-cache-directory"))
+	  mail_parameters (NIL,SET_LISTCACHEDIR,(void *) k);
+	else if (!compare_cstring (s,"set status-cache-directory"))
+	  mail_parameters (NIL,SET_STATUSCACHEDIR,(void *) k);
+	else if (!compare_cstring (s,"set message-cache-slabs"))
+	  mail_parameters (NIL,SET_CACHE,atol (k) ? (void *) mm_cache_slab :
+			   (void *) mm_cache);
 	else if (!compare_cstring (s,"set nntp-range"))
 	  mail_parameters (NIL,SET_NNTPRANGE,(void *) atol (k));
 
@@ -1765,6 +2013,9 @@ void dorc (char *file,long flag)
 				 */
 	  else if (!compare_cstring (s,"set CA-certificate-path"))
 	    sslCApath = cpystr (k);
+				/* session keys must not be user-settable */
+	  else if (!compare_cstring (s,"set tls-session-cache-directory"))
+	    mail_parameters (NIL,SET_SSLSESSIONCACHEDIR,(void *) k);
 	  else if (!compare_cstring (s,"set disable-plaintext"))
 	    disablePlaintext = atoi (k);
 	  else if (!compare_cstring (s,"set allowed-login-attempts"))
@@ -1832,6 +2083,338 @@ long path_create (MAILSTREAM *stream,char *path)
   return ret;
 }
 
+/* Sort cache read string
+ * Accepts: pointer to current position in sort cache data
+ *	    end of sort cache data
+ *	    expected tag character
+ *	    string length (including tag) or 0 if no string
+ *	    pointer to string return, skip string if already set
+ * Returns: T on success, NIL if cache damaged
+ */
+
+static long sortcache_string (char **s,char *end,int tag,unsigned long len,
+			      char **ret)
+{
+  char *t = *s;
+  if (!len) return LONGT;	/* no string */
+				/* validate string */
+  if ((len > (end - t)) || ((end - t) - len < 2) || (*t != tag) ||
+      (t[len] != '\015') || (t[len+1] != '\012')) return NIL;
+  if (!*ret) {			/* want this string? */
+    memcpy (*ret = (char *) fs_get (len),t + 1,len - 1);
+    (*ret)[len - 1] = '\0';	/* tie off string */
+  }
+  *s = t + len + 2;		/* skip past string */
+  return LONGT;
+}
+
+/* Sort cache file open
+ * Accepts: MAIL stream
+ *	    mailbox file or directory status
+ *	    mailbox UID validity
+ *	    pointer to sequence of last load or update by this stream
+ * Returns: open FILE, or NIL if not caching or could only read sort cache
+ *
+ * A driver whose UIDs are not sticky must supply a validity which changes
+ * whenever a UID may have been reused.
+ *
+ * A sort cache file holds the sort and thread keys of the messages in a
+ * local mailbox so that a later session need not parse the headers again.
+ * It is named by the mailbox device and inode and is only used while the
+ * mailbox UID validity is unchanged.  Records of messages which are no
+ * longer in the mailbox are ignored and are dropped by the next update.  The file is not read again
+ * if its sequence shows that this stream has already loaded all of it.
+ */
+
+FILE *sortcache_open (MAILSTREAM *stream,void *sbuf,unsigned long validity,
+		      unsigned long *seq)
+{
+  int fd,refwd;
+  unsigned long i,j,uid,date,arrival,size,fromlen,tolen,cclen,subjlen;
+  unsigned long msgidlen,reflen;
+  char c,*s,*t,*end,*refs,*data,tmp[MAILTMPLEN];
+  char *skip = "";		/* non-NIL to skip references string */
+  SORTCACHE *sc;
+  STRINGLIST *sl;
+  struct stat fbuf;
+  struct stat *mbuf = (struct stat *) sbuf;
+  int rdonly = NIL;
+  FILE *f = NIL;
+  mailcache_t mc = (mailcache_t) mail_parameters (NIL,GET_CACHE,NIL);
+				/* do nothing if no cache or mailbox empty */
+  if (!sortcacheDir || !stream->nmsgs ||
+      ((strlen (sortcacheDir) + strlen (myhomedir ())) > (MAILTMPLEN - 40)))
+    return NIL;
+				/* relative names are in home directory */
+  if (*sortcacheDir == '/') strcpy (tmp,sortcacheDir);
+  else sprintf (tmp,"%s/%s",myhomedir (),sortcacheDir);
+				/* create cache directory if necessary */
+  if (stat (tmp,&fbuf) && mkdir (tmp,S_IRWXU)) return NIL;
+				/* cache named by mailbox device and inode */
+  sprintf (tmp + strlen (tmp),"/%lx.%lx.sort",(unsigned long) mbuf->st_dev,
+	   (unsigned long) mbuf->st_ino);
+  if (((fd = open (tmp,O_RDWR|O_CREAT,S_IRUSR|S_IWUSR)) < 0) &&
+      !(rdonly = ((fd = open (tmp,O_RDONLY,NIL)) >= 0))) return NIL;
+				/* must be our own file */
+  if (flock (fd,rdonly ? LOCK_SH : LOCK_EX) || fstat (fd,&fbuf) ||
+      (fbuf.st_uid != geteuid ()) ||
+      !(f = fdopen (fd,rdonly ? "rb" : "r+b"))) {
+    close (fd);			/* punt, this also releases the lock */
+    return NIL;
+  }
+				/* read sort cache data */
+  end = (data = (char *) fs_get (fbuf.st_size + 1)) + fbuf.st_size;
+  *end = '\0';			/* tie off data */
+  if (!((read (fd,data,fbuf.st_size) == fbuf.st_size) && (*data == 'V') &&
+				/* only load if UID validity unchanged */
+	isxdigit (data[1]) && (strtoul (data+1,&s,16) == validity) &&
+	(*s++ == ':') && isxdigit (*s) && (i = strtoul (s,&s,16)) &&
+	(*s++ == '\015') && (*s++ == '\012')))
+    for (i = 1; i <= stream->nmsgs; ++i)
+				/* empty or stale, rewrite on update */
+      ((SORTCACHE *) (*mc) (stream,i,CH_SORTCACHE))->dirty = T;
+  else if (i != *seq)		/* not already loaded */
+    for (*seq = i,j = 0; (s < end) && (t = strchr (s,'\012')); s = t + 1) {
+      *t = '\0';		/* tie off record line */
+      if ((sscanf (s,":%lx:%lx:%lx:%lx:%lx:%lx:%lx:%c%lx:%lx:%lx:",&uid,
+		   &date,&arrival,&size,&fromlen,&tolen,&cclen,&c,&subjlen,
+		   &msgidlen,&reflen) != 11)) break;
+      refwd = (c == 'R') ? T : NIL;
+				/* skip messages no longer in mailbox */
+				/* records are normally in UID order */
+      if (!(i = ((++j <= stream->nmsgs) &&
+		 (mail_elt (stream,j)->private.uid == uid)) ?
+	    j : (j = mail_msgno (stream,uid)))) {
+	t += 1 + (fromlen ? fromlen + 2 : 0) + (tolen ? tolen + 2 : 0) +
+	  (cclen ? cclen + 2 : 0) + (subjlen ? subjlen + 2 : 0) +
+	  (msgidlen ? msgidlen + 2 : 0) + (reflen ? reflen + 2 : 0);
+	if (t > end) break;	/* truncated record */
+	t--;			/* point at end of record */
+	continue;
+      }
+      sc = (SORTCACHE *) (*mc) (stream,i,CH_SORTCACHE);
+      if (!sc->date) sc->date = date;
+      if (!sc->arrival) sc->arrival = arrival;
+      if (!sc->size) sc->size = size;
+      if (refwd) sc->refwd = T;
+      refs = NIL;		/* don't want references if already have */
+      s = t + 1;		/* strings follow record line */
+      if (!(sortcache_string (&s,end,'F',fromlen,&sc->from) &&
+	    sortcache_string (&s,end,'T',tolen,&sc->to) &&
+	    sortcache_string (&s,end,'C',cclen,&sc->cc) &&
+	    sortcache_string (&s,end,'S',subjlen,&sc->subject) &&
+	    sortcache_string (&s,end,'M',msgidlen,&sc->message_id) &&
+	    sortcache_string (&s,end,'R',reflen,
+			      sc->references ? &skip : &refs))) break;
+      t = s - 1;		/* point at end of record */
+      if (refs) {		/* parse references */
+	for (s = refs,sl = NIL,sc->references = mail_newstringlist (); *s;
+	     s += i + 1) {
+	  if (!((i = strtoul (s,&s,16)) && (*s++ == ':') &&
+		(strlen (s) > i) && (s[i] == ':'))) {
+	    s = NIL;		/* length consistency check failed */
+	    break;
+	  }
+	  if (sl) sl = sl->next = mail_newstringlist ();
+	  else sl = sc->references;
+	  s[i] = '\0';
+	  sl->text.data = (unsigned char *) cpystr (s);
+	  sl->text.size = i;
+	}
+	fs_give ((void **) &refs);
+	if (!s) break;		/* references damaged */
+      }
+    }
+  fs_give ((void **) &data);
+  if (rdonly) {			/* can't update if readonly */
+    fclose (f);
+    f = NIL;
+  }
+  return f;
+}
+
+/* Sort cache update and close
+ * Accepts: MAIL stream
+ *	    pointer to open FILE (if FILE is NIL, do nothing)
+ *	    mailbox UID validity
+ *	    pointer to sequence of last load or update by this stream
+ * Returns: T on success, NIL on error
+ */
+
+long sortcache_update (MAILSTREAM *stream,FILE **sortcache,
+		       unsigned long validity,unsigned long *seq)
+{
+  unsigned long i,j;
+  MESSAGECACHE *elt;
+  SORTCACHE *s;
+  STRINGLIST *sl;
+  FILE *f = *sortcache;
+  long ret = LONGT;
+  mailcache_t mc = (mailcache_t) mail_parameters (NIL,GET_CACHE,NIL);
+  if (!f) return LONGT;		/* ignore if no file */
+  *sortcache = NIL;
+  for (i = 1; (i <= stream->nmsgs) &&
+	 !((SORTCACHE *) (*mc) (stream,i,CH_SORTCACHE))->dirty; ++i);
+  if (i <= stream->nmsgs) {	/* only update if some entry is dirty */
+    rewind (f);			/* rewrite from the start */
+    fprintf (f,"V%08lx:%08lx\015\012",validity,++*seq);
+    for (i = 1; i <= stream->nmsgs; ++i) {
+      elt = mail_elt (stream,i);
+      s = (SORTCACHE *) (*mc) (stream,i,CH_SORTCACHE);
+      s->dirty = NIL;		/* no longer dirty */
+      if (sl = s->references)	/* count length of references */
+	for (j = 1; sl && sl->text.data; sl = sl->next)
+	  j += 10 + sl->text.size;
+      else j = 0;		/* no references yet */
+      fprintf (f,SORTCACHEFMT,elt->private.uid,s->date,s->arrival,s->size,
+	       s->from ? strlen (s->from) + 1 : 0,
+	       s->to ? strlen (s->to) + 1 : 0,s->cc ? strlen (s->cc) + 1 : 0,
+	       s->refwd ? 'R' : ' ',s->subject ? strlen (s->subject) + 1 : 0,
+	       s->message_id ? strlen (s->message_id) + 1 : 0,j);
+      if (s->from) fprintf (f,"F%s\015\012",s->from);
+      if (s->to) fprintf (f,"T%s\015\012",s->to);
+      if (s->cc) fprintf (f,"C%s\015\012",s->cc);
+      if (s->subject) fprintf (f,"S%s\015\012",s->subject);
+      if (s->message_id) fprintf (f,"M%s\015\012",s->message_id);
+      if (j) {			/* any references to write? */
+	fputc ('R',f);		/* yes, do so */
+	for (sl = s->references; sl && sl->text.data; sl = sl->next)
+	  fprintf (f,"%08lx:%s:",sl->text.size,sl->text.data);
+	fputs ("\015\012",f);
+      }
+    }
+    if (ferror (f) || fflush (f)) {
+      MM_LOG ("Error updating sort cache file",WARN);
+      ret = NIL;
+    }
+				/* discard old data, if any */
+    else ftruncate (fileno (f),ftell (f));
+  }
+  if (fclose (f)) ret = NIL;	/* close and release lock */
+  return ret;
+}
+
+/* Status cache stamp mailbox files
+ * Accepts: destination stamp
+ *	    mailbox file or directory name
+ *	    NIL-terminated list of names of files in the directory, or NIL
+ *	    pointer to return mailbox file or directory status
+ * Returns: T if stamp usable, NIL if mailbox missing or changed too recently
+ */
+
+static long statuscache_stamp (char *dst,char *file,char **files,void *sbuf)
+{
+  char tmp[MAILTMPLEN];
+  struct stat fbuf;
+  struct stat *mbuf = (struct stat *) sbuf;
+  time_t now = time (0);
+  if (stat (file,mbuf)) return NIL;
+  for (fbuf = *mbuf,*dst = '\0';; dst += strlen (dst)) {
+				/* a change this second may yet be followed */
+    if ((fbuf.st_mtime >= now) || (fbuf.st_ctime >= now)) return NIL;
+    sprintf (dst,":%lx.%lx.%lx.%lx",(unsigned long) fbuf.st_ino,
+	     (unsigned long) fbuf.st_size,(unsigned long) fbuf.st_mtime,
+	     (unsigned long) fbuf.st_ctime);
+    if (!(files && *files)) return LONGT;
+    if ((strlen (file) + strlen (*files)) > (MAILTMPLEN - 2)) return NIL;
+    strcat (strcat (strcpy (tmp,file),"/"),*files++);
+				/* missing file stamps as zero */
+    if (stat (tmp,&fbuf)) memset (&fbuf,0,sizeof (struct stat));
+  }
+}
+
+/* Status using status cache
+ * Accepts: mail stream
+ *	    mailbox name
+ *	    status flags
+ *	    mailbox file or directory name
+ *	    NIL-terminated list of names of files in the directory, or NIL
+ * Returns: T on success, NIL on failure
+ *
+ * A status cache file holds the counters of a local mailbox which is not
+ * open, so that a later STATUS need not open and parse it again.  It is
+ * named by the mailbox device and inode, and is only used while the inode,
+ * size, and modification and change times of the mailbox file (and of the
+ * listed files in the mailbox directory) are all unchanged.  Any append,
+ * flag change, or expunge by any session alters one of these, so the next
+ * STATUS opens the mailbox and records the new counters.  Nothing is cached
+ * about a mailbox changed during the second in which it was looked at.
+ */
+
+long statuscache_status (MAILSTREAM *stream,char *mbx,long flags,char *file,
+			 char **files)
+{
+  int fd;
+  unsigned long i;
+  char *s,*data,stamp[MAILTMPLEN],cache[MAILTMPLEN],tmp[MAILTMPLEN];
+  struct stat sbuf,fbuf;
+  MAILSTATUS status;
+  FILE *f;
+  MAILSTREAM *tstream;
+  long ret = NIL;
+				/* only for mailboxes not already open */
+  if (stream || !statuscacheDir ||
+      ((strlen (statuscacheDir) + strlen (myhomedir ())) > (MAILTMPLEN - 40)) ||
+      !statuscache_stamp (stamp,file,files,&sbuf))
+    return mail_status_default (stream,mbx,flags);
+				/* relative names are in home directory */
+  if (*statuscacheDir == '/') strcpy (cache,statuscacheDir);
+  else sprintf (cache,"%s/%s",myhomedir (),statuscacheDir);
+				/* create cache directory if necessary */
+  if (stat (cache,&fbuf) && mkdir (cache,S_IRWXU))
+    return mail_status_default (stream,mbx,flags);
+				/* cache named by mailbox device and inode */
+  sprintf (cache + strlen (cache),"/%lx.%lx.status",
+	   (unsigned long) sbuf.st_dev,(unsigned long) sbuf.st_ino);
+				/* must be our own file */
+  if ((fd = open (cache,O_RDONLY,NIL)) >= 0) {
+    if (!fstat (fd,&fbuf) && (fbuf.st_uid == geteuid ()) &&
+	(fbuf.st_size < (MAILTMPLEN * 2))) {
+      data = (char *) fs_get (fbuf.st_size + 1);
+      data[fbuf.st_size] = '\0';/* tie off data */
+				/* only use if mailbox unchanged */
+      if ((read (fd,data,fbuf.st_size) == fbuf.st_size) && (*data == 'S') &&
+	  (s = strstr (data,"\015\012")) && !(*s = '\0') &&
+	  !strcmp (data + 1,stamp) &&
+	  (sscanf (s + 2,"%lx:%lx:%lx:%lx:%lx:%lx",&status.messages,
+		   &status.recent,&status.unseen,&status.uidnext,
+		   &status.uidvalidity,&status.highestmodseq) == 6)) {
+	status.flags = flags;
+	MM_STATUS (stream,mbx,&status);
+	ret = LONGT;
+      }
+      fs_give ((void **) &data);
+    }
+    close (fd);
+    if (ret) return ret;
+  }
+				/* have to open the mailbox after all */
+  if (!(tstream = mail_open (NIL,mbx,OP_READONLY|OP_SILENT))) return NIL;
+  status.flags = flags;
+  status.messages = tstream->nmsgs;
+  status.recent = tstream->recent;
+  for (i = 1,status.unseen = 0; i <= tstream->nmsgs; i++)
+    if (!mail_elt (tstream,i)->seen) status.unseen++;
+  status.uidnext = tstream->uid_last + 1;
+  status.uidvalidity = tstream->uid_validity;
+  status.highestmodseq = (unsigned long)
+    mail_parameters (tstream,GET_HIGHESTMODSEQ,(void *) tstream);
+  mail_close (tstream);
+				/* write new cache via temporary file */
+  if (*stamp && ((strlen (cache) + 12) < MAILTMPLEN)) {
+    sprintf (tmp,"%s.%lx",cache,(unsigned long) getpid ());
+    if (f = fopen (tmp,"wb")) {
+      fprintf (f,"S%s\015\012%lx:%lx:%lx:%lx:%lx:%lx\015\012",stamp,
+	       status.messages,status.recent,status.unseen,status.uidnext,
+	       status.uidvalidity,status.highestmodseq);
+      fd = ferror (f);		/* always close file */
+      if (fclose (f) || fd || rename (tmp,cache)) unlink (tmp);
+    }
+  }
+  MM_STATUS (stream,mbx,&status);
+  return LONGT;
+}
+
 /* Default block notify routine
  * Accepts: reason for calling
  *	    data
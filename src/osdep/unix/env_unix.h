@@ -47,6 +47,12 @@ typedef struct dotlock_base {
 #define SYSCONFIG "/etc/c-client.cf"
 
 
+/* Sort cache record, sort/thread keys follow */
+
+#define SORTCACHEFMT \
+  ":%08lx:%08lx:%08lx:%08lx:%08lx:%08lx:%08lx:%c%08lx:%08lx:%08lx:\015\012"
+
+
 /* Special users */
 
 #define ANONYMOUSUSER "nobody"	/* anonymous user */
@@ -55,6 +61,7 @@ typedef struct dotlock_base {
 
 /* Function prototypes */
 
+#include <stdio.h>		/* for FILE in sort cache routines */
 #include "env.h"
 
 void rfc822_fixed_date (char *date);
@@ -79,10 +86,18 @@ long get_dir_protection (char *mailbox);
 MAILSTREAM *user_flags (MAILSTREAM *stream);
 char *default_user_flag (unsigned long i);
 void dorc (char *file,long flag);
+void server_listen (char *server,char *service,char *sslservice);
 long path_create (MAILSTREAM *stream,char *mailbox);
+FILE *sortcache_open (MAILSTREAM *stream,void *sbuf,unsigned long validity,
+		      unsigned long *seq);
+long sortcache_update (MAILSTREAM *stream,FILE **sortcache,
+		       unsigned long validity,unsigned long *seq);
+long statuscache_status (MAILSTREAM *stream,char *mbx,long flags,char *file,
+			 char **files);
 void grim_pid_reap_status (int pid,int killreq,void *status);
 #define grim_pid_reap(pid,killreq) \
   grim_pid_reap_status (pid,killreq,NIL)
+int watch_file (int *wd,char *name,long modify);
 long safe_write (int fd,char *buf,long nbytes);
 void *arm_signal (int sig,void *action);
 struct passwd *checkpw (struct passwd *pw,char *pass,int argc,char *argv[]);
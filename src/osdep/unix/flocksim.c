@@ -442,8 +442,11 @@ static long master (MAILSTREAM *stream,append_t af,void *data)
 		  if (s && (*s++ == ' ')) {
 		    status.uidvalidity = strtoul (s,&s,10);
 		    if (s && (*s++ == ' ')) {
-		      mm_status ((st == stream) ? stream : NIL,s,&status);
-		      break;
+		      status.highestmodseq = strtoul (s,&s,10);
+		      if (s && (*s++ == ' ')) {
+			mm_status ((st == stream) ? stream : NIL,s,&status);
+			break;
+		      }
 		    }
 		  }
 		}
@@ -676,9 +679,10 @@ void slave_flags (MAILSTREAM *stream,unsigned long number)
 void slave_status (MAILSTREAM *stream,char *mailbox,MAILSTATUS *status)
 {
   int i,c;
-  fprintf (slaveout,"S%lx %lu %lu %lu %lu %lu %lu ",
+  fprintf (slaveout,"S%lx %lu %lu %lu %lu %lu %lu %lu ",
 	  (unsigned long) stream,status->flags,status->messages,status->recent,
-	  status->unseen,status->uidnext,status->uidvalidity,mailbox);
+	  status->unseen,status->uidnext,status->uidvalidity,
+	  status->highestmodseq);
 				/* yow!  are we paranoid enough yet? */
   for (i = 0; (i < 500) && (c = *mailbox++); ++i) switch (c) {
   case '\r': case '\n':		/* newline in a mailbox name? */
@@ -82,8 +82,8 @@ void *ip_stringtoaddr (char *text,size_t *len,int *family)
 {
   unsigned long adr;
   struct in_addr *ret;
-				/* get address */
-  if ((adr = inet_addr (text)) == -1) ret = NIL;
+				/* get address, all ones if invalid */
+  if (((adr = inet_addr (text)) & 0xffffffff) == 0xffffffff) ret = NIL;
   else {			/* make in_addr */
     ret = (struct in_addr *) fs_get (*len = ADR4LEN);
     *family = AF_INET;		/* IPv4 */
@@ -43,6 +43,7 @@ extern int errno;		/* just in case */
 #include <pwd.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include "misc.h"
 #include "dummy.h"
 #include "fdstring.h"
@@ -51,6 +52,7 @@ extern int errno;		/* just in case */
 /* Build parameters */
 
 #define HDRSIZE 2048
+#define MBXFLUSHLEN 65536	/* maximum span of coalesced status writes */
 
 
 /* Kludge to make Cygwin happy */
@@ -65,8 +67,11 @@ typedef struct mbx_local {
   unsigned int flagcheck: 1;	/* if ping should sweep for flags */
   unsigned int expok: 1;	/* if expunging OK in ping */
   unsigned int expunged : 1;	/* if one or more expunged messages */
+  unsigned int dirty : 1;	/* if status updates awaiting write */
+  unsigned int unsynced : 1;	/* if status updates awaiting sync */
   int fd;			/* file descriptor for I/O */
   int ld;			/* lock file descriptor */
+  int wd;			/* change watch descriptor */
   int ffuserflag;		/* first free user flag */
   off_t filesize;		/* file size parsed */
   time_t filetime;		/* last file time */
@@ -75,6 +80,8 @@ typedef struct mbx_local {
   unsigned char *buf;		/* temporary buffer */
   unsigned long buflen;		/* current size of temporary buffer */
   char lock[MAILTMPLEN];	/* buffer to write lock name */
+  unsigned long sortcacheseq;	/* sort cache sequence */
+  struct timeval synctime;	/* time of last sync */
 } MBXLOCAL;
 
 
@@ -104,8 +111,13 @@ char *mbx_header (MAILSTREAM *stream,unsigned long msgno,unsigned long *length,
 long mbx_text (MAILSTREAM *stream,unsigned long msgno,STRING *bs,long flags);
 void mbx_flag (MAILSTREAM *stream,char *sequence,char *flag,long flags);
 void mbx_flagmsg (MAILSTREAM *stream,MESSAGECACHE *elt);
+unsigned long *mbx_sort (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
+			SORTPGM *pgm,long flags);
+THREADNODE *mbx_thread (MAILSTREAM *stream,char *type,char *charset,
+		       SEARCHPGM *spg,long flags);
 long mbx_ping (MAILSTREAM *stream);
 void mbx_check (MAILSTREAM *stream);
+int mbx_watch (MAILSTREAM *stream);
 long mbx_expunge (MAILSTREAM *stream,char *sequence,long options);
 void mbx_snarf (MAILSTREAM *stream);
 long mbx_copy (MAILSTREAM *stream,char *sequence,char *mailbox,long options);
@@ -114,9 +126,17 @@ long mbx_append (MAILSTREAM *stream,char *mailbox,append_t af,void *data);
 char *mbx_file (char *dst,char *name);
 long mbx_parse (MAILSTREAM *stream);
 MESSAGECACHE *mbx_elt (MAILSTREAM *stream,unsigned long msgno,long expok);
+MESSAGECACHE *mbx_elt_work (MAILSTREAM *stream,unsigned long msgno,long expok,
+			    unsigned char *map);
+unsigned long mbx_sweep (MAILSTREAM *stream,long expok);
 unsigned long mbx_read_flags (MAILSTREAM *stream,MESSAGECACHE *elt);
+unsigned long mbx_decode_flags (MAILSTREAM *stream,MESSAGECACHE *elt);
 void mbx_update_header (MAILSTREAM *stream);
 void mbx_update_status (MAILSTREAM *stream,unsigned long msgno,long flags);
+void mbx_status_string (MAILSTREAM *stream,MESSAGECACHE *elt,char *s,
+			long flags);
+void mbx_flush_status (MAILSTREAM *stream);
+void mbx_sync (MAILSTREAM *stream,long force);
 unsigned long mbx_hdrpos (MAILSTREAM *stream,unsigned long msgno,
 			  unsigned long *size,char **hdr);
 unsigned long mbx_rewrite (MAILSTREAM *stream,unsigned long *reclaimed,
@@ -158,18 +178,22 @@ DRIVER mbxdriver = {
   mbx_flag,			/* modify flags */
   mbx_flagmsg,			/* per-message modify flags */
   NIL,				/* search for message based on criteria */
-  NIL,				/* sort messages */
-  NIL,				/* thread messages */
+  mbx_sort,			/* sort messages */
+  mbx_thread,			/* thread messages */
   mbx_ping,			/* ping mailbox to see if still alive */
   mbx_check,			/* check for new messages */
   mbx_expunge,			/* expunge deleted messages */
   mbx_copy,			/* copy messages to another mailbox */
   mbx_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  mbx_watch			/* watch mailbox for changes */
 };
 
 				/* prototype stream */
 MAILSTREAM mbxproto = {&mbxdriver};
+
+				/* driver parameters */
+static long mbx_flagsync = 0;	/* ms between flag syncs, 0 always, -1 never */
 
 /* MBX mail validate mailbox
  * Accepts: mailbox name
@@ -327,6 +351,11 @@ void *mbx_parameters (long function,void *value)
   case GET_INBOXPATH:
     if (value) ret = mbx_file ((char *) value,"INBOX");
     break;
+  case SET_MBXFLAGSYNC:
+    mbx_flagsync = (long) value;
+  case GET_MBXFLAGSYNC:
+    ret = (void *) mbx_flagsync;
+    break;
   case SET_ONETIMEEXPUNGEATPING:
     if (value) ((MBXLOCAL *) ((MAILSTREAM *) value)->local)->expok = T;
   case GET_ONETIMEEXPUNGEATPING:
@@ -520,6 +549,11 @@ long mbx_status (MAILSTREAM *stream,char *mbx,long flags)
   unsigned long i;
   MAILSTREAM *tstream = NIL;
   MAILSTREAM *systream = NIL;
+  char tmp[MAILTMPLEN];
+				/* cached unless INBOX, which may snarf */
+  if (!stream && mail_parameters (NIL,GET_STATUSCACHEDIR,NIL) &&
+      compare_cstring (mbx,"INBOX") && mbx_file (tmp,mbx))
+    return statuscache_status (stream,mbx,flags,tmp,NIL);
 				/* make temporary stream (unless this mbx) */
   if (!stream && !(stream = tstream =
 		   mail_open (NIL,mbx,OP_READONLY|OP_SILENT)))
@@ -532,6 +566,7 @@ long mbx_status (MAILSTREAM *stream,char *mbx,long flags)
       if (!mail_elt (stream,i)->seen) status.unseen++;
   status.uidnext = stream->uid_last + 1;
   status.uidvalidity = stream->uid_validity;
+  status.highestmodseq = 0;	/* no modsequences */
 				/* calculate post-snarf results */
   if (!status.recent && stream->inbox &&
       (systream = mail_open (NIL,sysinbox (),OP_READONLY|OP_SILENT))) {
@@ -584,6 +619,7 @@ MAILSTREAM *mbx_open (MAILSTREAM *stream)
   stream->local = memset (fs_get (sizeof (MBXLOCAL)),NIL,sizeof (MBXLOCAL));
   LOCAL->fd = fd;		/* bind the file */
   LOCAL->ld = -1;		/* no flaglock */
+  LOCAL->wd = -1;		/* not watching for changes yet */
   LOCAL->buf = (char *) fs_get (CHUNKSIZE);
   LOCAL->buflen = CHUNKSIZE - 1;
 				/* note if an INBOX or not */
@@ -638,6 +674,7 @@ void mbx_close (MAILSTREAM *stream,long options)
       LOCAL->expok = T;		/*  possible expunged messages */
       mbx_ping (stream);
     }
+    if (LOCAL) mbx_sync (stream,LONGT);
     stream->silent = silent;	/* restore previous status */
     mbx_abort (stream);
   }
@@ -653,6 +690,7 @@ void mbx_abort (MAILSTREAM *stream)
   if (stream && LOCAL) {	/* only if a file is open */
     flock (LOCAL->fd,LOCK_UN);	/* unlock local file */
     close (LOCAL->fd);		/* close the local file */
+    if (LOCAL->wd >= 0) close (LOCAL->wd);
 				/* free local text buffer */
     if (LOCAL->buf) fs_give ((void **) &LOCAL->buf);
 				/* nuke the local data */
@@ -764,7 +802,11 @@ void mbx_flag (MAILSTREAM *stream,char *sequence,char *flag,long flags)
   unsigned long oldpid = LOCAL->lastpid;
 				/* make sure the update takes */
   if (!stream->rdonly && LOCAL && (LOCAL->fd >= 0) && (LOCAL->ld >= 0)) {
-    fsync (LOCAL->fd);
+    if (LOCAL->dirty) {		/* write status updates */
+      mbx_flush_status (stream);
+      LOCAL->unsynced = T;	/* sync as durability policy says */
+    }
+    mbx_sync (stream,NIL);
     fstat (LOCAL->fd,&sbuf);	/* get current write time */
     tp[1] = LOCAL->filetime = sbuf.st_mtime;
 				/* we are the last flag updater */
@@ -790,7 +832,59 @@ void mbx_flag (MAILSTREAM *stream,char *sequence,char *flag,long flags)
 
 void mbx_flagmsg (MAILSTREAM *stream,MESSAGECACHE *elt)
 {
-  if (mbx_flaglock (stream)) mbx_update_status (stream,elt->msgno,NIL);
+  if (mbx_flaglock (stream)) {
+				/* get current status before alteration */
+    if (!elt->valid) mbx_read_flags (stream,elt);
+				/* note status to write in mbx_flag() */
+    else LOCAL->dirty = elt->private.dirty = T;
+  }
+}
+
+/* MBX mail sort messages
+ * Accepts: mail stream
+ *	    character set
+ *	    search program
+ *	    sort program
+ *	    option flags
+ * Returns: vector of sorted message sequences or NIL if error
+ */
+
+unsigned long *mbx_sort (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
+			SORTPGM *pgm,long flags)
+{
+  unsigned long *ret;
+  struct stat sbuf;
+  FILE *sortcache = !fstat (LOCAL->fd,&sbuf) ?
+    sortcache_open (stream,&sbuf,stream->uid_validity,
+		    &LOCAL->sortcacheseq) : NIL;
+  ret = mail_sort_msgs (stream,charset,spg,pgm,flags);
+  sortcache_update (stream,&sortcache,stream->uid_validity,
+		    &LOCAL->sortcacheseq);
+  return ret;
+}
+
+
+/* MBX mail thread messages
+ * Accepts: mail stream
+ *	    thread type
+ *	    character set
+ *	    search program
+ *	    option flags
+ * Returns: thread node tree or NIL if error
+ */
+
+THREADNODE *mbx_thread (MAILSTREAM *stream,char *type,char *charset,
+		       SEARCHPGM *spg,long flags)
+{
+  THREADNODE *ret;
+  struct stat sbuf;
+  FILE *sortcache = !fstat (LOCAL->fd,&sbuf) ?
+    sortcache_open (stream,&sbuf,stream->uid_validity,
+		    &LOCAL->sortcacheseq) : NIL;
+  ret = mail_thread_msgs (stream,type,charset,spg,flags,mail_sort_msgs);
+  sortcache_update (stream,&sortcache,stream->uid_validity,
+		    &LOCAL->sortcacheseq);
+  return ret;
 }
 
 /* MBX mail ping mailbox
@@ -812,6 +906,7 @@ long mbx_ping (MAILSTREAM *stream)
     fstat (LOCAL->fd,&sbuf);	/* get current file poop */
 				/* allow expunge if permitted at ping */
     if (mail_parameters (NIL,GET_EXPUNGEATPING,NIL)) LOCAL->expok = T;
+    mbx_sync (stream,NIL);	/* sync flags if group commit is due */
 				/* if external modification */
     if (LOCAL->filetime && (LOCAL->filetime < sbuf.st_mtime))
       LOCAL->flagcheck = T;	/* upgrade to flag checking */
@@ -823,14 +918,8 @@ long mbx_ping (MAILSTREAM *stream)
       if (!LOCAL->flagcheck) ret = mbx_parse (stream);
 				/* sweep mailbox for changed message status */
       else if (ret = mbx_parse (stream)) {
-	unsigned long recent = 0;
 	LOCAL->filetime = sbuf.st_mtime;
-	for (i = 1; i <= stream->nmsgs; )
-	  if (elt = mbx_elt (stream,i,LOCAL->expok)) {
-	    if (elt->recent) ++recent;
-	    ++i;
-	  }
-	mail_recent (stream,recent);
+	mail_recent (stream,mbx_sweep (stream,LOCAL->expok));
 	LOCAL->flagcheck = NIL;	/* got all the updates */
       }
 				/* always reparse header at least */
@@ -869,11 +958,25 @@ long mbx_ping (MAILSTREAM *stream)
 
 void mbx_check (MAILSTREAM *stream)
 {
-  if (LOCAL) LOCAL->expok = T;	/* mark that a check is desired */
+  if (LOCAL) {			/* mark that a check is desired */
+    LOCAL->expok = T;
+    mbx_sync (stream,LONGT);	/* and commit flag updates */
+  }
   if (mbx_ping (stream)) MM_LOG ("Check completed",(long) NIL);
 }
 
 
+/* MBX mail watch mailbox
+ * Accepts: MAIL stream
+ * Returns: descriptor readable when mailbox file changes, or -1
+ */
+
+int mbx_watch (MAILSTREAM *stream)
+{
+  return LOCAL ? watch_file (&LOCAL->wd,stream->mailbox,LONGT) : -1;
+}
+
+
 /* MBX mail expunge mailbox
  * Accepts: MAIL stream
  *	    sequence to expunge if non-NIL
@@ -1460,6 +1563,21 @@ long mbx_parse (MAILSTREAM *stream)
  */
 
 MESSAGECACHE *mbx_elt (MAILSTREAM *stream,unsigned long msgno,long expok)
+{
+  return mbx_elt_work (stream,msgno,expok,NIL);
+}
+
+
+/* MBX get cache element with status updating from file or mapping
+ * Accepts: MAIL stream
+ *	    message number
+ *	    expunge OK flag
+ *	    mapping of mailbox file or NIL to read it
+ * Returns: cache element
+ */
+
+MESSAGECACHE *mbx_elt_work (MAILSTREAM *stream,unsigned long msgno,long expok,
+			    unsigned char *map)
 {
   MESSAGECACHE *elt = mail_elt (stream,msgno);
   struct {			/* old flags */
@@ -1473,8 +1591,11 @@ MESSAGECACHE *mbx_elt (MAILSTREAM *stream,unsigned long msgno,long expok)
   old.seen = elt->seen; old.deleted = elt->deleted; old.flagged = elt->flagged;
   old.answered = elt->answered; old.draft = elt->draft;
   old.user_flags = elt->user_flags;
+  if (map) memcpy (LOCAL->buf,map + elt->private.special.offset +
+		   elt->private.special.text.size - 24,14);
 				/* get new flags */
-  if (mbx_read_flags (stream,elt) && expok) {
+  if ((map ? mbx_decode_flags (stream,elt) : mbx_read_flags (stream,elt)) &&
+      expok) {
     mail_expunged (stream,elt->msgno);
     return NIL;			/* return this message was expunged */
   }
@@ -1484,6 +1605,43 @@ MESSAGECACHE *mbx_elt (MAILSTREAM *stream,unsigned long msgno,long expok)
     MM_FLAGS (stream,msgno);	/* let top level know */
   return elt;
 }
+
+/* MBX sweep mailbox for changed message status
+ * Accepts: MAIL stream
+ *	    expunge OK flag
+ * Returns: number of recent messages
+ *
+ * Called with parse/append permission after a parse.  The status fields are
+ * taken from a single mapping of the parsed part of the file rather than
+ * with a seek and read per message, falling back to that if the file can't
+ * be mapped.
+ */
+
+unsigned long mbx_sweep (MAILSTREAM *stream,long expok)
+{
+  unsigned long i,recent = 0;
+  size_t size = (size_t) LOCAL->filesize;
+  unsigned char *map = NIL;
+  MESSAGECACHE *elt;
+  struct stat sbuf;
+  fstat (LOCAL->fd,&sbuf);	/* make sure file size is good */
+  if (sbuf.st_size < LOCAL->filesize) {
+    sprintf (LOCAL->buf,"Mailbox shrank from %lu to %lu in flag sweep!",
+	     (unsigned long) LOCAL->filesize,(unsigned long) sbuf.st_size);
+    fatal (LOCAL->buf);
+  }
+  if (stream->nmsgs && ((map = (unsigned char *)
+			 mmap (NIL,size,PROT_READ,MAP_SHARED,LOCAL->fd,0)) ==
+			(unsigned char *) MAP_FAILED)) map = NIL;
+  for (i = 1; i <= stream->nmsgs; )
+    if (elt = mbx_elt_work (stream,i,expok,map)) {
+      if (elt->recent) ++recent;
+      ++i;
+    }
+  if (map) munmap ((void *) map,size);
+  return recent;
+}
+
 
 /* MBX read flags from file
  * Accepts: MAIL stream
@@ -1493,7 +1651,6 @@ MESSAGECACHE *mbx_elt (MAILSTREAM *stream,unsigned long msgno,long expok)
 
 unsigned long mbx_read_flags (MAILSTREAM *stream,MESSAGECACHE *elt)
 {
-  unsigned long i;
   struct stat sbuf;
   fstat (LOCAL->fd,&sbuf);	/* get status */
 				/* make sure file size is good */
@@ -1510,6 +1667,21 @@ unsigned long mbx_read_flags (MAILSTREAM *stream,MESSAGECACHE *elt)
     sprintf (LOCAL->buf,"Unable to read new status: %s",strerror (errno));
     fatal (LOCAL->buf);
   }
+  return mbx_decode_flags (stream,elt);
+}
+
+
+/* MBX decode flags read from file
+ * Accepts: MAIL stream
+ *	    cache element
+ * Returns: non-NIL if message expunged
+ *
+ * The 14 bytes of status starting at the semicolon are in LOCAL->buf.
+ */
+
+unsigned long mbx_decode_flags (MAILSTREAM *stream,MESSAGECACHE *elt)
+{
+  unsigned long i;
   if ((LOCAL->buf[0] != ';') || (LOCAL->buf[13] != '-')) {
     LOCAL->buf[14] = '\0';	/* tie off buffer for error message */
     sprintf (LOCAL->buf+50,"Invalid flags for message %lu (%lu %lu): %s",
@@ -1594,30 +1766,129 @@ void mbx_update_status (MAILSTREAM *stream,unsigned long msgno,long flags)
       sprintf (LOCAL->buf,"Unable to read old status: %s",strerror (errno));
       fatal (LOCAL->buf);
     }
-    if ((LOCAL->buf[0] != ';') || (LOCAL->buf[13] != '-')) {
-      LOCAL->buf[14] = '\0';	/* tie off buffer for error message */
-      sprintf (LOCAL->buf+50,"Invalid flags for message %lu (%lu %lu): %s",
-	       elt->msgno,elt->private.special.offset,
-	       elt->private.special.text.size,(char *) LOCAL->buf);
-      fatal (LOCAL->buf+50);
-    }
-				/* print new flag string */
-    sprintf (LOCAL->buf,"%08lx%04x-%08lx",elt->user_flags,(unsigned)
-	     (((elt->deleted && flags) ?
-	       fEXPUNGED : (strtoul (LOCAL->buf+9,NIL,16)) & fEXPUNGED) +
-	      (fSEEN * elt->seen) + (fDELETED * elt->deleted) +
-	      (fFLAGGED * elt->flagged) + (fANSWERED * elt->answered) +
-	      (fDRAFT * elt->draft) + fOLD),elt->private.uid);
+				/* make new status string */
+    mbx_status_string (stream,elt,(char *) LOCAL->buf,flags);
     while (T) {			/* get to that place in the file */
       lseek (LOCAL->fd,(off_t) elt->private.special.offset +
 	     elt->private.special.text.size - 23,L_SET);
 				/* write new flags and UID */
-      if (write (LOCAL->fd,LOCAL->buf,21) > 0) break;
+      if (write (LOCAL->fd,LOCAL->buf + 1,21) > 0) break;
       MM_NOTIFY (stream,strerror (errno),WARN);
       MM_DISKERROR (stream,errno,T);
     }
   }
 }
+
+
+/* MBX make status string
+ * Accepts: MAIL stream
+ *	    message cache element
+ *	    old status string, starting at its semicolon
+ *	    non-zero if deleted message should be marked expunged
+ *
+ * The 21 bytes of new flags and UID replace those following the semicolon.
+ */
+
+void mbx_status_string (MAILSTREAM *stream,MESSAGECACHE *elt,char *s,
+			long flags)
+{
+  char tmp[MAILTMPLEN];
+  if ((s[0] != ';') || (s[13] != '-')) {
+    sprintf (tmp,"Invalid flags for message %lu (%lu %lu): %.14s",
+	     elt->msgno,elt->private.special.offset,
+	     elt->private.special.text.size,s);
+    fatal (tmp);
+  }
+  sprintf (tmp,"%08lx%04x-%08lx",elt->user_flags,(unsigned)
+	   (((elt->deleted && flags) ?
+	     fEXPUNGED : (strtoul (s+9,NIL,16)) & fEXPUNGED) +
+	    (fSEEN * elt->seen) + (fDELETED * elt->deleted) +
+	    (fFLAGGED * elt->flagged) + (fANSWERED * elt->answered) +
+	    (fDRAFT * elt->draft) + fOLD),elt->private.uid);
+  memcpy (s + 1,tmp,21);	/* new flags and UID */
+}
+
+/* MBX write status of messages noted by mbx_flagmsg()
+ * Accepts: MAIL stream
+ *
+ * Called with the flag lock held.  The status of messages near each other
+ * in the file is patched into one buffer and written with a single write.
+ */
+
+#define MBXSTATUS(elt) \
+  (elt->private.special.offset + elt->private.special.text.size - 24)
+
+void mbx_flush_status (MAILSTREAM *stream)
+{
+  unsigned long i,j,k,pos,end;
+  ssize_t n;
+  char *s;
+  MESSAGECACHE *elt;
+  LOCAL->dirty = NIL;		/* no more writes pending after this */
+  for (i = 1; i <= stream->nmsgs; i = k + 1) {
+    if (!(elt = mail_elt (stream,k = i))->private.dirty) continue;
+    elt->private.dirty = NIL;
+    pos = MBXSTATUS (elt);	/* find last status that fits in one span */
+    for (j = i + 1; (j <= stream->nmsgs) &&
+	   ((MBXSTATUS (mail_elt (stream,j)) + 22 - pos) <= MBXFLUSHLEN); ++j)
+      if (mail_elt (stream,j)->private.dirty) k = j;
+    if (k == i) mbx_update_status (stream,i,NIL);
+    else {			/* read span, from first to last status */
+      end = MBXSTATUS (mail_elt (stream,k)) + 22;
+      if ((end - pos) > LOCAL->buflen) {
+	fs_give ((void **) &LOCAL->buf);
+	LOCAL->buf = (char *) fs_get ((LOCAL->buflen = end - pos) + 1);
+      }
+      lseek (LOCAL->fd,(off_t) pos,L_SET);
+      if (read (LOCAL->fd,LOCAL->buf,end - pos) != (ssize_t) (end - pos)) {
+	sprintf (LOCAL->buf,"Unable to read old status: %s",strerror (errno));
+	fatal (LOCAL->buf);
+      }
+				/* patch in each new status */
+      mbx_status_string (stream,elt,(char *) LOCAL->buf,NIL);
+      for (j = i + 1; j <= k; ++j)
+	if ((elt = mail_elt (stream,j))->private.dirty) {
+	  elt->private.dirty = NIL;
+	  mbx_status_string (stream,elt,
+			     (char *) LOCAL->buf + MBXSTATUS (elt) - pos,NIL);
+	}
+				/* write the span back */
+      for (s = (char *) LOCAL->buf,j = end - pos; j;) {
+	lseek (LOCAL->fd,(off_t) (end - j),L_SET);
+	if ((n = write (LOCAL->fd,s,j)) > 0) {
+	  s += n;		/* partial write, do the rest */
+	  j -= n;
+	}
+	else {
+	  MM_NOTIFY (stream,strerror (errno),WARN);
+	  MM_DISKERROR (stream,errno,T);
+	}
+      }
+    }
+  }
+}
+
+
+/* MBX sync status updates as the durability policy says
+ * Accepts: MAIL stream
+ *	    non-zero to sync regardless of policy
+ */
+
+void mbx_sync (MAILSTREAM *stream,long force)
+{
+  struct timeval now;
+  if (LOCAL->unsynced && (LOCAL->fd >= 0)) {
+    gettimeofday (&now,NIL);
+    if (force || !mbx_flagsync ||
+	((mbx_flagsync > 0) &&
+	 ((((now.tv_sec - LOCAL->synctime.tv_sec) * 1000) +
+	   ((now.tv_usec - LOCAL->synctime.tv_usec) / 1000)) >= mbx_flagsync))) {
+      fsync (LOCAL->fd);
+      LOCAL->unsynced = NIL;
+      LOCAL->synctime = now;
+    }
+  }
+}
 
 /* MBX locate header for a message
  * Accepts: MAIL stream
@@ -1724,7 +1995,7 @@ unsigned long mbx_rewrite (MAILSTREAM *stream,unsigned long *reclaimed,
   }
   if (LOCAL->flagcheck) {	/* sweep flags if need flagcheck */
     LOCAL->filetime = sbuf.st_mtime;
-    for (i = 1; i <= stream->nmsgs; ++i) mbx_elt (stream,i,NIL);
+    mbx_sweep (stream,NIL);
     LOCAL->flagcheck = NIL;
   }
 
@@ -58,9 +58,11 @@ extern int errno;		/* just in case */
 	
 typedef struct mh_local {
   char *dir;			/* spool directory name */
+  int wd;			/* change watch descriptor */
   unsigned char buf[CHUNKSIZE];	/* temporary buffer */
   unsigned long cachedtexts;	/* total size of all cached texts */
   time_t scantime;		/* last time directory scanned */
+  unsigned long sortcacheseq;	/* sort cache sequence */
 } MHLOCAL;
 
 
@@ -93,8 +95,14 @@ void mh_load_message (MAILSTREAM *stream,unsigned long msgno,long flags);
 char *mh_header (MAILSTREAM *stream,unsigned long msgno,unsigned long *length,
 		 long flags);
 long mh_text (MAILSTREAM *stream,unsigned long msgno,STRING *bs,long flags);
+unsigned long *mh_sort (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
+		       SORTPGM *pgm,long flags);
+THREADNODE *mh_thread (MAILSTREAM *stream,char *type,char *charset,
+		       SEARCHPGM *spg,long flags);
+unsigned long mh_sortvalidity (MAILSTREAM *stream,void *sbuf);
 long mh_ping (MAILSTREAM *stream);
 void mh_check (MAILSTREAM *stream);
+int mh_watch (MAILSTREAM *stream);
 long mh_expunge (MAILSTREAM *stream,char *sequence,long options);
 long mh_copy (MAILSTREAM *stream,char *sequence,char *mailbox,
 	      long options);
@@ -141,14 +149,15 @@ DRIVER mhdriver = {
   NIL,				/* modify flags */
   NIL,				/* per-message modify flags */
   NIL,				/* search for message based on criteria */
-  NIL,				/* sort messages */
-  NIL,				/* thread messages */
+  mh_sort,			/* sort messages */
+  mh_thread,			/* thread messages */
   mh_ping,			/* ping mailbox to see if still alive */
   mh_check,			/* check for new messages */
   mh_expunge,			/* expunge deleted messages */
   mh_copy,			/* copy messages to another mailbox */
   mh_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  mh_watch			/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -592,6 +601,7 @@ MAILSTREAM *mh_open (MAILSTREAM *stream)
      !compare_cstring (stream->mailbox,"INBOX")) ? T : NIL;
   mh_file (tmp,stream->mailbox);/* get directory name */
   LOCAL->dir = cpystr (tmp);	/* copy directory name for later */
+  LOCAL->wd = -1;		/* not watching for changes yet */
   LOCAL->scantime = 0;		/* not scanned yet */
   LOCAL->cachedtexts = 0;	/* no cached texts */
   stream->sequence++;		/* bump sequence number */
@@ -615,6 +625,7 @@ void mh_close (MAILSTREAM *stream,long options)
     stream->silent = T;		/* note this stream is dying */
     if (options & CL_EXPUNGE) mh_expunge (stream,NIL,NIL);
     if (LOCAL->dir) fs_give ((void **) &LOCAL->dir);
+    if (LOCAL->wd >= 0) close (LOCAL->wd);
 				/* nuke the local data */
     fs_give ((void **) &stream->local);
     stream->dtb = NIL;		/* log out the DTB */
@@ -831,6 +842,77 @@ long mh_text (MAILSTREAM *stream,unsigned long msgno,STRING *bs,long flags)
   return T;
 }
 
+/* MH mail sort messages
+ * Accepts: mail stream
+ *	    character set
+ *	    search program
+ *	    sort program
+ *	    option flags
+ * Returns: vector of sorted message sequences or NIL if error
+ */
+
+unsigned long *mh_sort (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
+		       SORTPGM *pgm,long flags)
+{
+  unsigned long *ret;
+  unsigned long validity = 0;
+  struct stat sbuf;
+  FILE *sortcache = NIL;
+				/* UIDs are not sticky, validate folder */
+  if (!stat (LOCAL->dir,&sbuf))
+    sortcache = sortcache_open (stream,&sbuf,
+				validity = mh_sortvalidity (stream,&sbuf),
+				&LOCAL->sortcacheseq);
+  ret = mail_sort_msgs (stream,charset,spg,pgm,flags);
+  sortcache_update (stream,&sortcache,validity,&LOCAL->sortcacheseq);
+  return ret;
+}
+
+
+/* MH mail thread messages
+ * Accepts: mail stream
+ *	    thread type
+ *	    character set
+ *	    search program
+ *	    option flags
+ * Returns: thread node tree or NIL if error
+ */
+
+THREADNODE *mh_thread (MAILSTREAM *stream,char *type,char *charset,
+		       SEARCHPGM *spg,long flags)
+{
+  THREADNODE *ret;
+  unsigned long validity = 0;
+  struct stat sbuf;
+  FILE *sortcache = NIL;
+  if (!stat (LOCAL->dir,&sbuf))
+    sortcache = sortcache_open (stream,&sbuf,
+				validity = mh_sortvalidity (stream,&sbuf),
+				&LOCAL->sortcacheseq);
+  ret = mail_thread_msgs (stream,type,charset,spg,flags,mail_sort_msgs);
+  sortcache_update (stream,&sortcache,validity,&LOCAL->sortcacheseq);
+  return ret;
+}
+
+
+/* MH sort cache validity
+ * Accepts: mail stream
+ *	    folder directory status
+ * Returns: sort cache validity of folder
+ *
+ * MH message numbers are reassigned when a folder is packed, so the sort
+ * cache is only used while the folder directory modification time, the
+ * number of messages and the highest message number are all unchanged.
+ */
+
+unsigned long mh_sortvalidity (MAILSTREAM *stream,void *sbuf)
+{
+  struct stat *dbuf = (struct stat *) sbuf;
+				/* combine mtime, count and last number */
+  return ((((unsigned long) dbuf->st_mtime * 65599) + stream->nmsgs) *
+	  65599) + stream->uid_last;
+}
+
 /* MH mail ping mailbox
  * Accepts: MAIL stream
  * Returns: T if stream alive, else NIL
@@ -963,6 +1045,17 @@ void mh_check (MAILSTREAM *stream)
 }
 
 
+/* MH mail watch mailbox
+ * Accepts: MAIL stream
+ * Returns: descriptor readable when messages are added or removed, or -1
+ */
+
+int mh_watch (MAILSTREAM *stream)
+{
+  return LOCAL ? watch_file (&LOCAL->wd,LOCAL->dir,NIL) : -1;
+}
+
+
 /* MH mail expunge mailbox
  * Accepts: MAIL stream
  *	    sequence to expunge if non-NIL
@@ -31,7 +31,11 @@ extern int errno;		/* just in case */
 #include "osdep.h"
 #include <pwd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/time.h>
+#include "rfc822.h"
+#include "utf8.h"
+#include "utf8aux.h"
 #include "misc.h"
 #include "dummy.h"
 #include "fdstring.h"
@@ -50,6 +54,9 @@ extern int errno;		/* just in case */
 #define MIXINDEX "index"	/* suffix for index */
 #define MIXSTATUS "status"	/* suffix for status */
 #define MIXSORTCACHE "sortcache"/* suffix for sortcache */
+#define MIXTEXT "text"		/* suffix for text index */
+#define MIXBINDEX "bindex"	/* suffix for binary index */
+#define MIXBSTATUS "bstatus"	/* suffix for binary status */
 #define METAMAX (MEGABYTE-1)	/* maximum metadata file size (sanity check) */
 
 
@@ -69,6 +76,67 @@ extern int errno;		/* just in case */
 #define MSGTSZ (sizeof(MSGTOK)-1)
 				/* sortcache file record format */
 #define SCRFMT ":%08lx:%08lx:%08lx:%08lx:%08lx:%c%08lx:%08lx:%08lx:\015\012"
+				/* text index file record format */
+#define TXRFMT ":%08lx:%04lx:%s\015\012"
+				/* status records rewritten in place, at most
+				 * this many or 1/STATUSINPLACE of the file */
+#define STATUSINPLACE 8
+
+
+/* MIX binary index and status files
+ *
+ * These hold the same records as the index and status files in fixed size
+ * binary form, so that opening a mailbox can map them instead of parsing
+ * text.  One is written after each rewrite of its text file, and is used
+ * only if its header still matches the sequence, size, and time of the text
+ * file; so an older version which updates only the text files just makes it
+ * stale until the next rewrite.  They are in the byte order of the writer,
+ * and are ignored by a host of the other byte order.
+ */
+
+#define MIXBINMAGIC "mixbin01"
+#define MIXBINORDER 0x01020304	/* byte order marker */
+
+typedef struct mix_binary_header {
+  char magic[8];		/* MIXBINMAGIC */
+  unsigned int order;		/* MIXBINORDER */
+  unsigned int recsize;		/* size of a record */
+  unsigned int seq;		/* sequence of text file */
+  unsigned int nrecs;		/* number of records */
+  unsigned int textsize;	/* size of text file */
+  unsigned int texttime;	/* modification time of text file */
+} MIXBINHDR;
+
+typedef struct mix_binary_index {
+  unsigned int uid;		/* message UID */
+  unsigned int size;		/* RFC822 size */
+  unsigned int file;		/* data file number */
+  unsigned int pos;		/* message position in data file */
+  unsigned int hpos;		/* header offset from message position */
+  unsigned int hsiz;		/* header size */
+  unsigned int date;		/* internal date */
+  unsigned int time;		/* internal time and zone */
+} MIXBINIDX;
+
+typedef struct mix_binary_status {
+  unsigned int uid;		/* message UID */
+  unsigned int user_flags;	/* keywords */
+  unsigned int flags;		/* system flags as in text file */
+  unsigned int mod;		/* modseq */
+  unsigned int pos;		/* position of record in text file */
+  unsigned int spare;		/* reserved */
+} MIXBINSTAT;
+
+
+/* MIX text index signatures */
+
+#define TXTBITS 65536		/* trigram hash space */
+#define TXTMINBITS 256		/* smallest signature */
+#define TXTMAXKEYS 64		/* maximum trigrams tested per search */
+				/* hash of byte trigram */
+#define TXTHASH(s) ((unsigned int) ((((((unsigned long) (s)[0]) << 16) + \
+  (((unsigned long) (s)[1]) << 8) + (s)[2]) * 2654435761UL >> 13) & \
+  (TXTBITS - 1)))
 
 /* MIX I/O stream local data */
 	
@@ -78,6 +146,7 @@ typedef struct mix_local {
   time_t lastsnarf;		/* last snarf time */
   int msgfd;			/* file description of current msg file */
   int mfd;			/* file descriptor of open metadata */
+  int wd;			/* change watch descriptor */
   unsigned long metaseq;	/* metadata sequence */
   char *index;			/* mailbox index name */
   unsigned long indexseq;	/* index sequence */
@@ -85,10 +154,16 @@ typedef struct mix_local {
   unsigned long statusseq;	/* status sequence */
   char *sortcache;		/* mailbox sortcache name */
   unsigned long sortcacheseq;	/* sortcache sequence */
+  char *text;			/* mailbox text index name */
+  unsigned long textseq;	/* text index sequence */
+  char *bindex;			/* mailbox binary index name */
+  char *bstatus;		/* mailbox binary status name */
   unsigned char *buf;		/* temporary buffer */
   unsigned long buflen;		/* current size of temporary buffer */
   unsigned int expok : 1;	/* non-zero if expunge reports OK */
   unsigned int internal : 1;	/* internally opened, do not validate */
+  unsigned int burpmore : 1;	/* burp stopped short by its budget */
+  unsigned int statusfull : 1;	/* status must be rewritten in full */
 } MIXLOCAL;
 
 
@@ -103,6 +178,40 @@ MIXBURP {
 };
 
 
+/* MIX binary file mapping */
+
+typedef struct mix_binary_map {
+  char *base;			/* mapped file, or NIL if not in use */
+  size_t size;			/* size of mapping */
+  unsigned long nrecs;		/* number of records */
+  unsigned long cur;		/* next record to read */
+} MIXBINMAP;
+
+
+/* MIX index record, from either text or binary index */
+
+typedef struct mix_index_record {
+  unsigned long uid;		/* message UID */
+  unsigned long size;		/* RFC822 size */
+  unsigned long file;		/* data file number */
+  unsigned long pos;		/* message position in data file */
+  unsigned long hpos;		/* header offset from message position */
+  unsigned long hsiz;		/* header size */
+  unsigned int y,m,d,hh,mm,ss,z,zh,zm;
+} MIXIDXREC;
+
+
+/* MIX status record, from either text or binary status */
+
+typedef struct mix_status_record {
+  unsigned long uid;		/* message UID */
+  unsigned long user_flags;	/* keywords */
+  unsigned long flags;		/* system flags */
+  unsigned long mod;		/* modseq */
+  long pos;			/* position of record in text file */
+} MIXSTATREC;
+
+
 /* Convenient access to local data */
 
 #define LOCAL ((MIXLOCAL *) stream->local)
@@ -124,6 +233,7 @@ long mix_create (MAILSTREAM *stream,char *mailbox);
 long mix_delete (MAILSTREAM *stream,char *mailbox);
 long mix_rename (MAILSTREAM *stream,char *old,char *newname);
 int mix_rselect (struct direct *name);
+long mix_status (MAILSTREAM *stream,char *mbx,long flags);
 MAILSTREAM *mix_open (MAILSTREAM *stream);
 void mix_close (MAILSTREAM *stream,long options);
 void mix_abort (MAILSTREAM *stream);
@@ -131,17 +241,22 @@ char *mix_header (MAILSTREAM *stream,unsigned long msgno,unsigned long *length,
 		  long flags);
 long mix_text (MAILSTREAM *stream,unsigned long msgno,STRING *bs,long flags);
 void mix_flag (MAILSTREAM *stream,char *sequence,char *flag,long flags);
+long mix_search (MAILSTREAM *stream,char *charset,SEARCHPGM *pgm,long flags);
 unsigned long *mix_sort (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
 			 SORTPGM *pgm,long flags);
 THREADNODE *mix_thread (MAILSTREAM *stream,char *type,char *charset,
 			SEARCHPGM *spg,long flags);
 long mix_ping (MAILSTREAM *stream);
 void mix_check (MAILSTREAM *stream);
+int mix_watch (MAILSTREAM *stream);
 long mix_expunge (MAILSTREAM *stream,char *sequence,long options);
+long mix_expunge_work (MAILSTREAM *stream,char *sequence,long options,
+		       long ping);
 int mix_select (struct direct *name);
 int mix_msgfsort (const void *d1,const void *d2);
 long mix_addset (SEARCHSET **set,unsigned long start,unsigned long size);
-long mix_burp (MAILSTREAM *stream,MIXBURP *burp,unsigned long *reclaimed);
+long mix_burp (MAILSTREAM *stream,MIXBURP *burp,unsigned long *reclaimed,
+	       unsigned long *budget);
 long mix_burp_check (SEARCHSET *set,size_t size,char *file);
 long mix_copy (MAILSTREAM *stream,char *sequence,char *mailbox,
 	       long options);
@@ -154,10 +269,38 @@ char *mix_meta_slurp (MAILSTREAM *stream,unsigned long *seq);
 long mix_meta_update (MAILSTREAM *stream);
 long mix_index_update (MAILSTREAM *stream,FILE *idxf,long flag);
 long mix_status_update (MAILSTREAM *stream,FILE *statf,long flag);
+long mix_status_inplace (MAILSTREAM *stream,FILE *statf);
+long mix_index_parse (MAILSTREAM *stream,FILE *idxf,MIXBINMAP *map,
+		      short *metarepairneeded,short *indexrepairneeded);
+long mix_index_record (MAILSTREAM *stream,FILE *idxf,MIXBINMAP *map,
+		       MIXIDXREC *rec);
+long mix_status_record (MAILSTREAM *stream,FILE *statf,MIXBINMAP *map,
+			MIXSTATREC *rec);
+long mix_binary_map (MIXBINMAP *map,char *name,FILE *f,unsigned long seq,
+		     size_t recsize);
+void mix_binary_unmap (MIXBINMAP *map);
+void mix_binary_write (char *name,FILE *f,unsigned long seq,size_t recsize,
+		       void *recs,unsigned long nrecs);
+void mix_index_binary (MAILSTREAM *stream,FILE *idxf);
+void mix_status_binary (MAILSTREAM *stream,FILE *statf);
+void mix_status_binary_inplace (MAILSTREAM *stream,FILE *statf,
+				unsigned long oldseq);
+long mix_status_binary_record (MESSAGECACHE *elt,MIXBINSTAT *rec);
 FILE *mix_data_open (MAILSTREAM *stream,int *fd,long *size,
 		     unsigned long newsize);
 FILE *mix_sortcache_open (MAILSTREAM *stream);
 long mix_sortcache_update (MAILSTREAM *stream,FILE **sortcache);
+char *mix_text_search (MAILSTREAM *stream,SEARCHPGM *pgm);
+unsigned long mix_text_keys (STRINGLIST *sl,unsigned int *keys,
+			     unsigned long nkeys);
+long mix_text_match (char *sig,unsigned long len,unsigned int *keys,
+		     unsigned long nkeys);
+char *mix_text_signature (MAILSTREAM *stream,unsigned long msgno,
+			  unsigned long *len);
+void mix_text_body (MAILSTREAM *stream,unsigned long msgno,BODY *body,
+		    char *prefix,unsigned long section,unsigned char *map);
+void mix_text_string (SIZEDTEXT *s,char *charset,unsigned char *map);
+void mix_text_hash (SIZEDTEXT *s,unsigned char *map);
 char *mix_read_record (FILE *f,char *buf,unsigned long buflen,char *type);
 unsigned long mix_read_sequence (FILE *f);
 char *mix_dir (char *dst,char *name);
@@ -185,7 +328,7 @@ DRIVER mixdriver = {
   mix_create,			/* create mailbox */
   mix_delete,			/* delete mailbox */
   mix_rename,			/* rename mailbox */
-  mail_status_default,		/* status of mailbox */
+  mix_status,			/* status of mailbox */
   mix_open,			/* open mailbox */
   mix_close,			/* close mailbox */
   NIL,				/* fetch message "fast" attributes */
@@ -199,7 +342,7 @@ DRIVER mixdriver = {
   NIL,				/* message number */
   mix_flag,			/* modify flags */
   NIL,				/* per-message modify flags */
-  NIL,				/* search for message based on criteria */
+  mix_search,			/* search for message based on criteria */
   mix_sort,			/* sort messages */
   mix_thread,			/* thread messages */
   mix_ping,			/* ping mailbox to see if still alive */
@@ -207,11 +350,16 @@ DRIVER mixdriver = {
   mix_expunge,			/* expunge deleted messages */
   mix_copy,			/* copy messages to another mailbox */
   mix_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  mix_watch			/* watch mailbox for changes */
 };
 
 				/* prototype stream */
 MAILSTREAM mixproto = {&mixdriver};
+
+				/* driver parameters */
+static long mix_textindex = NIL;
+static long mix_burpbudget = 0;	/* bytes moved per burp, 0 means no limit */
 
 /* MIX mail validate mailbox
  * Accepts: mailbox name
@@ -266,12 +414,26 @@ void *mix_parameters (long function,void *value)
   case GET_SCANCONTENTS:
     ret = (void *) mix_scan_contents;
     break;
+  case SET_MIXTEXTINDEX:
+    mix_textindex = (long) value;
+  case GET_MIXTEXTINDEX:
+    ret = (void *) mix_textindex;
+    break;
+  case SET_MIXBURPBUDGET:
+    mix_burpbudget = (long) value;
+  case GET_MIXBURPBUDGET:
+    ret = (void *) mix_burpbudget;
+    break;
   case SET_ONETIMEEXPUNGEATPING:
     if (value) ((MIXLOCAL *) ((MAILSTREAM *) value)->local)->expok = T;
   case GET_ONETIMEEXPUNGEATPING:
     if (value) ret = (void *)
       (((MIXLOCAL *) ((MAILSTREAM *) value)->local)->expok ? VOIDT : NIL);
     break;
+  case GET_HIGHESTMODSEQ:	/* status sequence is the highest modseq */
+    if (value && ((MAILSTREAM *) value)->local) ret = (void *)
+      ((MIXLOCAL *) ((MAILSTREAM *) value)->local)->statusseq;
+    break;
   }
   return ret;
 }
@@ -590,6 +752,23 @@ int mix_rselect (struct direct *name)
   return mix_dirfmttest (name->d_name);
 }
 
+/* MIX mail status
+ * Accepts: mail stream
+ *	    mailbox name
+ *	    status flags
+ * Returns: T on success, NIL on failure
+ */
+
+long mix_status (MAILSTREAM *stream,char *mbx,long flags)
+{
+  static char *files[] = {MIXNAME MIXMETA,MIXNAME MIXINDEX,MIXNAME MIXSTATUS,
+			  NIL};
+  char tmp[MAILTMPLEN];
+  return *mix_dir (tmp,mbx) ?
+    statuscache_status (stream,mbx,flags,tmp,files) :
+    mail_status_default (stream,mbx,flags);
+}
+
 /* MIX mail open
  * Accepts: stream to open
  * Returns: stream on success, NIL on failure
@@ -612,6 +791,7 @@ MAILSTREAM *mix_open (MAILSTREAM *stream)
   fs_give ((void **) &stream->mailbox);
   stream->mailbox = cpystr (LOCAL->buf);
   LOCAL->msgfd = -1;		/* currently no file open */
+  LOCAL->wd = -1;		/* not watching for changes yet */
   if (!(((!stream->rdonly &&	/* open metadata file */
 	  ((LOCAL->mfd = open (mix_file (LOCAL->buf,stream->mailbox,MIXMETA),
 			       O_RDWR,NIL)) >= 0)) ||
@@ -628,6 +808,10 @@ MAILSTREAM *mix_open (MAILSTREAM *stream)
     LOCAL->status = cpystr (mix_file (LOCAL->buf,stream->mailbox,MIXSTATUS));
     LOCAL->sortcache = cpystr (mix_file (LOCAL->buf,stream->mailbox,
 					 MIXSORTCACHE));
+    LOCAL->text = cpystr (mix_file (LOCAL->buf,stream->mailbox,MIXTEXT));
+    LOCAL->bindex = cpystr (mix_file (LOCAL->buf,stream->mailbox,MIXBINDEX));
+    LOCAL->bstatus = cpystr (mix_file (LOCAL->buf,stream->mailbox,
+				       MIXBSTATUS));
     stream->sequence++;		/* bump sequence number */
 				/* parse mailbox */
     stream->nmsgs = stream->recent = 0;
@@ -683,9 +867,13 @@ void mix_abort (MAILSTREAM *stream)
     if (LOCAL->msgfd >= 0) close (LOCAL->msgfd);
 				/* close current metadata file if open */
     if (LOCAL->mfd >= 0) close (LOCAL->mfd);
+    if (LOCAL->wd >= 0) close (LOCAL->wd);
     if (LOCAL->index) fs_give ((void **) &LOCAL->index);
     if (LOCAL->status) fs_give ((void **) &LOCAL->status);
     if (LOCAL->sortcache) fs_give ((void **) &LOCAL->sortcache);
+    if (LOCAL->text) fs_give ((void **) &LOCAL->text);
+    if (LOCAL->bindex) fs_give ((void **) &LOCAL->bindex);
+    if (LOCAL->bstatus) fs_give ((void **) &LOCAL->bstatus);
 				/* free local scratch buffer */
     if (LOCAL->buf) fs_give ((void **) &LOCAL->buf);
 				/* nuke the local data */
@@ -872,6 +1060,39 @@ void mix_flag (MAILSTREAM *stream,char *sequence,char *flag,long flags)
   if (idxf) fclose (idxf);	/* release index file */
 }
 
+/* MIX mail search messages
+ * Accepts: mail stream
+ *	    character set
+ *	    search program
+ *	    option flags
+ * Returns: T if successful, NIL if bad charset
+ */
+
+long mix_search (MAILSTREAM *stream,char *charset,SEARCHPGM *pgm,long flags)
+{
+  unsigned long i;
+  char *msg,*cand;
+				/* make sure that charset is good */
+  if (msg = utf8_badcharset (charset)) {
+    MM_LOG (msg,ERROR);		/* output error */
+    fs_give ((void **) &msg);
+    return NIL;
+  }
+  utf8_searchpgm (pgm,charset);
+				/* let text index narrow the candidates */
+  cand = mix_textindex ? mix_text_search (stream,pgm) : NIL;
+  for (i = 1; i <= stream->nmsgs; ++i)
+    if ((!cand || cand[i]) && mail_search_msg (stream,i,NIL,pgm)) {
+      if (flags & SE_UID) mm_searched (stream,mail_uid (stream,i));
+      else {			/* mark as searched, notify mail program */
+	mail_elt (stream,i)->searched = T;
+	if (!stream->silent) mm_searched (stream,i);
+      }
+    }
+  if (cand) fs_give ((void **) &cand);
+  return LONGT;			/* search completed */
+}
+
 /* MIX mail sort messages
  * Accepts: mail stream
  *	    character set
@@ -991,6 +1212,10 @@ long mix_ping (MAILSTREAM *stream)
     ret = LONGT;		/* declare success */
   }
   if (idxf) fclose (idxf);	/* release index file */
+				/* another step of unfinished burp, only
+				 * when expunges may be reported */
+  if (ret && LOCAL->burpmore && LOCAL->expok && !stream->rdonly)
+    mix_expunge_work (stream,"",NIL,LONGT);
   LOCAL->expok = NIL;		/* expunge no longer OK */
   if (!ret) mix_abort (stream);	/* murdelyze stream if ping fails */
   return ret;
@@ -1008,6 +1233,17 @@ void mix_check (MAILSTREAM *stream)
 				/* do burp-only expunge action */
   if (mix_expunge (stream,"",NIL)) MM_LOG ("Check completed",(long) NIL);
 }
+
+
+/* MIX mail watch mailbox
+ * Accepts: MAIL stream
+ * Returns: descriptor readable when mailbox directory changes, or -1
+ */
+
+int mix_watch (MAILSTREAM *stream)
+{
+  return LOCAL ? watch_file (&LOCAL->wd,stream->mailbox,LONGT) : -1;
+}
 
 /* MIX mail expunge mailbox
  * Accepts: MAIL stream
@@ -1017,6 +1253,24 @@ void mix_check (MAILSTREAM *stream)
  */
 
 long mix_expunge (MAILSTREAM *stream,char *sequence,long options)
+{
+  return mix_expunge_work (stream,sequence,options,NIL);
+}
+
+
+/* MIX mail expunge mailbox worker
+ * Accepts: MAIL stream
+ *	    sequence to expunge if non-NIL, empty string for burp only
+ *	    expunge options
+ *	    non-NIL if continuing a burp from ping
+ * Returns: T on success, NIL if failure
+ *
+ * A burp continued from ping is not an expunge by the client, so it keeps
+ * the caller's choice of whether expunges may be reported and is silent.
+ */
+
+long mix_expunge_work (MAILSTREAM *stream,char *sequence,long options,
+		       long ping)
 {
   FILE *idxf = NIL;
   FILE *statf = NIL;
@@ -1026,8 +1280,9 @@ long mix_expunge (MAILSTREAM *stream,char *sequence,long options)
   unsigned long i;
   unsigned long nexp = 0;
   unsigned long reclaimed = 0;
+  unsigned long budget = mix_burpbudget;
   int burponly = (sequence && !*sequence);
-  LOCAL->expok = T;		/* expunge during ping is OK */
+  if (!ping) LOCAL->expok = T;	/* expunge during ping is OK */
   if (!(ret = burponly || !sequence ||
 	((options & EX_UID) ?
 	 mail_uid_sequence (stream,sequence) :
@@ -1050,6 +1305,7 @@ long mix_expunge (MAILSTREAM *stream,char *sequence,long options)
       void *a;
       struct direct **names = NIL;
       long nfiles = scandir (stream->mailbox,&names,mix_select,mix_msgfsort);
+      LOCAL->burpmore = NIL;	/* no unfinished burp yet */
       if (nfiles > 0) {		/* if have message files */
 	MIXBURP *burp,*cur;
 				/* initialize burp list */
@@ -1090,8 +1346,12 @@ long mix_expunge (MAILSTREAM *stream,char *sequence,long options)
 	}
 	if (ret) 		/* if no errors, burp all files */
 	  for (cur = burp; ret && cur; cur = cur->next) {
-				/* if non-empty, burp it */
-	    if (cur->set.last) ret = mix_burp (stream,cur,&reclaimed);
+				/* if non-empty, burp it within budget */
+	    if (cur->set.last) {
+	      if (mix_burpbudget && !budget) LOCAL->burpmore = T;
+	      else ret = mix_burp (stream,cur,&reclaimed,
+				   mix_burpbudget ? &budget : NIL);
+	    }
 				/* empty, delete it unless new msg file */
 	    else if (mix_file_data (LOCAL->buf,stream->mailbox,cur->fileno) &&
 		     ((cur->fileno == LOCAL->newmsg) ?
@@ -1118,10 +1378,13 @@ long mix_expunge (MAILSTREAM *stream,char *sequence,long options)
     if (flock (LOCAL->mfd,LOCK_SH|LOCK_NB))
       fatal ("Unable to re-acquire metadata shared lock!");
     /* Do this step even if ret is NIL (meaning some burp problem)! */
-    if (nexp || reclaimed) {	/* rewrite index and status if changed */
+				/* rewrite index and status if changed */
+    if (nexp || reclaimed || LOCAL->burpmore) {
       LOCAL->indexseq = mix_modseq (LOCAL->indexseq);
       if (ret = mix_index_update (stream,idxf,NIL)) {
 	LOCAL->statusseq = mix_modseq (LOCAL->statusseq);
+				/* drop records of expunged messages */
+	if (nexp || reclaimed) LOCAL->statusfull = T;
 				/* set failure if update fails */
 	ret = mix_status_update (stream,statf,NIL);
       }
@@ -1129,8 +1392,8 @@ long mix_expunge (MAILSTREAM *stream,char *sequence,long options)
   }
   if (statf) fclose (statf);	/* close status if still open */
   if (idxf) fclose (idxf);	/* close index if still open */
-  LOCAL->expok = NIL;		/* cancel expok */
-  if (ret) {			/* only if success */
+  if (!ping) LOCAL->expok = NIL;/* cancel expok */
+  if (ret && !ping) {		/* only if success and not from ping */
     char *s = NIL;
     if (nexp) sprintf (s = LOCAL->buf,"Expunged %lu messages",nexp);
     else if (reclaimed)
@@ -1205,20 +1468,28 @@ long mix_addset (SEARCHSET **set,unsigned long start,unsigned long size)
 /* MIX burp message file
  * Accepts: MAIL stream
  *	    current burp block for this message
+ *	    pointer to bytes reclaimed
+ *	    pointer to remaining budget of bytes to move, or NIL if no limit
  * Returns: T if successful, NIL if failed
+ *
+ * If the budget runs out, messages are moved only up to a message boundary,
+ * and the file is left with a hole before the rest, which are not moved.
+ * The index still describes every message, so a later burp continues.  At
+ * least one message is moved, so every burp makes progress.
  */
 
 static char *staterr = "Error in stat of mix message file %.80s: %.80s";
 static char *truncerr = "Error truncating mix message file %.80s: %.80s";
 
-long mix_burp (MAILSTREAM *stream,MIXBURP *burp,unsigned long *reclaimed)
+long mix_burp (MAILSTREAM *stream,MIXBURP *burp,unsigned long *reclaimed,
+	       unsigned long *budget)
 {
   MESSAGECACHE *elt;
   SEARCHSET *set;
   struct stat sbuf;
-  off_t rpos,wpos;
+  off_t rpos,wpos,stop;
   size_t size,wsize,wpending,written;
-  int fd;
+  int fd,moving;
   FILE *f;
   void *s;
   unsigned long i;
@@ -1271,11 +1542,28 @@ long mix_burp (MAILSTREAM *stream,MIXBURP *burp,unsigned long *reclaimed)
 	MM_LOG (LOCAL->buf,ERROR);
 	fclose (f);
 	return NIL;		/* burp fails for this file */
+      }
+				/* find first message over budget */
+    for (i = 1, rpos = 0, stop = sbuf.st_size, moving = NIL;
+	 budget && (i <= stream->nmsgs); ++i)
+      if ((elt = mail_elt (stream,i))->private.spare.data == burp->fileno) {
+	size = elt->private.msg.header.offset + elt->rfc822_size;
+				/* does this message have to move? */
+	if (elt->private.special.offset != rpos) {
+	  if (moving && (size > *budget)) {
+	    stop = elt->private.special.offset;
+	    break;		/* not this time */
+	  }
+	  *budget -= min (size,*budget);
+	  moving = T;		/* at least one message moves */
+	}
+	rpos += size;
       }
 				/* burp out each old message */
-    for (set = &burp->set, rpos = wpos = 0; set; set = set->next) {
+    for (set = &burp->set, rpos = wpos = 0; set && (set->first < stop);
+	 set = set->next) {
 				/* move down this range */
-      for (rpos = set->first, size = set->last - set->first;
+      for (rpos = set->first, size = min (set->last,stop) - set->first;
 	   size; size -= wsize) {
 	if (rpos != wpos) {	/* data to skip at start? */
 				/* no, slide this buffer down */
@@ -1307,7 +1595,10 @@ long mix_burp (MAILSTREAM *stream,MIXBURP *burp,unsigned long *reclaimed)
       MM_NOTIFY (stream,strerror (errno),WARN);
       MM_DISKERROR (stream,errno,T);
     }
-    if (ftruncate (fd,wpos)) {	/* flush cruft at end of file */
+				/* stopped short, leave rest for later */
+    if (stop < sbuf.st_size) LOCAL->burpmore = T;
+				/* else flush cruft at end of file */
+    else if (ftruncate (fd,wpos)) {
       sprintf (LOCAL->buf,truncerr,burp->name,strerror (errno));
       MM_LOG (LOCAL->buf,WARN);
     }
@@ -1315,7 +1606,8 @@ long mix_burp (MAILSTREAM *stream,MIXBURP *burp,unsigned long *reclaimed)
     ret = !fclose (f);		/* close file */
 				/* slide down message positions in index */
     for (i = 1,rpos = 0; i <= stream->nmsgs; ++i)
-      if ((elt = mail_elt (stream,i))->private.spare.data == burp->fileno) {
+      if (((elt = mail_elt (stream,i))->private.spare.data == burp->fileno) &&
+	  (elt->private.special.offset < stop)) {
 	elt->private.special.offset = rpos;
 	rpos += elt->private.msg.header.offset + elt->rfc822_size;
       }
@@ -1726,8 +2018,7 @@ FILE *mix_parse (MAILSTREAM *stream,FILE **idxf,long iflags,long sflags)
 {
   int fd;
   unsigned long i;
-  char *s,*t;
-  struct stat sbuf;
+  char *s;
   FILE *statf = NIL;
   short metarepairneeded = 0;
   short indexrepairneeded = 0;
@@ -1820,223 +2111,28 @@ FILE *mix_parse (MAILSTREAM *stream,FILE **idxf,long iflags,long sflags)
     }
 				/* sequence changed from last time? */
     else if (j || (i > LOCAL->indexseq)) {
-      unsigned long prevuid = 0;
-      unsigned long uid,nmsgs,curfile,curfilesize,curpos;
-      char *t,*msg,tmp[MAILTMPLEN];
-				/* start with no messages */
-      curfile = curfilesize = curpos = nmsgs = 0;
+      MIXBINMAP map;
 				/* update sequence iff expunging OK */
       if (LOCAL->expok) LOCAL->indexseq = i;
-				/* get first elt */
-      while ((s = mix_read_record (*idxf,LOCAL->buf,LOCAL->buflen,"index")) &&
-	     *s)
-	switch (*s) {
-	case ':':		/* message record */
-	  if (!(isxdigit (*++s) && (uid = strtoul (s,&t,16)))) msg = "UID";
-	  else if (!((*t++ == ':') && isdigit (*t) && isdigit (t[1]) &&
-		     isdigit (t[2]) && isdigit (t[3]) && isdigit (t[4]) &&
-		     isdigit (t[5]) && isdigit (t[6]) && isdigit (t[7]) &&
-		     isdigit (t[8]) && isdigit (t[9]) && isdigit (t[10]) &&
-		     isdigit (t[11]) && isdigit (t[12]) && isdigit (t[13]) &&
-		     ((t[14] == '+') || (t[14] == '-')) && 
-		     isdigit (t[15]) && isdigit (t[16]) && isdigit (t[17]) &&
-		     isdigit (t[18]))) msg = "internaldate";
-	  else if ((*(s = t+19) != ':') || !isxdigit (*++s)) msg = "size";
-	  else {
-	    unsigned int y = (((*t - '0') * 1000) + ((t[1] - '0') * 100) +
-			      ((t[2] - '0') * 10) + t[3] - '0') - BASEYEAR;
-	    unsigned int m = ((t[4] - '0') * 10) + t[5] - '0';
-	    unsigned int d = ((t[6] - '0') * 10) + t[7] - '0';
-	    unsigned int hh = ((t[8] - '0') * 10) + t[9] - '0';
-	    unsigned int mm = ((t[10] - '0') * 10) + t[11] - '0';
-	    unsigned int ss = ((t[12] - '0') * 10) + t[13] - '0';
-	    unsigned int z = (t[14] == '-') ? 1 : 0;
-	    unsigned int zh = ((t[15] - '0') * 10) + t[16] - '0';
-	    unsigned int zm = ((t[17] - '0') * 10) + t[18] - '0';
-	    unsigned long size = strtoul (s,&s,16);
-	    if ((*s++ == ':') && isxdigit (*s)) {
-	      unsigned long file = strtoul (s,&s,16);
-	      if ((*s++ == ':') && isxdigit (*s)) {
-		unsigned long pos = strtoul (s,&s,16);
-		if ((*s++ == ':') && isxdigit (*s)) {
-		  unsigned long hpos = strtoul (s,&s,16);
-		  if ((*s++ == ':') && isxdigit (*s)) {
-		    unsigned long hsiz = strtoul (s,&s,16);
-		    if (uid > stream->uid_last) {
-		      sprintf (tmp,"mix index invalid UID (%08lx < %08lx)",
-			       uid,stream->uid_last);
-		      if (stream->rdonly) {
-			MM_LOG (tmp,ERROR);
-			return NIL;
-		      }
-		      strcat (tmp,", repaired");
-		      MM_LOG (tmp,WARN);
-		      stream->uid_last = uid;
-		      metarepairneeded = T;
-		    }
-
-				/* ignore expansion values */
-		    if (*s++ == ':') {
-		      MESSAGECACHE *elt;
-		      if(prevuid > uid) {
-			sprintf (tmp,"mix index backwards UID: %lx",uid);
-			MM_LOG (tmp,ERROR);
-			return NIL;
-		      }
-		      prevuid = uid;
-		      ++nmsgs;	/* this is another mesage */
-				/* within current known range of messages? */
-		      while (nmsgs <= stream->nmsgs) {
-				/* yes, get corresponding elt */
-			elt = mail_elt (stream,nmsgs);
-				/* existing message with matching data? */
-			if (uid == elt->private.uid) {
-				/* beware of Dracula's resurrection */
-			  if (elt->private.ghost) {
-			    sprintf (tmp,"mix index data unexpunged UID: %lx",
-				     uid);
-			    MM_LOG (tmp,ERROR);
-			    return NIL;
-			  }
-				/* also of static data changing */
-			  if ((size != elt->rfc822_size) ||
-			      (file != elt->private.spare.data) ||
-			      (pos != elt->private.special.offset) ||
-			      (hpos != elt->private.msg.header.offset) ||
-			      (hsiz != elt->private.msg.header.text.size) ||
-			      (y != elt->year) || (m != elt->month) ||
-			      (d != elt->day) || (hh != elt->hours) ||
-			      (mm != elt->minutes) || (ss != elt->seconds) ||
-			      (z != elt->zoccident) || (zh != elt->zhours) ||
-			      (zm != elt->zminutes)) {
-			    sprintf (tmp,"mix index data mismatch: %lx",uid);
-			    MM_LOG (tmp,ERROR);
-			    return NIL;
-			  }
-			  break;
-			}
-				/* existing msg with lower UID is expunged */
-			else if (uid > elt->private.uid) {
-			  if (LOCAL->expok) mail_expunged (stream,nmsgs);
-			  else {/* message expunged, but not yet for us */
-			    ++nmsgs;
-			    elt->private.ghost = T;
-			  }
-			}
-			else {	/* unexpected message record */
-			  sprintf (tmp,"mix index UID mismatch (%lx < %lx)",
-				   uid,elt->private.uid);
-			  MM_LOG (tmp,ERROR);
-			  return NIL;
-			}
-		      }
-
-				/* time to create a new message? */
-		      if (nmsgs > stream->nmsgs) {
-				/* defer announcing until later */
-			stream->silent = T;
-			mail_exists (stream,nmsgs);
-			stream->silent = silent;
-			(elt = mail_elt (stream,nmsgs))->recent = T;
-			elt->private.uid = uid; elt->rfc822_size = size;
-			elt->private.spare.data = file;
-			elt->private.special.offset = pos;
-			elt->private.msg.header.offset = hpos;
-			elt->private.msg.header.text.size = hsiz;
-			elt->year = y; elt->month = m; elt->day = d;
-			elt->hours = hh; elt->minutes = mm;
-			elt->seconds = ss; elt->zoccident = z;
-			elt->zhours = zh; elt->zminutes = zm;
-				/* message in same file? */
-			if (curfile == file) {
-			  if (pos < curpos) {
-			    MESSAGECACHE *plt = mail_elt (stream,elt->msgno-1);
-				/* uh-oh, calculate delta? */
-			    i = curpos - pos;
-			    sprintf (tmp,shortmsg,plt->msgno,plt->private.uid,
-				     i,pos,curpos);
-				/* possible to fix? */
-			    if (!stream->rdonly && LOCAL->expok &&
-				(i < plt->rfc822_size)) {
-			      plt->rfc822_size -= i;
-			      if (plt->rfc822_size <
-				  plt->private.msg.header.text.size)
-				plt->private.msg.header.text.size =
-				  plt->rfc822_size;
-			      strcat (tmp,", repaired");
-			      indexrepairneeded = T;
-			    }
-			    MM_LOG (tmp,WARN);
-			  }
-			}
-			else {	/* new file, restart */
-			  if (stat (mix_file_data (LOCAL->buf,stream->mailbox,
-						   curfile = file),&sbuf)) {
-			    sprintf (tmp,"Missing mix data file: %.500s",
-				     LOCAL->buf);
-			    MM_LOG (tmp,ERROR);
-			    return NIL;
-			  }
-			  curfile = file;
-			  curfilesize = sbuf.st_size;
-			}
-
-				/* position of message in file */
-			curpos = pos + elt->private.msg.header.offset +
-			  elt->rfc822_size;
-				/* short file? */
-			if (curfilesize < curpos) {
-				/* uh-oh, calculate delta? */
-			    i = curpos - curfilesize;
-			    sprintf (tmp,shortmsg,elt->msgno,elt->private.uid,
-				     i,curfilesize,curpos);
-				/* possible to fix? */
-			    if (!stream->rdonly && LOCAL->expok &&
-				(i < elt->rfc822_size)) {
-			      elt->rfc822_size -= i;
-			      if (elt->rfc822_size <
-				  elt->private.msg.header.text.size)
-				elt->private.msg.header.text.size =
-				  elt->rfc822_size;
-			      strcat (tmp,", repaired");
-			      indexrepairneeded = T;
-			    }
-			    MM_LOG (tmp,WARN);
-			}
-		      }
-		      break;
-		    }
-		    else msg = "expansion";
-		  }
-		  else msg = "header size";
-		}
-		else msg = "header position";
-	      }
-	      else msg = "message position";
-	    }
-	    else msg = "file#";
-	  }
-	  sprintf (tmp,"Error in %s in mix index file: %.500s",msg,s);
-	  MM_LOG (tmp,ERROR);
-	  return NIL;
-	default:
-	  sprintf (tmp,"Unknown record in mix index file: %.500s",s);
-	  MM_LOG (tmp,ERROR);
-	  return NIL;
-	}
-      if (!s) return NIL;	/* barfage from mix_read_record() */
-				/* expunge trailing messages not in index */
-      if (LOCAL->expok) while (nmsgs < stream->nmsgs)
-	mail_expunged (stream,stream->nmsgs);
+				/* use binary index if it is current, else
+				 * make one if we can */
+      mix_binary_map (&map,LOCAL->bindex,*idxf,i,sizeof (MIXBINIDX));
+      j = mix_index_parse (stream,*idxf,&map,&metarepairneeded,
+			   &indexrepairneeded);
+      if (j && !map.base && iflags && LOCAL->expok && !indexrepairneeded)
+	mix_index_binary (stream,*idxf);
+      mix_binary_unmap (&map);
+      if (!j) return NIL;	/* give up */
     }
 
 				/* repair metadata and index if needed */
     if ((metarepairneeded ? mix_meta_update (stream) : T) &&
 	(indexrepairneeded ? mix_index_update (stream,*idxf,NIL) : T)) {
       MESSAGECACHE *elt;
+      MIXSTATREC rec;
+      MIXBINMAP map;
       int fd;
-      unsigned long uid,uf,sf,mod;
-      char *s;
+      long k;
       int updatep = NIL;
 				/* open status file */
       if ((fd = open (LOCAL->status,
@@ -2062,63 +2158,51 @@ FILE *mix_parse (MAILSTREAM *stream,FILE **idxf,long iflags,long sflags)
 				/* update sequence, get first elt */
 	if (i > LOCAL->statusseq) LOCAL->statusseq = i;
 	if (stream->nmsgs) {
+				/* use binary status if it is current */
+	  mix_binary_map (&map,LOCAL->bstatus,statf,i,sizeof (MIXBINSTAT));
 	  elt = mail_elt (stream,i = 1);
 
 				/* read message records */
-	  while ((t = s = mix_read_record (statf,LOCAL->buf,LOCAL->buflen,
-					   "status")) && *s && (*s++ == ':') &&
-		 isxdigit (*s)) {
-	    uid = strtoul (s,&s,16);
-	    if ((*s++ == ':') && isxdigit (*s)) {
-	      uf = strtoul (s,&s,16);
-	      if ((*s++ == ':') && isxdigit (*s)) {
-		sf = strtoul (s,&s,16);
-		if ((*s++ == ':') && isxdigit (*s)) {
-		  mod = strtoul (s,&s,16);
-				/* ignore expansion values */
-		  if (*s++ == ':') {
+	  while ((k = mix_status_record (stream,statf,&map,&rec)) > 0) {
 				/* need to move ahead to next elt? */
-		    while ((uid > elt->private.uid) && (i < stream->nmsgs))
-		      elt = mail_elt (stream,++i);
+	    while ((rec.uid > elt->private.uid) && (i < stream->nmsgs))
+	      elt = mail_elt (stream,++i);
+				/* note where its record is */
+	    if (rec.uid == elt->private.uid)
+	      elt->private.msg.full.offset = rec.pos;
 				/* update elt if altered */
-		    if ((uid == elt->private.uid) &&
-			(!elt->valid || (mod != elt->private.mod))) {
-		      elt->user_flags = uf;
-		      elt->private.mod = mod;
-		      elt->seen = (sf & fSEEN) ? T : NIL;
-		      elt->deleted = (sf & fDELETED) ? T : NIL;
-		      elt->flagged = (sf & fFLAGGED) ? T : NIL;
-		      elt->answered = (sf & fANSWERED) ? T : NIL;
-		      elt->draft = (sf & fDRAFT) ? T : NIL;
+	    if ((rec.uid == elt->private.uid) &&
+		(!elt->valid || (rec.mod != elt->private.mod))) {
+	      elt->user_flags = rec.user_flags;
+	      elt->private.mod = rec.mod;
+	      elt->seen = (rec.flags & fSEEN) ? T : NIL;
+	      elt->deleted = (rec.flags & fDELETED) ? T : NIL;
+	      elt->flagged = (rec.flags & fFLAGGED) ? T : NIL;
+	      elt->answered = (rec.flags & fANSWERED) ? T : NIL;
+	      elt->draft = (rec.flags & fDRAFT) ? T : NIL;
 				/* announce if altered existing message */
-		      if (elt->valid) MM_FLAGS (stream,elt->msgno);
+	      if (elt->valid) MM_FLAGS (stream,elt->msgno);
 				/* first time, is old message? */
-		      else if (sf & fOLD) {
+	      else if (rec.flags & fOLD) {
 				/* yes, clear recent and set valid */
-			elt->recent = NIL;
-			elt->valid = T;
-		      }
+		elt->recent = NIL;
+		elt->valid = T;
+	      }
 				/* recent, allowed to update its status? */
-		      else if (sflags) {
+	      else if (sflags) {
 				/* yes, set valid and check in status */
-			elt->valid = T;
-			elt->private.mod = mix_modseq (elt->private.mod);
-			updatep = T;
-		      }
-		      /* leave valid unset and recent if sflags not set */
-		    }
-		    continue;	/* everything looks good */
-		  }
-		}
+		elt->valid = T;
+		elt->private.mod = mix_modseq (elt->private.mod);
+		updatep = T;
 	      }
+	      /* leave valid unset and recent if sflags not set */
 	    }
-	    break;		/* error somewhere */
 	  }
-
-	  if (t && *t) {	/* non-null means bogus record */
+	  mix_binary_unmap (&map);
+	  if (k < 0) {		/* bogus record */
 	    char msg[MAILTMPLEN];
 	    sprintf (msg,"Error in mix status file message record%s: %.80s",
-		     stream->rdonly ? "" : ", fixing",t);
+		     stream->rdonly ? "" : ", fixing",(char *) LOCAL->buf);
 	    MM_LOG (msg,WARN);
 				/* update it if not readonly */
 	    if (!stream->rdonly) updatep = T;
@@ -2142,6 +2226,301 @@ FILE *mix_parse (MAILSTREAM *stream,FILE **idxf,long iflags,long sflags)
   return statf;
 }
 
+/* MIX parse index records
+ * Accepts: MAIL stream
+ *	    open index FILE, positioned after the sequence record
+ *	    binary index map
+ *	    pointer to metadata repair needed flag
+ *	    pointer to index repair needed flag
+ * Returns: T if success, NIL if error
+ */
+
+long mix_index_parse (MAILSTREAM *stream,FILE *idxf,MIXBINMAP *map,
+		      short *metarepairneeded,short *indexrepairneeded)
+{
+  long k;
+  unsigned long i,prevuid = 0;
+  unsigned long nmsgs,curfile,curfilesize,curpos;
+  char tmp[MAILTMPLEN];
+  struct stat sbuf;
+  MESSAGECACHE *elt;
+  MIXIDXREC rec;
+  short silent = stream->silent;
+				/* start with no messages */
+  curfile = curfilesize = curpos = nmsgs = 0;
+  while ((k = mix_index_record (stream,idxf,map,&rec)) > 0) {
+    if (rec.uid > stream->uid_last) {
+      sprintf (tmp,"mix index invalid UID (%08lx < %08lx)",
+	       rec.uid,stream->uid_last);
+      if (stream->rdonly) {
+	MM_LOG (tmp,ERROR);
+	return NIL;
+      }
+      strcat (tmp,", repaired");
+      MM_LOG (tmp,WARN);
+      stream->uid_last = rec.uid;
+      *metarepairneeded = T;
+    }
+    if (prevuid > rec.uid) {
+      sprintf (tmp,"mix index backwards UID: %lx",rec.uid);
+      MM_LOG (tmp,ERROR);
+      return NIL;
+    }
+    prevuid = rec.uid;
+    ++nmsgs;			/* this is another mesage */
+				/* within current known range of messages? */
+    while (nmsgs <= stream->nmsgs) {
+				/* yes, get corresponding elt */
+      elt = mail_elt (stream,nmsgs);
+				/* existing message with matching data? */
+      if (rec.uid == elt->private.uid) {
+				/* beware of Dracula's resurrection */
+	if (elt->private.ghost) {
+	  sprintf (tmp,"mix index data unexpunged UID: %lx",rec.uid);
+	  MM_LOG (tmp,ERROR);
+	  return NIL;
+	}
+				/* also of static data changing */
+	if ((rec.size != elt->rfc822_size) ||
+	    (rec.file != elt->private.spare.data) ||
+	    (rec.pos != elt->private.special.offset) ||
+	    (rec.hpos != elt->private.msg.header.offset) ||
+	    (rec.hsiz != elt->private.msg.header.text.size) ||
+	    (rec.y != elt->year) || (rec.m != elt->month) ||
+	    (rec.d != elt->day) || (rec.hh != elt->hours) ||
+	    (rec.mm != elt->minutes) || (rec.ss != elt->seconds) ||
+	    (rec.z != elt->zoccident) || (rec.zh != elt->zhours) ||
+	    (rec.zm != elt->zminutes)) {
+	  sprintf (tmp,"mix index data mismatch: %lx",rec.uid);
+	  MM_LOG (tmp,ERROR);
+	  return NIL;
+	}
+	break;
+      }
+				/* existing msg with lower UID is expunged */
+      else if (rec.uid > elt->private.uid) {
+	if (LOCAL->expok) mail_expunged (stream,nmsgs);
+	else {			/* message expunged, but not yet for us */
+	  ++nmsgs;
+	  elt->private.ghost = T;
+	}
+      }
+      else {			/* unexpected message record */
+	sprintf (tmp,"mix index UID mismatch (%lx < %lx)",
+		 rec.uid,elt->private.uid);
+	MM_LOG (tmp,ERROR);
+	return NIL;
+      }
+    }
+
+				/* time to create a new message? */
+    if (nmsgs > stream->nmsgs) {
+				/* defer announcing until later */
+      stream->silent = T;
+      mail_exists (stream,nmsgs);
+      stream->silent = silent;
+      (elt = mail_elt (stream,nmsgs))->recent = T;
+      elt->private.uid = rec.uid; elt->rfc822_size = rec.size;
+      elt->private.spare.data = rec.file;
+      elt->private.special.offset = rec.pos;
+      elt->private.msg.header.offset = rec.hpos;
+      elt->private.msg.header.text.size = rec.hsiz;
+      elt->year = rec.y; elt->month = rec.m; elt->day = rec.d;
+      elt->hours = rec.hh; elt->minutes = rec.mm;
+      elt->seconds = rec.ss; elt->zoccident = rec.z;
+      elt->zhours = rec.zh; elt->zminutes = rec.zm;
+				/* message in same file? */
+      if (curfile == rec.file) {
+	if (rec.pos < curpos) {
+	  MESSAGECACHE *plt = mail_elt (stream,elt->msgno-1);
+				/* uh-oh, calculate delta? */
+	  i = curpos - rec.pos;
+	  sprintf (tmp,shortmsg,plt->msgno,plt->private.uid,i,rec.pos,curpos);
+				/* possible to fix? */
+	  if (!stream->rdonly && LOCAL->expok && (i < plt->rfc822_size)) {
+	    plt->rfc822_size -= i;
+	    if (plt->rfc822_size < plt->private.msg.header.text.size)
+	      plt->private.msg.header.text.size = plt->rfc822_size;
+	    strcat (tmp,", repaired");
+	    *indexrepairneeded = T;
+	  }
+	  MM_LOG (tmp,WARN);
+	}
+      }
+      else {			/* new file, restart */
+	if (stat (mix_file_data (LOCAL->buf,stream->mailbox,
+				 curfile = rec.file),&sbuf)) {
+	  sprintf (tmp,"Missing mix data file: %.500s",LOCAL->buf);
+	  MM_LOG (tmp,ERROR);
+	  return NIL;
+	}
+	curfile = rec.file;
+	curfilesize = sbuf.st_size;
+      }
+
+				/* position of message in file */
+      curpos = rec.pos + elt->private.msg.header.offset + elt->rfc822_size;
+				/* short file? */
+      if (curfilesize < curpos) {
+				/* uh-oh, calculate delta? */
+	i = curpos - curfilesize;
+	sprintf (tmp,shortmsg,elt->msgno,elt->private.uid,i,curfilesize,
+		 curpos);
+				/* possible to fix? */
+	if (!stream->rdonly && LOCAL->expok && (i < elt->rfc822_size)) {
+	  elt->rfc822_size -= i;
+	  if (elt->rfc822_size < elt->private.msg.header.text.size)
+	    elt->private.msg.header.text.size = elt->rfc822_size;
+	  strcat (tmp,", repaired");
+	  *indexrepairneeded = T;
+	}
+	MM_LOG (tmp,WARN);
+      }
+    }
+  }
+  if (k < 0) return NIL;	/* barfage from mix_index_record() */
+				/* expunge trailing messages not in index */
+  if (LOCAL->expok) while (nmsgs < stream->nmsgs)
+    mail_expunged (stream,stream->nmsgs);
+  return LONGT;
+}
+
+/* MIX read index record
+ * Accepts: MAIL stream
+ *	    open index FILE
+ *	    binary index map
+ *	    pointer to returned record
+ * Returns: 1 if record returned, 0 if end of index, -1 if error
+ */
+
+long mix_index_record (MAILSTREAM *stream,FILE *idxf,MIXBINMAP *map,
+		       MIXIDXREC *rec)
+{
+  char *s,*t,*msg,tmp[MAILTMPLEN];
+  if (map->base) {		/* binary index? */
+    MIXBINIDX *bin;
+    if (map->cur >= map->nrecs) return 0;
+    bin = ((MIXBINIDX *) (map->base + sizeof (MIXBINHDR))) + map->cur++;
+    if (!(rec->uid = bin->uid)) {
+      MM_LOG ("Error in UID in mix binary index file",ERROR);
+      return -1;
+    }
+    rec->size = bin->size;
+    rec->file = bin->file;
+    rec->pos = bin->pos;
+    rec->hpos = bin->hpos;
+    rec->hsiz = bin->hsiz;
+    rec->d = bin->date & 0x1f;
+    rec->m = (bin->date >> 5) & 0xf;
+    rec->y = (bin->date >> 9) & 0x7f;
+    rec->hh = bin->time & 0x1f;
+    rec->mm = (bin->time >> 5) & 0x3f;
+    rec->ss = (bin->time >> 11) & 0x3f;
+    rec->z = (bin->time >> 17) & 0x1;
+    rec->zh = (bin->time >> 18) & 0xf;
+    rec->zm = (bin->time >> 22) & 0x3f;
+    return 1;
+  }
+  if (!(s = mix_read_record (idxf,LOCAL->buf,LOCAL->buflen,"index")))
+    return -1;			/* barfage from mix_read_record() */
+  if (!*s) return 0;		/* end of index */
+  if (*s != ':') {		/* must be a message record */
+    sprintf (tmp,"Unknown record in mix index file: %.500s",s);
+    MM_LOG (tmp,ERROR);
+    return -1;
+  }
+  if (!(isxdigit (*++s) && (rec->uid = strtoul (s,&t,16)))) msg = "UID";
+  else if (!((*t++ == ':') && isdigit (*t) && isdigit (t[1]) &&
+	     isdigit (t[2]) && isdigit (t[3]) && isdigit (t[4]) &&
+	     isdigit (t[5]) && isdigit (t[6]) && isdigit (t[7]) &&
+	     isdigit (t[8]) && isdigit (t[9]) && isdigit (t[10]) &&
+	     isdigit (t[11]) && isdigit (t[12]) && isdigit (t[13]) &&
+	     ((t[14] == '+') || (t[14] == '-')) && 
+	     isdigit (t[15]) && isdigit (t[16]) && isdigit (t[17]) &&
+	     isdigit (t[18]))) msg = "internaldate";
+  else if ((*(s = t+19) != ':') || !isxdigit (*++s)) msg = "size";
+  else {
+    rec->y = (((*t - '0') * 1000) + ((t[1] - '0') * 100) +
+	      ((t[2] - '0') * 10) + t[3] - '0') - BASEYEAR;
+    rec->m = ((t[4] - '0') * 10) + t[5] - '0';
+    rec->d = ((t[6] - '0') * 10) + t[7] - '0';
+    rec->hh = ((t[8] - '0') * 10) + t[9] - '0';
+    rec->mm = ((t[10] - '0') * 10) + t[11] - '0';
+    rec->ss = ((t[12] - '0') * 10) + t[13] - '0';
+    rec->z = (t[14] == '-') ? 1 : 0;
+    rec->zh = ((t[15] - '0') * 10) + t[16] - '0';
+    rec->zm = ((t[17] - '0') * 10) + t[18] - '0';
+    rec->size = strtoul (s,&s,16);
+    if ((*s++ == ':') && isxdigit (*s)) {
+      rec->file = strtoul (s,&s,16);
+      if ((*s++ == ':') && isxdigit (*s)) {
+	rec->pos = strtoul (s,&s,16);
+	if ((*s++ == ':') && isxdigit (*s)) {
+	  rec->hpos = strtoul (s,&s,16);
+	  if ((*s++ == ':') && isxdigit (*s)) {
+	    rec->hsiz = strtoul (s,&s,16);
+				/* ignore expansion values */
+	    if (*s++ == ':') return 1;
+	    msg = "expansion";
+	  }
+	  else msg = "header size";
+	}
+	else msg = "header position";
+      }
+      else msg = "message position";
+    }
+    else msg = "file#";
+  }
+  sprintf (tmp,"Error in %s in mix index file: %.500s",msg,s);
+  MM_LOG (tmp,ERROR);
+  return -1;
+}
+
+/* MIX read status record
+ * Accepts: MAIL stream
+ *	    open status FILE
+ *	    binary status map
+ *	    pointer to returned record
+ * Returns: 1 if record returned, 0 if end of status, -1 if bogus record
+ *
+ * A bogus record is left in the stream's buffer for the caller to report.
+ */
+
+long mix_status_record (MAILSTREAM *stream,FILE *statf,MIXBINMAP *map,
+			MIXSTATREC *rec)
+{
+  char *s;
+  if (map->base) {		/* binary status? */
+    MIXBINSTAT *bin;
+    if (map->cur >= map->nrecs) return 0;
+    bin = ((MIXBINSTAT *) (map->base + sizeof (MIXBINHDR))) + map->cur++;
+    rec->uid = bin->uid;
+    rec->user_flags = bin->user_flags;
+    rec->flags = bin->flags;
+    rec->mod = bin->mod;
+    rec->pos = bin->pos;
+    return 1;
+  }
+  if (((rec->pos = ftell (statf)) < 0) ||
+      !(s = mix_read_record (statf,LOCAL->buf,LOCAL->buflen,"status")) ||
+      !*s) return 0;
+  if ((*s++ == ':') && isxdigit (*s)) {
+    rec->uid = strtoul (s,&s,16);
+    if ((*s++ == ':') && isxdigit (*s)) {
+      rec->user_flags = strtoul (s,&s,16);
+      if ((*s++ == ':') && isxdigit (*s)) {
+	rec->flags = strtoul (s,&s,16);
+	if ((*s++ == ':') && isxdigit (*s)) {
+	  rec->mod = strtoul (s,&s,16);
+				/* ignore expansion values */
+	  if (*s++ == ':') return 1;
+	}
+      }
+    }
+  }
+  return -1;			/* error somewhere */
+}
+
 /* MIX metadata file routines */
 
 /* MIX read metadata
@@ -2301,7 +2680,11 @@ long mix_index_update (MAILSTREAM *stream,FILE *idxf,long flag)
 	MM_LOG ("Error flushing mix index file",ERROR);
 	ret = NIL;
       }
-      if (ret) ftruncate (fileno (idxf),ftell (idxf));
+      if (ret) {		/* binary index goes with it */
+	ftruncate (fileno (idxf),ftell (idxf));
+	mix_index_binary (stream,idxf);
+      }
+      else unlink (LOCAL->bindex);
     }
   }
   return ret;
@@ -2357,6 +2740,9 @@ long mix_status_update (MAILSTREAM *stream,FILE *statf,long flag)
       }
     }
 
+				/* just rewrite changed records if possible */
+    if (ret && !flag && !LOCAL->statusfull &&
+	mix_status_inplace (stream,statf)) return ret;
     if (ret) {			/* if still good to go */
       rewind (statf);		/* let's start at the very beginning */
 				/* write sequence */
@@ -2366,12 +2752,15 @@ long mix_status_update (MAILSTREAM *stream,FILE *statf,long flag)
 	MESSAGECACHE *elt = mail_elt (stream,i);
 				/* make sure all messages have a modseq */
 	if (!elt->private.mod) elt->private.mod = LOCAL->statusseq;
-	if (!elt->private.ghost)/* only write living messages */
+	if (elt->private.ghost) elt->private.msg.full.offset = 0;
+	else {			/* only write living messages */
+	  elt->private.msg.full.offset = ftell (statf);
 	  fprintf (statf,STRFMT,elt->private.uid,elt->user_flags,
 		   (fSEEN * elt->seen) + (fDELETED * elt->deleted) +
 		   (fFLAGGED * elt->flagged) + (fANSWERED * elt->answered) +
 		   (fDRAFT * elt->draft) + (elt->valid ? fOLD : NIL),
 		   elt->private.mod);
+	}
 	if (ferror (statf)) {
 	  sprintf (tmp,"Error updating mix status file: %.80s",
 		   strerror (errno));
@@ -2383,11 +2772,310 @@ long mix_status_update (MAILSTREAM *stream,FILE *statf,long flag)
 	MM_LOG ("Error flushing mix status file",ERROR);
 	ret = NIL;
       }
-      if (ret) ftruncate (fileno (statf),ftell (statf));
+      if (ret) {		/* binary status goes with it */
+	ftruncate (fileno (statf),ftell (statf));
+	mix_status_binary (stream,statf);
+	LOCAL->statusfull = NIL;/* status file is now exact */
+      }
+      else unlink (LOCAL->bstatus);
     }
   }
   return ret;
 }
+
+/* MIX update status records in place
+ * Accepts: MAIL stream
+ *	    pointer to open FILE
+ * Returns: T on success, NIL if the whole file must be rewritten
+ *
+ * Only the records of messages changed at the current status sequence are
+ * written, each over its old record.  Every record is fixed width, but
+ * another session may have rewritten the file since we last saw it, so each
+ * old record is checked to be the same size and for the same UID first.
+ */
+
+long mix_status_inplace (MAILSTREAM *stream,FILE *statf)
+{
+  unsigned long i,j,n;
+  size_t len;
+  char tmp[MAILTMPLEN],old[MAILTMPLEN];
+  MESSAGECACHE *elt;
+  int fd = fileno (statf);
+				/* count changed records, must know them all */
+  for (i = 1, j = n = 0; i <= stream->nmsgs; ++i)
+    if (!(elt = mail_elt (stream,i))->private.ghost) {
+      ++n;			/* count living messages */
+				/* make sure all messages have a modseq */
+      if (!elt->private.mod) elt->private.mod = LOCAL->statusseq;
+      if (elt->private.mod == LOCAL->statusseq) {
+	if (!elt->private.msg.full.offset) return NIL;
+	++j;
+      }
+    }
+				/* big changes are cheaper written in full */
+  if ((j > STATUSINPLACE) && (j > (n / STATUSINPLACE))) return NIL;
+  for (i = 1; j && (i <= stream->nmsgs); ++i)
+    if (!(elt = mail_elt (stream,i))->private.ghost &&
+	(elt->private.mod == LOCAL->statusseq)) {
+      --j;			/* one less record to do */
+      sprintf (tmp,STRFMT,elt->private.uid,elt->user_flags,
+	       (fSEEN * elt->seen) + (fDELETED * elt->deleted) +
+	       (fFLAGGED * elt->flagged) + (fANSWERED * elt->answered) +
+	       (fDRAFT * elt->draft) + (elt->valid ? fOLD : NIL),
+	       elt->private.mod);
+      len = strlen (tmp);	/* old record must be this UID and size */
+      if ((pread (fd,old,len,elt->private.msg.full.offset) != len) ||
+	  strncmp (old,tmp,strchr (tmp + 1,':') - tmp) ||
+	  (memchr (old,'\012',len) != old + len - 1) ||
+	  (pwrite (fd,tmp,len,elt->private.msg.full.offset) != len))
+	return NIL;
+    }
+				/* sequence record goes last */
+  sprintf (tmp,SEQFMT,LOCAL->statusseq);
+  len = strlen (tmp);
+  if ((pread (fd,old,len,0) != len) || (old[0] != 'S') ||
+      (memchr (old,'\012',len) != old + len - 1) ||
+      (pwrite (fd,tmp,len,0) != len)) return NIL;
+				/* then binary status if it was current */
+  mix_status_binary_inplace (stream,statf,strtoul (old + 1,NIL,16));
+  return LONGT;
+}
+
+/* MIX binary file routines */
+
+
+/* MIX map binary file
+ * Accepts: map to set up
+ *	    binary file name
+ *	    open text FILE it goes with
+ *	    sequence of text file
+ *	    size of a record
+ * Returns: T if mapped, NIL if binary file absent or not current
+ *
+ * Must be called with the text file locked, and unmapped before unlocking.
+ */
+
+long mix_binary_map (MIXBINMAP *map,char *name,FILE *f,unsigned long seq,
+		     size_t recsize)
+{
+  int fd;
+  struct stat sbuf,tbuf;
+  MIXBINHDR *hdr;
+  memset (map,0,sizeof (MIXBINMAP));
+  if ((fd = open (name,O_RDONLY,NIL)) >= 0) {
+    if (!fstat (fd,&sbuf) && !fstat (fileno (f),&tbuf) &&
+	((map->size = sbuf.st_size) >= sizeof (MIXBINHDR)) &&
+	((map->base = (char *) mmap (NIL,map->size,PROT_READ,MAP_SHARED,fd,
+				     0)) != (char *) MAP_FAILED)) {
+      hdr = (MIXBINHDR *) map->base;
+      if (!memcmp (hdr->magic,MIXBINMAGIC,8) &&
+	  (hdr->order == MIXBINORDER) && (hdr->recsize == recsize) &&
+	  ((unsigned long) hdr->seq == seq) &&
+	  (hdr->textsize == (unsigned int) tbuf.st_size) &&
+	  (hdr->texttime == (unsigned int) tbuf.st_mtime) &&
+	  (map->size == (sizeof (MIXBINHDR) + hdr->nrecs * recsize)))
+	map->nrecs = hdr->nrecs;
+      else mix_binary_unmap (map);
+    }
+    else map->base = NIL;
+    close (fd);			/* mapping outlives descriptor */
+  }
+  return map->base ? LONGT : NIL;
+}
+
+
+/* MIX unmap binary file
+ * Accepts: map
+ */
+
+void mix_binary_unmap (MIXBINMAP *map)
+{
+  if (map->base) munmap (map->base,map->size);
+  map->base = NIL;
+}
+
+/* MIX write binary file
+ * Accepts: binary file name
+ *	    open text FILE it goes with, just rewritten
+ *	    sequence of text file
+ *	    size of a record
+ *	    records
+ *	    number of records
+ *
+ * Must be called with the text file locked exclusive.  The header is written
+ * last so a partially written file is never used, and the file is removed
+ * if it can't be written.
+ */
+
+void mix_binary_write (char *name,FILE *f,unsigned long seq,size_t recsize,
+		       void *recs,unsigned long nrecs)
+{
+  int fd;
+  size_t size = nrecs * recsize;
+  struct stat tbuf;
+  MIXBINHDR hdr;
+  memset (&hdr,0,sizeof (MIXBINHDR));
+  if (!fstat (fileno (f),&tbuf) &&
+      ((fd = open (name,O_WRONLY|O_CREAT|O_TRUNC,
+		   (int) tbuf.st_mode & 0777)) >= 0)) {
+    memcpy (hdr.magic,MIXBINMAGIC,8);
+    hdr.order = MIXBINORDER;
+    hdr.recsize = recsize;
+    hdr.nrecs = nrecs;
+    hdr.textsize = tbuf.st_size;
+    hdr.texttime = tbuf.st_mtime;
+    if ((pwrite (fd,recs,size,sizeof (MIXBINHDR)) == size) &&
+	((unsigned long) (hdr.seq = seq) == seq) &&
+	(pwrite (fd,&hdr,sizeof (MIXBINHDR),0) == sizeof (MIXBINHDR))) {
+      close (fd);
+      return;
+    }
+    close (fd);
+  }
+  unlink (name);		/* don't leave anything stale behind */
+}
+
+/* MIX write binary index
+ * Accepts: MAIL stream
+ *	    open index FILE, just rewritten
+ */
+
+void mix_index_binary (MAILSTREAM *stream,FILE *idxf)
+{
+  unsigned long i,n;
+  MESSAGECACHE *elt;
+  MIXBINIDX *recs,*rec;
+  for (i = 1, n = 0; i <= stream->nmsgs; ++i)
+    if (!mail_elt (stream,i)->private.ghost) ++n;
+  rec = recs = (MIXBINIDX *) fs_get ((n ? n : 1) * sizeof (MIXBINIDX));
+  for (i = 1; i <= stream->nmsgs; ++i)
+    if (!(elt = mail_elt (stream,i))->private.ghost) {
+      rec->uid = elt->private.uid;
+      rec->size = elt->rfc822_size;
+      rec->file = elt->private.spare.data;
+      rec->pos = elt->private.special.offset;
+      rec->hpos = elt->private.msg.header.offset;
+      rec->hsiz = elt->private.msg.header.text.size;
+      rec->date = elt->day | (elt->month << 5) | (elt->year << 9);
+      rec->time = elt->hours | (elt->minutes << 5) | (elt->seconds << 11) |
+	(elt->zoccident << 17) | (elt->zhours << 18) | (elt->zminutes << 22);
+				/* text format allows wider values */
+      if ((rec->uid != elt->private.uid) ||
+	  (rec->size != elt->rfc822_size) ||
+	  (rec->file != elt->private.spare.data) ||
+	  (rec->pos != elt->private.special.offset) ||
+	  (rec->hpos != elt->private.msg.header.offset) ||
+	  (rec->hsiz != elt->private.msg.header.text.size)) break;
+      ++rec;
+    }
+  if ((rec - recs) == n)
+    mix_binary_write (LOCAL->bindex,idxf,LOCAL->indexseq,sizeof (MIXBINIDX),
+		      (void *) recs,n);
+  else unlink (LOCAL->bindex);
+  fs_give ((void **) &recs);
+}
+
+/* MIX write binary status
+ * Accepts: MAIL stream
+ *	    open status FILE, just rewritten
+ */
+
+void mix_status_binary (MAILSTREAM *stream,FILE *statf)
+{
+  unsigned long i,n;
+  MESSAGECACHE *elt;
+  MIXBINSTAT *recs,*rec;
+  for (i = 1, n = 0; i <= stream->nmsgs; ++i)
+    if (!mail_elt (stream,i)->private.ghost) ++n;
+  rec = recs = (MIXBINSTAT *) fs_get ((n ? n : 1) * sizeof (MIXBINSTAT));
+  for (i = 1; i <= stream->nmsgs; ++i)
+    if (!(elt = mail_elt (stream,i))->private.ghost) {
+      if (!mix_status_binary_record (elt,rec)) break;
+      ++rec;
+    }
+  if ((rec - recs) == n)
+    mix_binary_write (LOCAL->bstatus,statf,LOCAL->statusseq,
+		      sizeof (MIXBINSTAT),(void *) recs,n);
+  else unlink (LOCAL->bstatus);
+  fs_give ((void **) &recs);
+}
+
+/* MIX update binary status records in place
+ * Accepts: MAIL stream
+ *	    open status FILE, just updated in place
+ *	    sequence of status file before the update
+ *
+ * Follows mix_status_inplace(), rewriting the same records.  The binary file
+ * is written in full if it did not match the status file before the update.
+ */
+
+void mix_status_binary_inplace (MAILSTREAM *stream,FILE *statf,
+				unsigned long oldseq)
+{
+  int fd;
+  unsigned long i,k;
+  off_t pos;
+  long ret = NIL;
+  struct stat tbuf;
+  MIXBINHDR hdr;
+  MIXBINSTAT rec;
+  MESSAGECACHE *elt;
+  if ((fd = open (LOCAL->bstatus,O_RDWR,NIL)) >= 0) {
+    if ((pread (fd,&hdr,sizeof (MIXBINHDR),0) == sizeof (MIXBINHDR)) &&
+	!memcmp (hdr.magic,MIXBINMAGIC,8) && (hdr.order == MIXBINORDER) &&
+	(hdr.recsize == sizeof (MIXBINSTAT)) &&
+	((unsigned long) hdr.seq == oldseq)) {
+      for (i = 1, k = 0, ret = LONGT; ret && (i <= stream->nmsgs); ++i)
+	if (!(elt = mail_elt (stream,i))->private.ghost) {
+	  if (elt->private.mod == LOCAL->statusseq) {
+	    pos = sizeof (MIXBINHDR) + k * sizeof (MIXBINSTAT);
+				/* old record must be for this UID */
+	    if ((k >= hdr.nrecs) ||
+		(pread (fd,&rec,sizeof (MIXBINSTAT),pos) !=
+		 sizeof (MIXBINSTAT)) || (rec.uid != elt->private.uid) ||
+		!mix_status_binary_record (elt,&rec) ||
+		(pwrite (fd,&rec,sizeof (MIXBINSTAT),pos) !=
+		 sizeof (MIXBINSTAT)))
+	      ret = NIL;
+	  }
+	  ++k;			/* count living messages */
+	}
+				/* header goes last */
+      if (ret && (k == hdr.nrecs) && !fstat (fileno (statf),&tbuf) &&
+	  ((unsigned long) (hdr.seq = LOCAL->statusseq) == LOCAL->statusseq)) {
+	hdr.textsize = tbuf.st_size;
+	hdr.texttime = tbuf.st_mtime;
+	ret = (pwrite (fd,&hdr,sizeof (MIXBINHDR),0) == sizeof (MIXBINHDR));
+      }
+      else ret = NIL;
+    }
+    close (fd);
+  }
+  if (!ret) mix_status_binary (stream,statf);
+}
+
+
+/* MIX make binary status record
+ * Accepts: message cache element
+ *	    record to fill in
+ * Returns: T if success, NIL if values don't fit
+ */
+
+long mix_status_binary_record (MESSAGECACHE *elt,MIXBINSTAT *rec)
+{
+  rec->uid = elt->private.uid;
+  rec->user_flags = elt->user_flags;
+  rec->flags = (fSEEN * elt->seen) + (fDELETED * elt->deleted) +
+    (fFLAGGED * elt->flagged) + (fANSWERED * elt->answered) +
+    (fDRAFT * elt->draft) + (elt->valid ? fOLD : NIL);
+  rec->mod = elt->private.mod;
+  rec->pos = elt->private.msg.full.offset;
+  rec->spare = 0;
+  return ((rec->uid == elt->private.uid) &&
+	  (rec->user_flags == elt->user_flags) &&
+	  (rec->mod == elt->private.mod) &&
+	  (rec->pos == elt->private.msg.full.offset)) ? LONGT : NIL;
+}
 
 /* MIX data file routines */
 
@@ -2737,6 +3425,343 @@ long mix_sortcache_update (MAILSTREAM *stream,FILE **sortcache)
   return ret;
 }
 
+/* MIX text index routines */
+
+
+/* MIX text index search
+ * Accepts: MAIL stream
+ *	    search program
+ * Returns: vector indexed by message number which is non-zero for messages
+ *	    which may satisfy the search program, or NIL if no narrowing
+ *
+ * Each text index record holds a signature of one message: a bitmap of the
+ * hashed byte trigrams of the canonicalized texts which a TEXT search key
+ * examines, folded to a size proportionate to the number of trigrams.  A
+ * message can not satisfy a top-level BODY or TEXT search key unless its
+ * signature has the bits of each of the trigrams in the key.
+ */
+
+char *mix_text_search (MAILSTREAM *stream,SEARCHPGM *pgm)
+{
+  int fd;
+  unsigned long i,uid,len,rpos,wpos,nkeys;
+  unsigned int keys[TXTMAXKEYS];
+  char *s,*t,*done,*msg,tmp[MAILTMPLEN];
+  struct stat sbuf;
+  int rdonly = NIL;
+  long dirty = NIL;
+  char *ret = NIL;
+  FILE *txtf = NIL;
+				/* only top-level keys are always AND'd */
+  nkeys = mix_text_keys (pgm->body,keys,mix_text_keys (pgm->text,keys,0));
+  fstat (LOCAL->mfd,&sbuf);
+  if (!(nkeys && stream->nmsgs));/* do nothing if no keys or mailbox empty */
+				/* open text index file */
+  else if (((fd = open (LOCAL->text,O_RDWR|O_CREAT,sbuf.st_mode)) < 0) &&
+	   !(rdonly = ((fd = open (LOCAL->text,O_RDONLY,NIL)) >= 0)))
+    MM_LOG ("Error opening mix text index file",WARN);
+				/* acquire lock and FILE */
+  else if (flock (fd,rdonly ? LOCK_SH : LOCK_EX) ||
+	   !(txtf = fdopen (fd,rdonly ? "rb" : "r+b"))) {
+    MM_LOG ("Error obtaining stream on mix text index file",WARN);
+    flock (fd,LOCK_UN);		/* relinquish lock */
+    close (fd);
+  }
+  else {
+    if (!rdonly) fchmod (fd,sbuf.st_mode);
+				/* make sure a record fits in buffer */
+    if (LOCAL->buflen < (TXTBITS/4 + MAILTMPLEN)) {
+      fs_give ((void **) &LOCAL->buf);
+      LOCAL->buf = (char *) fs_get ((LOCAL->buflen = TXTBITS/4 + MAILTMPLEN)
+				    + 1);
+    }
+    ret = (char *) memset (fs_get (stream->nmsgs + 1),0,stream->nmsgs + 1);
+    done = (char *) memset (fs_get (stream->nmsgs + 1),0,stream->nmsgs + 1);
+    if (!(LOCAL->textseq = mix_read_sequence (txtf))) {
+      MM_LOG ("Error in mix text index file sequence record",WARN);
+      t = NIL;			/* rebuild the index */
+    }
+    else for (wpos = ftell (txtf);
+	      (s = t = mix_read_record (txtf,LOCAL->buf,LOCAL->buflen,
+					"text index")) && *s;) {
+      msg = "record";
+      if ((*s++ != ':') || !isxdigit (*s) || !(uid = strtoul (s,&s,16)) ||
+	  (*s++ != ':') || !isxdigit (*s) ||
+	  ((len = strtoul (s,&s,16)) < TXTMINBITS/4) || (len > TXTBITS/4) ||
+	  (len & (len - 1)) || (*s++ != ':') || (strlen (s) != len)) break;
+      if ((i = mail_msgno (stream,uid)) && done[i]) {
+	msg = "duplicate UID";
+	break;
+      }
+				/* keep records of messages not seen yet */
+      else if (i || (uid > stream->uid_last)) {
+	if (i) ret[i] = mix_text_match (s,len,keys,nkeys) ? (done[i] = T) :
+	  !(done[i] = T);
+	if (rdonly);		/* can't update if readonly */
+	else if (dirty) {	/* slide record down over dropped records */
+	  rpos = ftell (txtf);
+	  fseek (txtf,wpos,SEEK_SET);
+	  fprintf (txtf,"%s\015\012",t);
+	  wpos = ftell (txtf);
+	  fseek (txtf,rpos,SEEK_SET);
+	}
+	else wpos = ftell (txtf);
+      }
+      else dirty = T;		/* drop record of expunged message */
+    }
+    if (!t || *t) {		/* error detected? */
+      if (t) {			/* non-null means bogus record */
+	sprintf (tmp,"Error in %s in mix text index: %.500s",msg,t);
+	MM_LOG (tmp,WARN);
+      }
+      if (rdonly) {		/* can't rebuild if readonly */
+	fs_give ((void **) &ret);
+	fclose (txtf);
+	txtf = NIL;
+      }
+      else {			/* start over, forget anything read */
+	memset (done,0,stream->nmsgs + 1);
+	wpos = 0;
+      }
+    }
+    if (txtf) {			/* have a usable index? */
+      if (!(rdonly || wpos)) {	/* new index, write placeholder sequence */
+	rewind (txtf);
+	fprintf (txtf,SEQFMT,LOCAL->textseq);
+	wpos = ftell (txtf);
+	dirty = T;
+      }
+				/* add signatures of new messages */
+      for (i = 1; i <= stream->nmsgs; ++i) if (!done[i]) {
+	if (rdonly || !(s = mix_text_signature (stream,i,&len))) ret[i] = T;
+	else {
+	  ret[i] = mix_text_match (s,len,keys,nkeys) ? T : NIL;
+	  fseek (txtf,wpos,SEEK_SET);
+	  fprintf (txtf,TXRFMT,mail_uid (stream,i),len,s);
+	  wpos = ftell (txtf);
+	  fs_give ((void **) &s);
+	  dirty = T;
+	}
+      }
+      if (dirty) {		/* rewrite sequence and truncate */
+	rewind (txtf);
+	fprintf (txtf,SEQFMT,LOCAL->textseq = mix_modseq (LOCAL->textseq));
+	if (fflush (txtf)) MM_LOG ("Error updating mix text index file",WARN);
+	else ftruncate (fileno (txtf),wpos);
+      }
+      if (fclose (txtf)) MM_LOG ("Error closing mix text index file",WARN);
+    }
+    fs_give ((void **) &done);
+  }
+  return ret;
+}
+
+/* MIX text index get search key trigrams
+ * Accepts: search string list
+ *	    trigram hash vector
+ *	    number of trigram hashes already in vector
+ * Returns: new number of trigram hashes in vector
+ */
+
+unsigned long mix_text_keys (STRINGLIST *sl,unsigned int *keys,
+			     unsigned long nkeys)
+{
+  unsigned long i,j;
+  unsigned int k;
+  for (; sl; sl = sl->next) for (i = 0; (i + 3) <= sl->text.size; ++i) {
+    k = TXTHASH (sl->text.data + i);
+    for (j = 0; (j < nkeys) && (keys[j] != k); ++j);
+    if (j < nkeys);		/* ignore if already have this trigram */
+    else if (nkeys < TXTMAXKEYS) keys[nkeys++] = k;
+    else return nkeys;		/* enough is enough */
+  }
+  return nkeys;
+}
+
+
+/* MIX text index test signature
+ * Accepts: signature hex digits
+ *	    number of hex digits
+ *	    trigram hash vector
+ *	    number of trigram hashes in vector
+ * Returns: T if signature has all the trigrams, else NIL
+ */
+
+long mix_text_match (char *sig,unsigned long len,unsigned int *keys,
+		     unsigned long nkeys)
+{
+  unsigned long i,j;
+  int c;
+  for (i = 0; i < nkeys; ++i) {
+    j = keys[i] & ((len << 2) - 1);
+    if (isdigit (c = sig[j >> 2])) c -= '0';
+    else if (isxdigit (c)) c = (c & 0xf) + 9;
+    else continue;		/* bogus digit, assume bit set */
+    if (!(c & (1 << (j & 3)))) return NIL;
+  }
+  return LONGT;
+}
+
+/* MIX text index make signature
+ * Accepts: MAIL stream
+ *	    message number
+ *	    pointer to return number of hex digits
+ * Returns: signature hex digits, or NIL if failure
+ */
+
+char *mix_text_signature (MAILSTREAM *stream,unsigned long msgno,
+			  unsigned long *len)
+{
+  unsigned long i,j,n,bits;
+  static char *hex = "0123456789abcdef";
+  char *ret;
+  BODY *body;
+  SIZEDTEXT s,t;
+  unsigned char *map = (unsigned char *)
+    memset (fs_get (TXTBITS/8),0,TXTBITS/8);
+				/* hash message header */
+  if (!(s.data = (unsigned char *)
+	mail_fetch_header (stream,msgno,NIL,NIL,&s.size,
+			   FT_INTERNAL | FT_PEEK))) {
+    fs_give ((void **) &map);
+    return NIL;
+  }
+  utf8_mime2text (&s,&t,U8T_CANONICAL);
+  mix_text_hash (&t,map);
+  if (t.data != s.data) fs_give ((void **) &t.data);
+				/* and message body */
+  mail_fetchstructure (stream,msgno,&body);
+  if (body) mix_text_body (stream,msgno,body,NIL,1,map);
+				/* count trigrams */
+  for (i = n = 0; i < TXTBITS/8; ++i) for (j = map[i]; j; j &= j - 1) ++n;
+				/* size for about half the bits set */
+  for (bits = TXTMINBITS; (bits < TXTBITS) && (bits < (n << 1)); bits <<= 1);
+  for (i = TXTBITS/8; i > bits/8;)
+    for (j = 0, i >>= 1; j < i; ++j) map[j] |= map[i + j];
+  ret = (char *) fs_get ((*len = bits/4) + 1);
+  for (i = 0; i < bits/8; ++i) {
+    ret[i << 1] = hex[map[i] & 0xf];
+    ret[(i << 1) + 1] = hex[map[i] >> 4];
+  }
+  ret[*len] = '\0';		/* tie off string */
+  fs_give ((void **) &map);
+  return ret;
+}
+
+/* MIX text index hash message body parts
+ * Accepts: MAIL stream
+ *	    message number
+ *	    current body pointer
+ *	    hierarchical level prefix
+ *	    position at current hierarchical level
+ *	    trigram bitmap
+ *
+ * This must visit the same texts as mail_search_body() does for TEXT
+ */
+
+void mix_text_body (MAILSTREAM *stream,unsigned long msgno,BODY *body,
+		    char *prefix,unsigned long section,unsigned char *map)
+{
+  unsigned long i;
+  char *s,*t,sect[MAILTMPLEN];
+  SIZEDTEXT st,h;
+  PART *part;
+  PARAMETER *param;
+  if (prefix && (strlen (prefix) > (MAILTMPLEN - 20))) return;
+  sprintf (sect,"%s%lu",prefix ? prefix : "",section++);
+  if (prefix) {			/* hash MIME header */
+    st.data = (unsigned char *) mail_fetch_mime (stream,msgno,sect,&st.size,
+						 FT_INTERNAL | FT_PEEK);
+    utf8_mime2text (&st,&h,U8T_CANONICAL);
+    mix_text_hash (&h,map);
+    if (h.data != st.data) fs_give ((void **) &h.data);
+  }
+  switch (body->type) {
+  case TYPEMULTIPART:
+				/* extend prefix if not first time */
+    s = prefix ? strcat (sect,".") : "";
+    for (i = 1,part = body->nested.part; part; i++,part = part->next)
+      mix_text_body (stream,msgno,&part->body,s,i,map);
+    break;
+  case TYPEMESSAGE:
+    if (!strcmp (body->subtype,"RFC822")) {
+				/* hash nested message header */
+      st.data = (unsigned char *)
+	mail_fetch_header (stream,msgno,sect,NIL,&st.size,
+			   FT_INTERNAL | FT_PEEK);
+      utf8_mime2text (&st,&h,U8T_CANONICAL);
+      mix_text_hash (&h,map);
+      if (h.data != st.data) fs_give ((void **) &h.data);
+      if (body = body->nested.msg->body) {
+	if (body->type == TYPEMULTIPART)
+	  mix_text_body (stream,msgno,body,(prefix ? prefix : ""),section - 1,
+			 map);
+	else mix_text_body (stream,msgno,body,strcat (sect,"."),1,map);
+      }
+      break;
+    }
+				/* non-MESSAGE/RFC822 falls into text case */
+
+  case TYPETEXT:
+    s = mail_fetch_body (stream,msgno,sect,&i,FT_INTERNAL | FT_PEEK);
+    for (t = NIL,param = body->parameter; param && !t; param = param->next)
+      if (!strcmp (param->attribute,"CHARSET")) t = param->value;
+    switch (body->encoding) {	/* what encoding? */
+    case ENCBASE64:
+      if (st.data = (unsigned char *)
+	  rfc822_base64 ((unsigned char *) s,i,&st.size)) {
+	mix_text_string (&st,t,map);
+	fs_give ((void **) &st.data);
+      }
+      break;
+    case ENCQUOTEDPRINTABLE:
+      if (st.data = rfc822_qprint ((unsigned char *) s,i,&st.size)) {
+	mix_text_string (&st,t,map);
+	fs_give ((void **) &st.data);
+      }
+      break;
+    default:
+      st.data = (unsigned char *) s;
+      st.size = i;
+      mix_text_string (&st,t,map);
+      break;
+    }
+    break;
+  }
+}
+
+/* MIX text index hash body text
+ * Accepts: sized text
+ *	    character set of text
+ *	    trigram bitmap
+ */
+
+void mix_text_string (SIZEDTEXT *s,char *charset,unsigned char *map)
+{
+  SIZEDTEXT u;
+				/* convert to UTF-8 as best we can */
+  if (!utf8_text (s,charset,&u,U8T_CANONICAL))
+    utf8_text (s,NIL,&u,U8T_CANONICAL);
+  mix_text_hash (&u,map);
+  if (u.data != s->data) fs_give ((void **) &u.data);
+}
+
+
+/* MIX text index hash trigrams
+ * Accepts: sized text
+ *	    trigram bitmap
+ */
+
+void mix_text_hash (SIZEDTEXT *s,unsigned char *map)
+{
+  unsigned long i;
+  unsigned int k;
+  for (i = 0; (i + 3) <= s->size; ++i) {
+    k = TXTHASH (s->data + i);
+    map[k >> 3] |= 1 << (k & 7);
+  }
+}
+
 /* MIX generic file routines */
 
 /* MIX read record
@@ -260,6 +260,7 @@ void mmdf_lsub (MAILSTREAM *stream,char *ref,char *pat);
 long mmdf_create (MAILSTREAM *stream,char *mailbox);
 long mmdf_delete (MAILSTREAM *stream,char *mailbox);
 long mmdf_rename (MAILSTREAM *stream,char *old,char *newname);
+long mmdf_status (MAILSTREAM *stream,char *mbx,long flags);
 MAILSTREAM *mmdf_open (MAILSTREAM *stream);
 void mmdf_close (MAILSTREAM *stream,long options);
 char *mmdf_header (MAILSTREAM *stream,unsigned long msgno,
@@ -312,7 +313,7 @@ DRIVER mmdfdriver = {
   mmdf_create,			/* create mailbox */
   mmdf_delete,			/* delete mailbox */
   mmdf_rename,			/* rename mailbox */
-  mail_status_default,		/* status of mailbox */
+  mmdf_status,			/* status of mailbox */
   mmdf_open,			/* open mailbox */
   mmdf_close,			/* close mailbox */
   NIL,				/* fetch message "fast" attributes */
@@ -334,7 +335,8 @@ DRIVER mmdfdriver = {
   mmdf_expunge,			/* expunge deleted messages */
   mmdf_copy,			/* copy messages to another mailbox */
   mmdf_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -586,6 +588,21 @@ long mmdf_rename (MAILSTREAM *stream,char *old,char *newname)
   return ret;			/* return success or failure */
 }
 
+/* MMDF mail status
+ * Accepts: mail stream
+ *	    mailbox name
+ *	    status flags
+ * Returns: T on success, NIL on failure
+ */
+
+long mmdf_status (MAILSTREAM *stream,char *mbx,long flags)
+{
+  char tmp[MAILTMPLEN];
+  return dummy_file (tmp,mbx) ?
+    statuscache_status (stream,mbx,flags,tmp,NIL) :
+    mail_status_default (stream,mbx,flags);
+}
+
 /* MMDF mail open
  * Accepts: Stream to open
  * Returns: Stream on success, NIL on failure
@@ -143,7 +143,8 @@ DRIVER mtxdriver = {
   mtx_expunge,			/* expunge deleted messages */
   mtx_copy,			/* copy messages to another mailbox */
   mtx_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -357,6 +358,11 @@ long mtx_status (MAILSTREAM *stream,char *mbx,long flags)
   unsigned long i;
   MAILSTREAM *tstream = NIL;
   MAILSTREAM *systream = NIL;
+  char tmp[MAILTMPLEN];
+				/* cached unless INBOX, which may snarf */
+  if (!stream && mail_parameters (NIL,GET_STATUSCACHEDIR,NIL) &&
+      compare_cstring (mbx,"INBOX") && mtx_file (tmp,mbx))
+    return statuscache_status (stream,mbx,flags,tmp,NIL);
 				/* make temporary stream (unless this mbx) */
   if (!stream && !(stream = tstream =
 		   mail_open (NIL,mbx,OP_READONLY|OP_SILENT))) return NIL;
@@ -368,6 +374,7 @@ long mtx_status (MAILSTREAM *stream,char *mbx,long flags)
       if (!mail_elt (stream,i)->seen) status.unseen++;
   status.uidnext = stream->uid_last + 1;
   status.uidvalidity = stream->uid_validity;
+  status.highestmodseq = 0;	/* no modsequences */
 				/* calculate post-snarf results */
   if (!status.recent && stream->inbox &&
       (systream = mail_open (NIL,sysinbox (),OP_READONLY|OP_SILENT))) {
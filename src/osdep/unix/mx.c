@@ -50,6 +50,7 @@ extern int errno;		/* just in case */
 	
 typedef struct mx_local {
   int fd;			/* file descriptor of open index */
+  int wd;			/* change watch descriptor */
   unsigned char *buf;		/* temporary buffer */
   unsigned long buflen;		/* current size of temporary buffer */
   unsigned long cachedtexts;	/* total size of all cached texts */
@@ -80,6 +81,7 @@ long mx_create (MAILSTREAM *stream,char *mailbox);
 long mx_delete (MAILSTREAM *stream,char *mailbox);
 long mx_rename (MAILSTREAM *stream,char *old,char *newname);
 int mx_rename_work (char *src,size_t srcl,char *dst,size_t dstl,char *name);
+long mx_status (MAILSTREAM *stream,char *mbx,long flags);
 MAILSTREAM *mx_open (MAILSTREAM *stream);
 void mx_close (MAILSTREAM *stream,long options);
 void mx_fast (MAILSTREAM *stream,char *sequence,long flags);
@@ -91,6 +93,7 @@ void mx_flag (MAILSTREAM *stream,char *sequence,char *flag,long flags);
 void mx_flagmsg (MAILSTREAM *stream,MESSAGECACHE *elt);
 long mx_ping (MAILSTREAM *stream);
 void mx_check (MAILSTREAM *stream);
+int mx_watch (MAILSTREAM *stream);
 long mx_expunge (MAILSTREAM *stream,char *sequence,long options);
 long mx_copy (MAILSTREAM *stream,char *sequence,char *mailbox,
 	      long options);
@@ -126,7 +129,7 @@ DRIVER mxdriver = {
   mx_create,			/* create mailbox */
   mx_delete,			/* delete mailbox */
   mx_rename,			/* rename mailbox */
-  mail_status_default,		/* status of mailbox */
+  mx_status,			/* status of mailbox */
   mx_open,			/* open mailbox */
   mx_close,			/* close mailbox */
   mx_fast,			/* fetch message "fast" attributes */
@@ -148,7 +151,8 @@ DRIVER mxdriver = {
   mx_expunge,			/* expunge deleted messages */
   mx_copy,			/* copy messages to another mailbox */
   mx_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  mx_watch			/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -502,6 +506,21 @@ int mx_rename_work (char *src,size_t srcl,char *dst,size_t dstl,char *name)
   return ret;
 }
 
+/* MX mail status
+ * Accepts: mail stream
+ *	    mailbox name
+ *	    status flags
+ * Returns: T on success, NIL on failure
+ */
+
+long mx_status (MAILSTREAM *stream,char *mbx,long flags)
+{
+  static char *files[] = {MXINDEXNAME+1,NIL};
+  char tmp[MAILTMPLEN];
+  return mx_file (tmp,mbx) ? statuscache_status (stream,mbx,flags,tmp,files) :
+    mail_status_default (stream,mbx,flags);
+}
+
 /* MX mail open
  * Accepts: stream to open
  * Returns: stream on success, NIL on failure
@@ -525,6 +544,7 @@ MAILSTREAM *mx_open (MAILSTREAM *stream)
   LOCAL->buflen = CHUNKSIZE - 1;
   LOCAL->scantime = 0;		/* not scanned yet */
   LOCAL->fd = -1;		/* no index yet */
+  LOCAL->wd = -1;		/* not watching for changes yet */
   LOCAL->cachedtexts = 0;	/* no cached texts */
   stream->sequence++;		/* bump sequence number */
 				/* parse mailbox */
@@ -552,6 +572,7 @@ void mx_close (MAILSTREAM *stream,long options)
     if (options & CL_EXPUNGE) mx_expunge (stream,NIL,NIL);
 				/* free local scratch buffer */
     if (LOCAL->buf) fs_give ((void **) &LOCAL->buf);
+    if (LOCAL->wd >= 0) close (LOCAL->wd);
 				/* nuke the local data */
     fs_give ((void **) &stream->local);
     stream->dtb = NIL;		/* log out the DTB */
@@ -830,6 +851,19 @@ void mx_check (MAILSTREAM *stream)
 }
 
 
+/* MX mail watch mailbox
+ * Accepts: MAIL stream
+ * Returns: descriptor readable when messages are added or removed, or -1
+ *
+ * Changed contents are not watched, since every ping rewrites the index.
+ */
+
+int mx_watch (MAILSTREAM *stream)
+{
+  return LOCAL ? watch_file (&LOCAL->wd,stream->mailbox,NIL) : -1;
+}
+
+
 /* MX mail expunge mailbox
  * Accepts: MAIL stream
  *	    sequence to expunge if non-NIL
@@ -47,6 +47,7 @@
 #include <utime.h>
 #include <syslog.h>
 #include <sys/file.h>
+#include <sys/inotify.h>
 
 
 /* Linux gets this wrong */
@@ -134,7 +134,8 @@ DRIVER philedriver = {
   phile_expunge,		/* expunge deleted messages */
   phile_copy,			/* copy messages to another mailbox */
   phile_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -238,6 +239,7 @@ long phile_status (MAILSTREAM *stream,char *mbx,long flags)
     status.unseen = (stream && mail_elt (stream,1)->seen) ? 0 : 1;
     status.messages = status.recent = status.uidnext = 1;
     status.uidvalidity = sbuf.st_mtime;
+    status.highestmodseq = 0;	/* no modsequences */
 				/* pass status to main program */
     mm_status (stream,mbx,&status);
     ret = LONGT;		/* success */
@@ -0,0 +1,212 @@
+/* ========================================================================
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * ========================================================================
+ */
+
+/*
+ * Program:	Primary output buffer routines for server use
+ *
+ * Date:	17 October 2026
+ * Last Edited:	18 October 2026
+ */
+
+/*  Server output is collected in a single buffer whether or not the session
+ * is using SSL, and is written when the buffer fills or PFLUSH() is called
+ * at the end of a response.  A record at least POUTBYREF bytes long is not
+ * copied into the buffer; it is written directly from the caller's storage,
+ * together with anything already buffered, in a single gathered write.  The
+ * includer defines pout_sink() to do the actual writing.
+ *
+ *  Once COMPRESS=DEFLATE (RFC 4978) is in effect, everything written goes
+ * through the compressed output routines of the deflate module, which sync
+ * flush the deflate stream only at PFLUSH(), and input is inflated from data
+ * obtained from the includer's pin_source().
+ */
+
+#include <sys/uio.h>
+
+#define POUTBUFLEN 16384	/* size of output buffer */
+#define POUTBYREF 4096		/* minimum size of record written in place */
+
+static long pout_sink (struct iovec *iov,int iovcnt);
+static long pin_source (char *buf,unsigned long size);
+static void pout_exit (void);
+static long pout_drain (long flush);
+static long pout_write (struct iovec *iov,int iovcnt,long flush);
+
+static char poutbuf[POUTBUFLEN];/* output buffer */
+static unsigned long poutcnt = 0;
+				/* number of bytes in output buffer */
+static int poutexit = 0;	/* exit handler registered */
+
+/* Put character
+ * Accepts: character
+ * Returns: character written or EOF
+ */
+
+int PBOUT (int c)
+{
+  if (!poutexit) poutexit = !atexit (pout_exit);
+				/* flush buffer if full */
+  if ((poutcnt == POUTBUFLEN) && !pout_drain (NIL)) return EOF;
+  poutbuf[poutcnt++] = c;	/* write character */
+  return c;			/* return that character */
+}
+
+
+/* Put string
+ * Accepts: source string pointer
+ * Returns: 0 or EOF if error
+ */
+
+int PSOUT (char *s)
+{
+  SIZEDTEXT st;
+  st.data = (unsigned char *) s;
+  st.size = strlen (s);
+  return PSOUTR (&st);
+}
+
+/* Put record
+ * Accepts: source sized text
+ * Returns: 0 or EOF if error
+ */
+
+int PSOUTR (SIZEDTEXT *s)
+{
+  struct iovec iov[2];
+  if (!poutexit) poutexit = !atexit (pout_exit);
+  if (s->size >= POUTBYREF) {	/* big record is written in place */
+    iov[0].iov_base = poutbuf;
+    iov[0].iov_len = poutcnt;
+    iov[1].iov_base = (void *) s->data;
+    iov[1].iov_len = s->size;
+    poutcnt = 0;		/* buffer is written with it */
+    return pout_write (iov,2,NIL) ? 0 : EOF;
+  }
+				/* flush buffer if record won't fit */
+  if (((poutcnt + s->size) > POUTBUFLEN) && !pout_drain (NIL)) return EOF;
+  memcpy (poutbuf + poutcnt,s->data,s->size);
+  poutcnt += s->size;
+  return 0;			/* success */
+}
+
+
+/* Flush output
+ * Returns: 0 or EOF if error
+ */
+
+int PFLUSH (void)
+{
+  return pout_drain (LONGT) ? 0 : EOF;
+}
+
+
+/* Flush output at exit
+ */
+
+static void pout_exit (void)
+{
+  PFLUSH ();
+}
+
+/* Drain output buffer
+ * Accepts: flag to sync flush compressed output
+ * Returns: T if success else NIL
+ */
+
+static long pout_drain (long flush)
+{
+  struct iovec iov;
+				/* nothing to do if buffer empty */
+  if (!poutcnt && !(flush && pzip && pzip_dirty ())) return LONGT;
+  iov.iov_base = poutbuf;
+  iov.iov_len = poutcnt;
+  poutcnt = 0;			/* renew output buffer */
+  return pout_write (&iov,1,flush);
+}
+
+
+/* Write output, compressing if needed
+ * Accepts: I/O vector
+ *	    I/O vector count
+ *	    flag to sync flush compressed output
+ * Returns: T if success else NIL
+ */
+
+static long pout_write (struct iovec *iov,int iovcnt,long flush)
+{
+  return pzip ? pzip_write (iov,iovcnt,flush) : pout_sink (iov,iovcnt);
+}
+
+/* Write vector to file descriptor
+ * Accepts: file descriptor
+ *	    I/O vector
+ *	    I/O vector count
+ * Returns: T if success else NIL
+ */
+
+static long pout_writev (int fd,struct iovec *iov,int iovcnt)
+{
+  ssize_t i;
+  while (iovcnt) {
+    if (!iov->iov_len) ++iov,--iovcnt;
+    else if ((i = writev (fd,iov,iovcnt)) >= 0) {
+				/* account for vectors written in full */
+      for (; iovcnt && (i >= (ssize_t) iov->iov_len); ++iov,--iovcnt)
+	i -= iov->iov_len;
+      if (i) {			/* partial write of a vector */
+	iov->iov_base = (char *) iov->iov_base + i;
+	iov->iov_len -= i;
+      }
+    }
+    else if (errno != EINTR) return NIL;
+  }
+  return LONGT;
+}
+
+
+/* Read standard input for decompression
+ * Accepts: buffer
+ *	    maximum number of bytes
+ * Returns: number of bytes read, or 0 if EOF
+ *
+ * Stdio may already hold compressed data read in along with the COMPRESS
+ * command.  After waiting for the first byte, whatever stdio has buffered
+ * and the descriptor has ready is taken without blocking.  Once that finds
+ * nothing more, the stdio buffer is known to be empty, and later calls read
+ * the descriptor directly.
+ */
+
+static long pin_stdio (char *buf,unsigned long size)
+{
+  static int direct = NIL;	/* stdio buffer known to be empty */
+  int c,flags;
+  ssize_t i;
+  if (direct) {			/* read whatever is there */
+    while (((i = read (0,buf,size)) < 0) && (errno == EINTR));
+    return (i > 0) ? i : 0;
+  }
+  do {				/* wait for first byte */
+    clearerr (stdin);
+    c = getchar ();
+  } while ((c == EOF) && !feof (stdin) && ferror (stdin) && (errno == EINTR));
+  if (c == EOF) return 0;
+  *buf = (char) c;
+  if ((size > 1) && ((flags = fcntl (0,F_GETFL,0)) >= 0) &&
+      (fcntl (0,F_SETFL,flags | O_NONBLOCK) >= 0)) {
+				/* take the rest without waiting */
+    i = fread (buf + 1,1,size - 1,stdin);
+    if (ferror (stdin) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+      direct = T;		/* stdio buffer drained */
+    clearerr (stdin);
+    fcntl (0,F_SETFL,flags);
+    return i + 1;
+  }
+  return 1;
+}
@@ -34,6 +34,15 @@ void ssl_server_init (char *server)
 }
 
 
+/* Prepare server SSL contexts
+ * Accepts: server name
+ */
+
+void ssl_server_prepare (char *server)
+{
+}
+
+
 /* Start TLS
  * Accepts: /etc/services service name
  * Returns: cpystr'd error string if TLS failed, else NIL for success
@@ -44,6 +53,8 @@ char *ssl_start_tls (char *server)
   return cpystr ("This server does not support TLS");
 }
 
+#include "pout.c"
+
 /* Get character
  * Returns: character or EOF
  */
@@ -51,6 +62,7 @@ char *ssl_start_tls (char *server)
 int PBIN (void)
 {
   int ret;
+  if (pzip) return pzip_bin ();
   do {
     clearerr (stdin);
     ret = getchar ();
@@ -68,6 +80,7 @@ int PBIN (void)
 char *PSIN (char *s,int n)
 {
   char *ret;
+  if (pzip) return pzip_sin (s,n);
   do {
     clearerr (stdin);
     ret = fgets (s,n,stdin);
@@ -85,6 +98,7 @@ char *PSIN (char *s,int n)
 long PSINR (char *s,unsigned long n)
 {
   unsigned long i;
+  if (pzip) return pzip_sinr (s,n);
   while (n && ((i = fread (s,1,n,stdin)) || (errno == EINTR))) s += i,n -= i;
   return n ? NIL : LONGT;
 }
@@ -97,52 +111,40 @@ long PSINR (char *s,unsigned long n)
 
 long INWAIT (long seconds)
 {
-  return server_input_wait (seconds);
-}
-
-/* Put character
- * Accepts: character
- * Returns: character written or EOF
- */
-
-int PBOUT (int c)
-{
-  return putchar (c);
+  return (pzip && pzip_pending ()) ? LONGT : server_input_wait (seconds);
 }
 
 
-/* Put string
- * Accepts: source string pointer
- * Returns: 0 or EOF if error
+/* Wait for input or mailbox change
+ * Accepts: timeout in seconds
+ *	    descriptor from mail_watch(), or -1
+ * Returns: T if have input on stdin, -1 if change, else NIL
  */
 
-int PSOUT (char *s)
+long INWATCH (long seconds,int fd)
 {
-  return fputs (s,stdout);
+  return (pzip && pzip_pending ()) ? LONGT : server_input_watch (seconds,fd);
 }
-
-
-/* Put record
- * Accepts: source sized text
- * Returns: 0 or EOF if error
+
+/* Write primary output
+ * Accepts: I/O vector
+ *	    I/O vector count
+ * Returns: T if success else NIL
  */
 
-int PSOUTR (SIZEDTEXT *s)
+static long pout_sink (struct iovec *iov,int iovcnt)
 {
-  unsigned char *t;
-  unsigned long i,j;
-  for (t = s->data,i = s->size;
-       (i && ((j = fwrite (t,1,i,stdout)) || (errno == EINTR)));
-       t += j,i -= j);
-  return i ? EOF : NIL;
+  return pout_writev (1,iov,iovcnt);
 }
 
 
-/* Flush output
- * Returns: 0 or EOF if error
+/* Read primary input for decompression
+ * Accepts: buffer
+ *	    maximum number of bytes
+ * Returns: number of bytes read, or 0 if EOF
  */
 
-int PFLUSH (void)
+static long pin_source (char *buf,unsigned long size)
 {
-  return fflush (stdout);
+  return pin_stdio (buf,size);
 }
@@ -37,6 +37,15 @@
 #undef crypt
 
 #define SSLBUFLEN 8192
+#define SSLSESSIONLEN 16384	/* maximum size of cached session */
+
+/* OpenSSL 1.1 made the session ID argument of the get callback const */
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+#define SSLSESSIONID const unsigned char *
+#else
+#define SSLSESSIONID unsigned char *
+#endif
 
 /*
  * PCI auditing compliance, disable:
@@ -79,6 +88,15 @@ static char *ssl_getline_work (SSLSTREAM *stream,unsigned long *size,
 			       long *contd);
 static long ssl_abort (SSLSTREAM *stream);
 static RSA *ssl_genkey (SSL *con,int export,int keylength);
+static SSL_CTX *ssl_server_context (char *cert,char *key,long tls,char *host);
+static void ssl_server_session_cache (SSL_CTX *context,char *server);
+static int ssl_session_new (SSL *con,SSL_SESSION *session);
+static SSL_SESSION *ssl_session_get (SSL *con,SSLSESSIONID id,int len,
+				     int *copy);
+static void ssl_session_remove (SSL_CTX *context,SSL_SESSION *session);
+static char *ssl_session_file (char *dst,const unsigned char *id,
+			       unsigned int len);
+static void ssl_session_sweep (long timeout);
 
 
 /* Secure Sockets Layer network driver dispatch */
@@ -94,11 +112,24 @@ static struct ssl_driver ssldriver = {
   ssl_host,			/* return host name */
   ssl_remotehost,		/* return remote host name */
   ssl_port,			/* return port number */
-  ssl_localhost			/* return local host name */
+  ssl_localhost,		/* return local host name */
+  ssl_getsome			/* get some data */
 };
 				/* non-NIL if doing SSL primary I/O */
 static SSLSTDIOSTREAM *sslstdio = NIL;
 static char *start_tls = NIL;	/* non-NIL if start TLS requested */
+
+/* Prepared server context */
+
+typedef struct ssl_server_context {
+  char *cert;			/* certificate file name */
+  char *key;			/* private key file name */
+  SSL_CTX *context;		/* context made from them */
+} SSLSERVERCONTEXT;
+				/* prepared contexts for SSL, TLS */
+static SSLSERVERCONTEXT sslserver[2];
+				/* session cache directory if caching */
+static char *sslsessiondir = NIL;
 
 /* One-time SSL initialization */
 
@@ -479,6 +510,25 @@ long ssl_getbuffer (SSLSTREAM *stream,unsigned long size,char *buffer)
   return T;
 }
 
+/* SSL receive some data
+ * Accepts: SSL stream
+ *	    maximum size in bytes
+ *	    buffer to read into
+ * Returns: number of bytes read, 0 if failure
+ */
+
+unsigned long ssl_getsome (SSLSTREAM *stream,unsigned long size,char *buffer)
+{
+  unsigned long n;
+  if (!ssl_getdata (stream)) return 0;
+  n = min (size,stream->ictr);	/* number of bytes to transfer */
+  memcpy (buffer,stream->iptr,n);
+  stream->iptr += n;
+  stream->ictr -= n;
+  return n;
+}
+
+
 /* SSL receive data
  * Accepts: TCP/IP stream
  * Returns: T if success, NIL otherwise
@@ -700,6 +750,7 @@ void ssl_server_init (char *server)
   char cert[MAILTMPLEN],key[MAILTMPLEN];
   unsigned long i;
   struct stat sbuf;
+  long tls = start_tls ? 1 : 0;
   SSLSTREAM *stream = (SSLSTREAM *) memset (fs_get (sizeof (SSLSTREAM)),0,
 					    sizeof (SSLSTREAM));
   ssl_onceonlyinit ();		/* make sure algorithms added */
@@ -715,59 +766,39 @@ void ssl_server_init (char *server)
 				/* use cert file as fallback for key */
     if (stat (key,&sbuf)) strcpy (key,cert);
   }
-				/* create context */
-  if (!(stream->context = SSL_CTX_new (start_tls ?
-				       TLSv1_server_method () :
-				       SSLv23_server_method ())))
-    syslog (LOG_ALERT,"Unable to create SSL context, host=%.80s",
-	    tcp_clienthost ());
-  else {			/* set context options */
-    SSL_CTX_set_options (stream->context,SSL_OP_ALL);
-				/* set cipher list */
-    if (!SSL_CTX_set_cipher_list (stream->context,SSLCIPHERLIST))
-      syslog (LOG_ALERT,"Unable to set cipher list %.80s, host=%.80s",
-	      SSLCIPHERLIST,tcp_clienthost ());
-				/* load certificate */
-    else if (!SSL_CTX_use_certificate_chain_file (stream->context,cert))
-      syslog (LOG_ALERT,"Unable to load certificate from %.80s, host=%.80s",
-	      cert,tcp_clienthost ());
-				/* load key */
-    else if (!(SSL_CTX_use_RSAPrivateKey_file (stream->context,key,
-					       SSL_FILETYPE_PEM)))
-      syslog (LOG_ALERT,"Unable to load private key from %.80s, host=%.80s",
-	      key,tcp_clienthost ());
-
-    else {			/* generate key if needed */
-      if (SSL_CTX_need_tmp_RSA (stream->context))
-	SSL_CTX_set_tmp_rsa_callback (stream->context,ssl_genkey);
+				/* use prepared context if same files */
+  if (sslserver[tls].context && !strcmp (cert,sslserver[tls].cert) &&
+      !strcmp (key,sslserver[tls].key)) {
+    stream->context = sslserver[tls].context;
+    sslserver[tls].context = NIL;/* stream owns it now */
+    RAND_poll ();		/* don't share random state with siblings */
+  }
+  else stream->context = ssl_server_context (cert,key,tls,tcp_clienthost ());
+  if (stream->context) {	/* share sessions with other servers */
+    ssl_server_session_cache (stream->context,server);
 				/* create new SSL connection */
-      if (!(stream->con = SSL_new (stream->context)))
-	syslog (LOG_ALERT,"Unable to create SSL connection, host=%.80s",
-		tcp_clienthost ());
-      else {			/* set file descriptor */
-	SSL_set_fd (stream->con,0);
+    if (!(stream->con = SSL_new (stream->context)))
+      syslog (LOG_ALERT,"Unable to create SSL connection, host=%.80s",
+	      tcp_clienthost ());
+    else {			/* set file descriptor */
+      SSL_set_fd (stream->con,0);
 				/* all OK if accepted */
-	if (SSL_accept (stream->con) < 0)
-	  syslog (LOG_INFO,"Unable to accept SSL connection, host=%.80s",
-		  tcp_clienthost ());
-	else {			/* server set up */
-	  sslstdio = (SSLSTDIOSTREAM *)
-	    memset (fs_get (sizeof(SSLSTDIOSTREAM)),0,sizeof (SSLSTDIOSTREAM));
-	  sslstdio->sslstream = stream;
-				/* available space in output buffer */
-	  sslstdio->octr = SSLBUFLEN;
-				/* current output buffer pointer */
-	  sslstdio->optr = sslstdio->obuf;
+      if (SSL_accept (stream->con) < 0)
+	syslog (LOG_INFO,"Unable to accept SSL connection, host=%.80s",
+		tcp_clienthost ());
+      else {			/* server set up */
+	sslstdio = (SSLSTDIOSTREAM *)
+	  memset (fs_get (sizeof(SSLSTDIOSTREAM)),0,sizeof (SSLSTDIOSTREAM));
+	sslstdio->sslstream = stream;
 				/* allow plaintext if disable value was 2 */
-	  if ((long) mail_parameters (NIL,GET_DISABLEPLAINTEXT,NIL) > 1)
-	    mail_parameters (NIL,SET_DISABLEPLAINTEXT,NIL);
+	if ((long) mail_parameters (NIL,GET_DISABLEPLAINTEXT,NIL) > 1)
+	  mail_parameters (NIL,SET_DISABLEPLAINTEXT,NIL);
 				/* unhide PLAIN SASL authenticator */
-	  mail_parameters (NIL,UNHIDE_AUTHENTICATOR,"PLAIN");
-	  mail_parameters (NIL,UNHIDE_AUTHENTICATOR,"LOGIN");
-	  return;
-	}
+	mail_parameters (NIL,UNHIDE_AUTHENTICATOR,"PLAIN");
+	mail_parameters (NIL,UNHIDE_AUTHENTICATOR,"LOGIN");
+	return;
       }
-    }  
+    }
   }
   while (i = ERR_get_error ())	/* SSL failure */
     syslog (LOG_ERR,"SSL error status: %.80s",ERR_error_string (i,NIL));
@@ -775,6 +806,237 @@ void ssl_server_init (char *server)
   exit (1);			/* punt this program too */
 }
 
+/* Prepare server SSL contexts
+ * Accepts: server name
+ *
+ * Called by a standalone server before it accepts any connections, so that
+ * the certificate and key are loaded once instead of by every session.
+ * Only the non-specific certificate and key files are prepared, since the
+ * server address of a session is not yet known.
+ */
+
+void ssl_server_prepare (char *server)
+{
+  char cert[MAILTMPLEN],key[MAILTMPLEN];
+  unsigned long i;
+  long tls;
+  struct stat sbuf;
+  ssl_onceonlyinit ();		/* make sure algorithms added */
+  ERR_load_crypto_strings ();
+  SSL_load_error_strings ();
+  sprintf (cert,"%s/%s.pem",SSL_CERT_DIRECTORY,server);
+  sprintf (key,"%s/%s.pem",SSL_KEY_DIRECTORY,server);
+				/* use cert file as fallback for key */
+  if (stat (key,&sbuf)) strcpy (key,cert);
+  if (!stat (cert,&sbuf)) for (tls = 0; tls < 2; ++tls) {
+    if (sslserver[tls].context =
+	ssl_server_context (cert,key,tls,"(standalone server)")) {
+      sslserver[tls].cert = cpystr (cert);
+      sslserver[tls].key = cpystr (key);
+    }
+    else while (i = ERR_get_error ())
+      syslog (LOG_ERR,"SSL error status: %.80s",ERR_error_string (i,NIL));
+  }
+}
+
+
+/* Create server SSL context
+ * Accepts: certificate file name
+ *	    private key file name
+ *	    non-zero if for TLS, else for SSL
+ *	    client host name for log messages
+ * Returns: context, or NIL if failure
+ */
+
+static SSL_CTX *ssl_server_context (char *cert,char *key,long tls,char *host)
+{
+  SSL_CTX *context;
+				/* create context */
+  if (!(context = SSL_CTX_new (tls ? TLSv1_server_method () :
+			       SSLv23_server_method ()))) {
+    syslog (LOG_ALERT,"Unable to create SSL context, host=%.80s",host);
+    return NIL;
+  }
+				/* set context options */
+  SSL_CTX_set_options (context,SSL_OP_ALL);
+				/* set cipher list */
+  if (!SSL_CTX_set_cipher_list (context,SSLCIPHERLIST))
+    syslog (LOG_ALERT,"Unable to set cipher list %.80s, host=%.80s",
+	    SSLCIPHERLIST,host);
+				/* load certificate */
+  else if (!SSL_CTX_use_certificate_chain_file (context,cert))
+    syslog (LOG_ALERT,"Unable to load certificate from %.80s, host=%.80s",
+	    cert,host);
+				/* load key */
+  else if (!(SSL_CTX_use_RSAPrivateKey_file (context,key,SSL_FILETYPE_PEM)))
+    syslog (LOG_ALERT,"Unable to load private key from %.80s, host=%.80s",
+	    key,host);
+  else {			/* generate key if needed */
+    if (SSL_CTX_need_tmp_RSA (context))
+      SSL_CTX_set_tmp_rsa_callback (context,ssl_genkey);
+    return context;
+  }
+  SSL_CTX_free (context);	/* failed, punt context */
+  return NIL;
+}
+
+/* Set up server session cache
+ * Accepts: SSL context
+ *	    server name
+ *
+ * Each session is a process of its own, so OpenSSL's internal session
+ * cache can never be hit.  If a session cache directory is configured,
+ * sessions are instead saved in files there, one per session ID, so that
+ * a client reconnecting to any server process can resume its session.
+ * Session tickets are disabled so that clients resume by session ID.  The
+ * directory must be private to the server, since the files hold session
+ * keys.
+ */
+
+static void ssl_server_session_cache (SSL_CTX *context,char *server)
+{
+  struct stat sbuf;
+  char *dir = (char *) mail_parameters (NIL,GET_SSLSESSIONCACHEDIR,NIL);
+  if (dir && ((strlen (dir) + 2*SSL_MAX_SSL_SESSION_ID_LENGTH) <
+	      (MAILTMPLEN - 20))) {
+				/* create directory if needed */
+    if (stat (dir,&sbuf) && (mkdir (dir,0700) || stat (dir,&sbuf)))
+      syslog (LOG_ALERT,"Unable to create SSL session cache %.80s: %.80s",
+	      dir,strerror (errno));
+    else if (((sbuf.st_mode & S_IFMT) != S_IFDIR) ||
+	     (sbuf.st_uid != geteuid ()) || (sbuf.st_mode & 077))
+      syslog (LOG_ALERT,"SSL session cache %.80s must be a private directory",
+	      dir);
+    else {			/* only use the external cache */
+      sslsessiondir = dir;
+      SSL_CTX_set_session_cache_mode (context,SSL_SESS_CACHE_SERVER |
+				      SSL_SESS_CACHE_NO_INTERNAL);
+      SSL_CTX_set_options (context,SSL_OP_NO_TICKET);
+				/* only resume sessions of this server */
+      SSL_CTX_set_session_id_context (context,(unsigned char *) server,
+				      min (strlen (server),
+					   SSL_MAX_SID_CTX_LENGTH));
+      SSL_CTX_sess_set_new_cb (context,ssl_session_new);
+      SSL_CTX_sess_set_get_cb (context,ssl_session_get);
+      SSL_CTX_sess_set_remove_cb (context,ssl_session_remove);
+    }
+  }
+}
+
+/* Save new session in session cache
+ * Accepts: SSL connection
+ *	    session
+ * Returns: 0, always (no reference to the session is kept)
+ */
+
+static int ssl_session_new (SSL *con,SSL_SESSION *session)
+{
+  char file[MAILTMPLEN],tmp[MAILTMPLEN];
+  unsigned int len;
+  int fd,ok;
+  unsigned char *der,*s;
+  const unsigned char *id = SSL_SESSION_get_id (session,&len);
+  int i = i2d_SSL_SESSION (session,NIL);
+  if ((i > 0) && (i < SSLSESSIONLEN) && ssl_session_file (file,id,len)) {
+    s = der = (unsigned char *) fs_get (i);
+    i2d_SSL_SESSION (session,&s);
+    sprintf (tmp,"%s.%lx",file,(unsigned long) getpid ());
+				/* write new file then rename into place */
+    if ((fd = open (tmp,O_WRONLY|O_CREAT|O_EXCL,0600)) >= 0) {
+      ok = (safe_write (fd,(char *) der,i) == i);
+      if (close (fd) || !ok || rename (tmp,file)) unlink (tmp);
+    }
+    fs_give ((void **) &der);
+				/* sweep out expired sessions now and then */
+    if (!id[0]) ssl_session_sweep (SSL_SESSION_get_timeout (session));
+  }
+  return 0;
+}
+
+
+/* Look up session in session cache
+ * Accepts: SSL connection
+ *	    session ID
+ *	    length of session ID
+ *	    pointer to return flag that a reference is kept
+ * Returns: session if found, else NIL
+ *
+ * OpenSSL checks that the session has not expired.
+ */
+
+static SSL_SESSION *ssl_session_get (SSL *con,SSLSESSIONID id,int len,
+				     int *copy)
+{
+  char file[MAILTMPLEN];
+  unsigned char der[SSLSESSIONLEN];
+  const unsigned char *s = der;
+  int fd;
+  long i;
+  SSL_SESSION *ret = NIL;
+  *copy = 0;			/* caller gets our only reference */
+  if ((len > 0) && ssl_session_file (file,id,len) &&
+      ((fd = open (file,O_RDONLY,NIL)) >= 0)) {
+    if (((i = read (fd,der,SSLSESSIONLEN)) > 0) && (i < SSLSESSIONLEN))
+      ret = d2i_SSL_SESSION (NIL,&s,i);
+    close (fd);
+  }
+  return ret;
+}
+
+
+/* Remove session from session cache
+ * Accepts: SSL context
+ *	    session
+ */
+
+static void ssl_session_remove (SSL_CTX *context,SSL_SESSION *session)
+{
+  char file[MAILTMPLEN];
+  unsigned int len;
+  const unsigned char *id = SSL_SESSION_get_id (session,&len);
+  if (ssl_session_file (file,id,len)) unlink (file);
+}
+
+/* Return session cache file name
+ * Accepts: destination buffer
+ *	    session ID
+ *	    length of session ID
+ * Returns: file name, or NIL if not caching or bad session ID
+ */
+
+static char *ssl_session_file (char *dst,const unsigned char *id,
+			       unsigned int len)
+{
+  char *s;
+  if (!sslsessiondir || !len || (len > SSL_MAX_SSL_SESSION_ID_LENGTH))
+    return NIL;
+  sprintf (dst,"%s/",sslsessiondir);
+  for (s = dst + strlen (dst); len--; s += 2) sprintf (s,"%02x",*id++);
+  return dst;
+}
+
+
+/* Remove expired sessions from session cache
+ * Accepts: session timeout in seconds
+ */
+
+static void ssl_session_sweep (long timeout)
+{
+  char tmp[MAILTMPLEN];
+  DIR *dirp;
+  struct direct *d;
+  struct stat sbuf;
+  time_t now = time (0);
+  if (dirp = opendir (sslsessiondir)) {
+    while (d = readdir (dirp)) if ((d->d_name[0] != '.') &&
+				   (strlen (d->d_name) < 80)) {
+      sprintf (tmp,"%s/%s",sslsessiondir,d->d_name);
+      if (!stat (tmp,&sbuf) && ((now - sbuf.st_mtime) > timeout)) unlink (tmp);
+    }
+    closedir (dirp);
+  }
+}
+
 /* Generate one-time key for server
  * Accepts: SSL connection
  *	    export flag
@@ -832,4 +1094,43 @@ long ssl_server_input_wait (long seconds)
   return select (sock+1,&fds,0,&efd,&tmo) ? LONGT : NIL;
 }
 
+
+/* Wait for stdin input or mailbox change
+ * Accepts: timeout in seconds
+ *	    descriptor from watch_file(), or -1
+ * Returns: T if have input on stdin, -1 if change, else NIL
+ */
+
+long ssl_server_input_watch (long seconds,int fd)
+{
+  int i,sock;
+  fd_set fds,efd;
+  struct timeval tmo;
+  SSLSTREAM *stream;
+  if (!sslstdio) return server_input_watch (seconds,fd);
+  if (fd < 0) return ssl_server_input_wait (seconds);
+				/* input available in buffer */
+  if (((stream = sslstdio->sslstream)->ictr > 0) ||
+      !stream->con || ((sock = SSL_get_fd (stream->con)) < 0)) return LONGT;
+  if ((sock >= FD_SETSIZE) || (fd >= FD_SETSIZE))
+    fatal ("unselectable socket in ssl_server_input_watch()");
+				/* input available from SSL */
+  if (SSL_pending (stream->con) &&
+      ((i = SSL_read (stream->con,stream->ibuf,SSLBUFLEN)) > 0)) {
+    stream->iptr = stream->ibuf;/* point at TCP buffer */
+    stream->ictr = i;		/* set new byte count */
+    return LONGT;
+  }
+  FD_ZERO (&fds);		/* initialize selection vector */
+  FD_ZERO (&efd);		/* initialize selection vector */
+  FD_SET (sock,&fds);		/* set bit in selection vector */
+  FD_SET (sock,&efd);		/* set bit in selection vector */
+  FD_SET (fd,&fds);		/* also wake up on change */
+  tmo.tv_sec = seconds; tmo.tv_usec = 0;
+				/* see if input available from the socket */
+  if ((i = select (max (sock,fd)+1,&fds,0,&efd,&tmo)) <= 0)
+    return i ? LONGT : NIL;
+  return (FD_ISSET (sock,&fds) || FD_ISSET (sock,&efd)) ? LONGT : -1;
+}
+
 #include "sslstdio.c"
@@ -23,12 +23,15 @@
  *
  */
 
+#include "pout.c"
+
 /* Get character
  * Returns: character or EOF
  */
 
 int PBIN (void)
 {
+  if (pzip) return pzip_bin ();
   if (!sslstdio) {
     int ret;
     do {
@@ -58,6 +61,7 @@ char *PSIN (char *s,int n)
     ssl_server_init (start_tls);/* enter the mode */
     start_tls = NIL;		/* don't do this again */
   }
+  if (pzip) return pzip_sin (s,n);
   if (!sslstdio) {
     char *ret;
     do {
@@ -89,6 +93,7 @@ long PSINR (char *s,unsigned long n)
     ssl_server_init (start_tls);/* enter the mode */
     start_tls = NIL;		/* don't do this again */
   }
+  if (pzip) return pzip_sinr (s,n);
   if (sslstdio) return ssl_getbuffer (sslstdio->sslstream,n,s);
 				/* non-SSL case */
   while (n && ((i = fread (s,1,n,stdin)) || (errno == EINTR))) s += i,n -= i;
@@ -103,79 +108,55 @@ long PSINR (char *s,unsigned long n)
 
 long INWAIT (long seconds)
 {
+  if (pzip && pzip_pending ()) return LONGT;
   return (sslstdio ? ssl_server_input_wait : server_input_wait) (seconds);
 }
-
-/* Put character
- * Accepts: character
- * Returns: character written or EOF
- */
-
-int PBOUT (int c)
-{
-  if (!sslstdio) return putchar (c);
-				/* flush buffer if full */
-  if (!sslstdio->octr && PFLUSH ()) return EOF;
-  sslstdio->octr--;		/* count down one character */
-  *sslstdio->optr++ = c;	/* write character */
-  return c;			/* return that character */
-}
 
 
-/* Put string
- * Accepts: destination string pointer
- * Returns: 0 or EOF if error
+/* Wait for stdin input or mailbox change
+ * Accepts: timeout in seconds
+ *	    descriptor from mail_watch(), or -1
+ * Returns: T if have input on stdin, -1 if change, else NIL
  */
 
-int PSOUT (char *s)
+long INWATCH (long seconds,int fd)
 {
-  if (!sslstdio) return fputs (s,stdout);
-  while (*s) {			/* flush buffer if full */
-    if (!sslstdio->octr && PFLUSH ()) return EOF;
-    *sslstdio->optr++ = *s++;	/* write one more character */
-    sslstdio->octr--;		/* count down one character */
-  }
-  return 0;			/* success */
+  if (pzip && pzip_pending ()) return LONGT;
+  return (sslstdio ? ssl_server_input_watch : server_input_watch)
+    (seconds,fd);
 }
 
-/* Put record
- * Accepts: source sized text
- * Returns: 0 or EOF if error
+/* Write primary output
+ * Accepts: I/O vector
+ *	    I/O vector count
+ * Returns: T if success else NIL
  */
 
-int PSOUTR (SIZEDTEXT *s)
+static long pout_sink (struct iovec *iov,int iovcnt)
 {
-  unsigned char *t = s->data;
-  unsigned long i = s->size;
-  unsigned long j;
-  if (sslstdio) while (i) {	/* until request satisfied */
-				/* flush buffer if full */
-    if (!sslstdio->octr && PFLUSH ()) break;
-				/* blat as big a chucnk as we can */
-    memcpy (sslstdio->optr,t,j = min (i,sslstdio->octr));
-    sslstdio->optr += j;	/* account for chunk */
-    sslstdio->octr -= j;
-    t += j;
-    i -= j;
-  }
-  else while (i && ((j = fwrite (t,1,i,stdout)) || (errno == EINTR)))
-    t += j,i -= j;
-  return i ? EOF : NIL;
+  if (!sslstdio) return pout_writev (1,iov,iovcnt);
+  for (; iovcnt; ++iov,--iovcnt)
+    if (iov->iov_len && !ssl_sout (sslstdio->sslstream,(char *) iov->iov_base,
+				   iov->iov_len)) return NIL;
+  return LONGT;
 }
 
 
-/* Flush output
- * Returns: 0 or EOF if error
+/* Read primary input for decompression
+ * Accepts: buffer
+ *	    maximum number of bytes
+ * Returns: number of bytes read, or 0 if EOF
  */
 
-int PFLUSH (void)
+static long pin_source (char *buf,unsigned long size)
 {
-  if (!sslstdio) return fflush (stdout);
-				/* force out buffer */
-  if (!ssl_sout (sslstdio->sslstream,sslstdio->obuf,
-		 SSLBUFLEN - sslstdio->octr)) return EOF;
-				/* renew output buffer */
-  sslstdio->optr = sslstdio->obuf;
-  sslstdio->octr = SSLBUFLEN;
-  return 0;			/* success */
+  SSLSTREAM *stream;
+  if (sslstdio) {		/* take whatever SSL has decrypted */
+    if (!ssl_getdata (stream = sslstdio->sslstream)) return 0;
+    memcpy (buf,stream->iptr,size = min (size,stream->ictr));
+    stream->iptr += size;
+    stream->ictr -= size;
+    return size;
+  }
+  return pin_stdio (buf,size);
 }
@@ -611,6 +611,25 @@ long tcp_getbuffer (TCPSTREAM *stream,unsigned long size,char *s)
   return LONGT;
 }
 
+/* TCP/IP receive some data
+ * Accepts: TCP/IP stream
+ *	    maximum size in bytes
+ *	    buffer to read into
+ * Returns: number of bytes read, 0 if failure
+ */
+
+unsigned long tcp_getsome (TCPSTREAM *stream,unsigned long size,char *buffer)
+{
+  unsigned long n;
+  if (!tcp_getdata (stream)) return 0;
+  n = min (size,stream->ictr);	/* number of bytes to transfer */
+  memcpy (buffer,stream->iptr,n);
+  stream->iptr += n;
+  stream->ictr -= n;
+  return n;
+}
+
+
 /* TCP/IP receive data
  * Accepts: TCP/IP stream
  * Returns: T if success, NIL otherwise
@@ -953,6 +972,54 @@ long tcp_serverport ()
   if (!myServerHost && !myServerAddr) tcp_serveraddr ();
   return myServerPort;
 }
+
+
+/* TCP/IP listen on service port (server calls only)
+ * Accepts: /etc/services service name
+ *	    vector of listening sockets
+ *	    number of sockets already in vector
+ * Returns: new number of sockets in vector
+ *
+ * A socket is added for each address family which can listen on the port,
+ * so the vector must have room for two more sockets.  The sockets are
+ * non-blocking, so that only one of several processes waiting for a
+ * connection gets it.
+ */
+
+int tcp_listen (char *service,int *fd,int n)
+{
+  static char *wildcard[] = {"::","0.0.0.0",NIL};
+  int i,sock,family;
+  int on = 1;
+  size_t adrlen,len;
+  void *adr;
+  char buf[NI_MAXHOST];
+  struct sockaddr *sadr;
+  struct servent *sv = getservbyname (service,"tcp");
+  if (!sv) syslog (LOG_ERR,"Unknown service %.80s",service);
+  else for (i = 0; wildcard[i]; ++i)
+    if (adr = ip_stringtoaddr (wildcard[i],&adrlen,&family)) {
+      sadr = ip_sockaddr (family,adr,adrlen,ntohs (sv->s_port),&len);
+      if ((sock = socket (sadr->sa_family,SOCK_STREAM,0)) >= 0) {
+	setsockopt (sock,SOL_SOCKET,SO_REUSEADDR,(void *) &on,sizeof (on));
+#ifdef IPV6_V6ONLY		/* separate socket for IPv4 */
+	if (family != AF_INET)
+	  setsockopt (sock,IPPROTO_IPV6,IPV6_V6ONLY,(void *) &on,sizeof (on));
+#endif
+	if (bind (sock,sadr,len) || listen (sock,SOMAXCONN) ||
+	    (fcntl (sock,F_SETFL,fcntl (sock,F_GETFL,0) | O_NONBLOCK) < 0)) {
+	  syslog (LOG_ERR,"Unable to listen on %.80s port %ld: %.80s",
+		  ip_sockaddrtostring (sadr,buf),
+		  (long) ntohs (sv->s_port),strerror (errno));
+	  close (sock);
+	}
+	else fd[n++] = sock;	/* add to vector */
+      }
+      fs_give ((void **) &sadr);
+      fs_give ((void **) &adr);
+    }
+  return n;
+}
 
 /* TCP/IP return canonical form of host name
  * Accepts: host name
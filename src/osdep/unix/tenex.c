@@ -150,7 +150,8 @@ DRIVER tenexdriver = {
   tenex_expunge,		/* expunge deleted messages */
   tenex_copy,			/* copy messages to another mailbox */
   tenex_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -364,6 +365,11 @@ long tenex_status (MAILSTREAM *stream,char *mbx,long flags)
   unsigned long i;
   MAILSTREAM *tstream = NIL;
   MAILSTREAM *systream = NIL;
+  char tmp[MAILTMPLEN];
+				/* cached unless INBOX, which may snarf */
+  if (!stream && mail_parameters (NIL,GET_STATUSCACHEDIR,NIL) &&
+      compare_cstring (mbx,"INBOX") && tenex_file (tmp,mbx))
+    return statuscache_status (stream,mbx,flags,tmp,NIL);
 				/* make temporary stream (unless this mbx) */
   if (!stream && !(stream = tstream =
 		   mail_open (NIL,mbx,OP_READONLY|OP_SILENT))) return NIL;
@@ -375,6 +381,7 @@ long tenex_status (MAILSTREAM *stream,char *mbx,long flags)
       if (!mail_elt (stream,i)->seen) status.unseen++;
   status.uidnext = stream->uid_last + 1;
   status.uidvalidity = stream->uid_validity;
+  status.highestmodseq = 0;	/* no modsequences */
 				/* calculate post-snarf results */
   if (!status.recent && stream->inbox &&
       (systream = mail_open (NIL,sysinbox (),OP_READONLY|OP_SILENT))) {
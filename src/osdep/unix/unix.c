@@ -46,12 +46,28 @@ extern int errno;		/* just in case */
 #include "osdep.h"
 #include <time.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include "unix.h"
 #include "pseudo.h"
 #include "fdstring.h"
 #include "misc.h"
 #include "dummy.h"
 
+/* UNIX mapped message text
+ *
+ * Message text read via the mapped file string driver is converted to CRLF
+ * form a chunk at a time as it is read rather than all at once.
+ */
+
+typedef struct unix_map_text {
+  unsigned char *text;		/* start of message text in mapped file */
+  unsigned long size;		/* size of message text in file */
+  unsigned long pos;		/* file text position after current chunk */
+  unsigned long end;		/* string position after current chunk */
+  char chunk[CHUNKSIZE];	/* current chunk in CRLF form */
+} UNIXMAPTEXT;
+
+
 /* UNIX I/O stream local data */
 
 typedef struct unix_local {
@@ -59,8 +75,10 @@ typedef struct unix_local {
   unsigned int ddirty : 1;	/* double-dirty, ping becomes checkpoint */
   unsigned int pseudo : 1;	/* uses a pseudo message */
   unsigned int appending : 1;	/* don't mark new messages as old */
+  unsigned int idxvalid : 1;	/* index file matches parsed mailbox */
   int fd;			/* mailbox file descriptor */
   int ld;			/* lock file descriptor */
+  int wd;			/* change watch descriptor */
   char *lname;			/* lock file name */
   off_t filesize;		/* file size parsed */
   time_t filetime;		/* last file time */
@@ -73,6 +91,13 @@ typedef struct unix_local {
   char *line;			/* returned line */
   char *linebuf;		/* line readin buffer */
   unsigned long linebuflen;	/* current line readin buffer length */
+  unsigned long idxmsgs;	/* number of messages in index file */
+  off_t idxsize;		/* mailbox size covered by index file */
+  unsigned long idxuf;		/* keywords known to index file */
+  unsigned char *map;		/* mapped mailbox file */
+  unsigned long mapsize;	/* size of mapped mailbox file */
+  UNIXMAPTEXT *maptext;		/* mapped message text string data */
+  unsigned long sortcacheseq;	/* sort cache sequence */
 } UNIXLOCAL;
 
 
@@ -93,6 +118,48 @@ typedef struct unix_file {
   char *bufpos;			/* current buffer position */
 } UNIXFILE;
 
+/* UNIX mailbox index file
+ *
+ * The index file is a private cache of the results of parsing a mailbox, so
+ * that a subsequent open need only parse data appended since the index was
+ * written.  It is in native byte order and is discarded and rebuilt if it
+ * fails any consistency check.
+ */
+
+#define UNIXINDEXMAGIC "uxindex1"
+#define UNIXINDEXTAIL 64	/* mailbox tail saved to validate appends */
+
+typedef struct unix_index_header {
+  char magic[8];		/* UNIXINDEXMAGIC */
+  unsigned long recsize;	/* size of a message record */
+  unsigned long dev;		/* device of mailbox */
+  unsigned long ino;		/* inode of mailbox */
+  unsigned long filesize;	/* mailbox size covered by index */
+  unsigned long filetime;	/* mailbox mtime if size still filesize */
+  unsigned long uid_validity;	/* mailbox UID validity */
+  unsigned long uid_last;	/* mailbox last UID */
+  unsigned long nmsgs;		/* number of message records */
+  unsigned long pseudo;		/* non-zero if mailbox has pseudo-message */
+  char tail[UNIXINDEXTAIL];	/* last bytes of covered mailbox data */
+  char keywords[NUSERFLAGS][MAXUSERFLAG+1];
+} UNIXINDEXHDR;
+
+typedef struct unix_index_record {
+  unsigned long offset;		/* internal header offset */
+  unsigned long ihdrsize;	/* internal header size */
+  unsigned long hdrsize;	/* header size, including status lines */
+  unsigned long textoffset;	/* text offset from internal header */
+  unsigned long textsize;	/* text size */
+  unsigned long xhdrsize;	/* header size, sans status lines */
+  unsigned long rfc822_size;	/* RFC822 size */
+  unsigned long uid;		/* message UID */
+  unsigned long user_flags;	/* keywords */
+  unsigned int date;		/* internal date */
+  unsigned int time;		/* internal time and zone */
+  unsigned int flags;		/* system flags as on disk */
+  unsigned int spare;		/* reserved */
+} UNIXINDEXREC;
+
 /* Function prototypes */
 
 DRIVER *unix_valid (char *name);
@@ -104,6 +171,7 @@ void unix_lsub (MAILSTREAM *stream,char *ref,char *pat);
 long unix_create (MAILSTREAM *stream,char *mailbox);
 long unix_delete (MAILSTREAM *stream,char *mailbox);
 long unix_rename (MAILSTREAM *stream,char *old,char *newname);
+long unix_status (MAILSTREAM *stream,char *mbx,long flags);
 MAILSTREAM *unix_open (MAILSTREAM *stream);
 void unix_close (MAILSTREAM *stream,long options);
 char *unix_header (MAILSTREAM *stream,unsigned long msgno,
@@ -112,8 +180,13 @@ long unix_text (MAILSTREAM *stream,unsigned long msgno,STRING *bs,long flags);
 char *unix_text_work (MAILSTREAM *stream,MESSAGECACHE *elt,
 		      unsigned long *length,long flags);
 void unix_flagmsg (MAILSTREAM *stream,MESSAGECACHE *elt);
+unsigned long *unix_sort (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
+			 SORTPGM *pgm,long flags);
+THREADNODE *unix_thread (MAILSTREAM *stream,char *type,char *charset,
+			SEARCHPGM *spg,long flags);
 long unix_ping (MAILSTREAM *stream);
 void unix_check (MAILSTREAM *stream);
+int unix_watch (MAILSTREAM *stream);
 long unix_expunge (MAILSTREAM *stream,char *sequence,long options);
 long unix_copy (MAILSTREAM *stream,char *sequence,char *mailbox,long options);
 long unix_append (MAILSTREAM *stream,char *mailbox,append_t af,void *data);
@@ -135,6 +208,19 @@ long unix_rewrite (MAILSTREAM *stream,unsigned long *nexp,DOTLOCK *lock,
 long unix_extend (MAILSTREAM *stream,unsigned long size);
 void unix_write (UNIXFILE *f,char *s,unsigned long i);
 void unix_phys_write (UNIXFILE *f,char *buf,size_t size);
+char *unix_index_file (char *dst,struct stat *sbuf);
+long unix_index_load (MAILSTREAM *stream,struct stat *sbuf);
+void unix_index_update (MAILSTREAM *stream,unsigned long nmsgs,off_t size);
+void unix_index_write (MAILSTREAM *stream,unsigned long msgno,long rewrite);
+void unix_index_record (MAILSTREAM *stream,MESSAGECACHE *elt,
+			UNIXINDEXREC *rec,long recent);
+void unix_index_touch (MAILSTREAM *stream);
+unsigned char *unix_map (MAILSTREAM *stream,unsigned long pos,
+			 unsigned long size);
+void unix_unmap (MAILSTREAM *stream);
+void unix_map_string_init (STRING *s,void *data,unsigned long size);
+char unix_map_string_next (STRING *s);
+void unix_map_string_setpos (STRING *s,unsigned long i);
 
 /* mbox mail routines */
 
@@ -172,7 +258,7 @@ DRIVER unixdriver = {
   unix_create,			/* create mailbox */
   unix_delete,			/* delete mailbox */
   unix_rename,			/* rename mailbox */
-  mail_status_default,		/* status of mailbox */
+  unix_status,			/* status of mailbox */
   unix_open,			/* open mailbox */
   unix_close,			/* close mailbox */
   NIL,				/* fetch message "fast" attributes */
@@ -187,14 +273,15 @@ DRIVER unixdriver = {
   NIL,				/* modify flags */
   unix_flagmsg,			/* per-message modify flags */
   NIL,				/* search for message based on criteria */
-  NIL,				/* sort messages */
-  NIL,				/* thread messages */
+  unix_sort,			/* sort messages */
+  unix_thread,			/* thread messages */
   unix_ping,			/* ping mailbox to see if still alive */
   unix_check,			/* check for new messages */
   unix_expunge,			/* expunge deleted messages */
   unix_copy,			/* copy messages to another mailbox */
   unix_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  unix_watch			/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -202,6 +289,15 @@ MAILSTREAM unixproto = {&unixdriver};
 
 				/* driver parameters */
 static long unix_fromwidget = T;
+static char *unix_indexdir = NIL;
+static long unix_mmap = NIL;
+
+				/* mapped message text string driver */
+STRINGDRIVER unix_map_string = {
+  unix_map_string_init,		/* initialize string structure */
+  unix_map_string_next,		/* get next byte in string structure */
+  unix_map_string_setpos	/* set position in string structure */
+};
 
 /* UNIX mail validate mailbox
  * Accepts: mailbox name
@@ -274,6 +370,17 @@ void *unix_parameters (long function,void *value)
   case GET_FROMWIDGET:
     ret = (void *) unix_fromwidget;
     break;
+  case SET_UNIXINDEXDIR:
+    if (unix_indexdir) fs_give ((void **) &unix_indexdir);
+    if (value) unix_indexdir = cpystr ((char *) value);
+  case GET_UNIXINDEXDIR:
+    ret = (void *) unix_indexdir;
+    break;
+  case SET_UNIXMMAP:
+    unix_mmap = (long) value;
+  case GET_UNIXMMAP:
+    ret = (void *) unix_mmap;
+    break;
   }
   return ret;
 }
@@ -436,7 +543,11 @@ long unix_rename (MAILSTREAM *stream,char *old,char *newname)
       }
       else if (unlink (file))
 	sprintf (tmp,"Can't delete mailbox %.80s: %s",old,strerror (errno));
-      else ret = T;		/* set success */
+      else {			/* set success */
+	ret = T;
+				/* flush its index too */
+	if (!fstat (fd,&sbuf) && unix_index_file (tmp,&sbuf)) unlink (tmp);
+      }
       unix_unlock (fd,NIL,&lockx);
     }
     unix_unlock (ld,NIL,NIL);	/* flush the lock */
@@ -447,6 +558,21 @@ long unix_rename (MAILSTREAM *stream,char *old,char *newname)
   return ret;			/* return success or failure */
 }
 
+/* UNIX mail status
+ * Accepts: mail stream
+ *	    mailbox name
+ *	    status flags
+ * Returns: T on success, NIL on failure
+ */
+
+long unix_status (MAILSTREAM *stream,char *mbx,long flags)
+{
+  char tmp[MAILTMPLEN];
+  return dummy_file (tmp,mbx) ?
+    statuscache_status (stream,mbx,flags,tmp,NIL) :
+    mail_status_default (stream,mbx,flags);
+}
+
 /* UNIX mail open
  * Accepts: Stream to open
  * Returns: Stream on success, NIL on failure
@@ -464,6 +590,7 @@ MAILSTREAM *unix_open (MAILSTREAM *stream)
   retry = stream->silent ? 1 : KODRETRY;
   if (stream->local) fatal ("unix recycle stream");
   stream->local = memset (fs_get (sizeof (UNIXLOCAL)),0,sizeof (UNIXLOCAL));
+  LOCAL->wd = -1;		/* not watching for changes yet */
 				/* note if an INBOX or not */
   stream->inbox = !compare_cstring (stream->mailbox,"INBOX");
 				/* canonicalize the stream mailbox name */
@@ -592,7 +719,7 @@ char *unix_header (MAILSTREAM *stream,unsigned long msgno,
 		   unsigned long *length,long flags)
 {
   MESSAGECACHE *elt;
-  unsigned char *s,*t,*tl;
+  unsigned char *s,*t,*tl,*m;
   *length = 0;			/* default to empty */
   if (flags & FT_UID) return "";/* UID call "impossible" */
   elt = mail_elt (stream,msgno);/* get cache */
@@ -616,9 +743,13 @@ char *unix_header (MAILSTREAM *stream,unsigned long msgno,
     lines->text.size = strlen ((char *) (lines->text.data =
 					 (unsigned char *) "X-IMAPbase"));
   }
+				/* header in mapped file? */
+  m = unix_map (stream,elt->private.special.offset +
+		elt->private.msg.header.offset,
+		elt->private.msg.header.text.size);
 				/* go to header position */
-  lseek (LOCAL->fd,elt->private.special.offset +
-	 elt->private.msg.header.offset,L_SET);
+  if (!m) lseek (LOCAL->fd,elt->private.special.offset +
+		 elt->private.msg.header.offset,L_SET);
 
   if (flags & FT_INTERNAL) {	/* initial data OK? */
     if (elt->private.msg.header.text.size > LOCAL->buflen) {
@@ -627,12 +758,28 @@ char *unix_header (MAILSTREAM *stream,unsigned long msgno,
 				     elt->private.msg.header.text.size) + 1);
     }
 				/* read message */
-    read (LOCAL->fd,LOCAL->buf,elt->private.msg.header.text.size);
-				/* got text, tie off string */
-    LOCAL->buf[*length = elt->private.msg.header.text.size] = '\0';
+    if (!m) read (LOCAL->fd,m = LOCAL->buf,elt->private.msg.header.text.size);
 				/* squeeze out CRs (in case from PC) */
-    for (s = t = LOCAL->buf,tl = LOCAL->buf + *length; t < tl; t++)
-      if (*t != '\r') *s++ = *t;
+    for (s = LOCAL->buf,t = m,tl = m + elt->private.msg.header.text.size;
+	 t < tl; t++) if (*t != '\r') *s++ = *t;
+    *s = '\0';
+    *length = s - LOCAL->buf;	/* adjust length */
+  }
+  else if (m) {			/* make CRLF version straight from file */
+    if ((elt->private.msg.header.text.size * 2) > LOCAL->buflen) {
+      fs_give ((void **) &LOCAL->buf);
+      LOCAL->buf = (char *) fs_get ((LOCAL->buflen =
+				     elt->private.msg.header.text.size * 2)+1);
+    }
+    for (s = LOCAL->buf,tl = m + elt->private.msg.header.text.size; m < tl;
+	 m++) switch (*m) {
+    case '\r':			/* squeeze out CRs */
+      break;
+    case '\n':			/* insert a CR */
+      *s++ = '\r';
+    default:
+      *s++ = *m;		/* copy characters */
+    }
     *s = '\0';
     *length = s - LOCAL->buf;	/* adjust length */
   }
@@ -676,8 +823,22 @@ long unix_text (MAILSTREAM *stream,unsigned long msgno,STRING *bs,long flags)
     elt->seen = elt->private.dirty = LOCAL->dirty = T;
     MM_FLAGS (stream,msgno);
   }
-  s = unix_text_work (stream,elt,&i,flags);
-  INIT (bs,mail_string,s,i);	/* set up stringstruct */
+				/* can hand back text from mapped file? */
+  if ((flags & FT_RETURNSTRINGSTRUCT) && !(flags & FT_INTERNAL) &&
+      (elt->private.uid != LOCAL->uid) &&
+      (s = (char *) unix_map (stream,elt->private.special.offset +
+			      elt->private.msg.text.offset,
+			      elt->private.msg.text.text.size))) {
+    if (!LOCAL->maptext)
+      LOCAL->maptext = (UNIXMAPTEXT *) fs_get (sizeof (UNIXMAPTEXT));
+    LOCAL->maptext->text = (unsigned char *) s;
+    LOCAL->maptext->size = elt->private.msg.text.text.size;
+    INIT (bs,unix_map_string,LOCAL->maptext,NIL);
+  }
+  else {
+    s = unix_text_work (stream,elt,&i,flags);
+    INIT (bs,mail_string,s,i);	/* set up stringstruct */
+  }
   return T;			/* success */
 }
 
@@ -693,23 +854,24 @@ char *unix_text_work (MAILSTREAM *stream,MESSAGECACHE *elt,
 {
   FDDATA d;
   STRING bs;
-  unsigned char c,*s,*t,*tl,tmp[CHUNKSIZE];
-				/* go to text position */
-  lseek (LOCAL->fd,elt->private.special.offset +
-	 elt->private.msg.text.offset,L_SET);
+  unsigned char c,*s,*t,*tl,*m,tmp[CHUNKSIZE];
+				/* text in mapped file? */
+  m = unix_map (stream,elt->private.special.offset +
+		elt->private.msg.text.offset,elt->private.msg.text.text.size);
   if (flags & FT_INTERNAL) {	/* initial data OK? */
     if (elt->private.msg.text.text.size > LOCAL->buflen) {
       fs_give ((void **) &LOCAL->buf);
       LOCAL->buf = (char *) fs_get ((LOCAL->buflen =
 				     elt->private.msg.text.text.size) + 1);
     }
-				/* read message */
-    read (LOCAL->fd,LOCAL->buf,elt->private.msg.text.text.size);
-				/* got text, tie off string */
-    LOCAL->buf[*length = elt->private.msg.text.text.size] = '\0';
+    if (!m) {			/* read message */
+      lseek (LOCAL->fd,elt->private.special.offset +
+	     elt->private.msg.text.offset,L_SET);
+      read (LOCAL->fd,m = LOCAL->buf,elt->private.msg.text.text.size);
+    }
 				/* squeeze out CRs (in case from PC) */
-    for (s = t = LOCAL->buf,tl = LOCAL->buf + *length; t < tl; t++)
-      if (*t != '\r') *s++ = *t;
+    for (s = LOCAL->buf,t = m,tl = m + elt->private.msg.text.text.size;
+	 t < tl; t++) if (*t != '\r') *s++ = *t;
     *s = '\0';
     *length = s - LOCAL->buf;	/* adjust length */
     return (char *) LOCAL->buf;
@@ -726,18 +888,31 @@ char *unix_text_work (MAILSTREAM *stream,MESSAGECACHE *elt,
       LOCAL->text.data = (unsigned char *)
 	fs_get ((LOCAL->text.size = elt->rfc822_size) + 1);
     }
-    d.fd = LOCAL->fd;		/* yes, set up file descriptor */
-    d.pos = elt->private.special.offset + elt->private.msg.text.offset;
-    d.chunk = tmp;		/* initial buffer chunk */
-    d.chunksize = CHUNKSIZE;	/* file chunk size */
-    INIT (&bs,fd_string,&d,elt->private.msg.text.text.size);
-    for (s = (char *) LOCAL->text.data; SIZE (&bs);) switch (c = SNX (&bs)) {
-    case '\r':			/* carriage return seen */
-      break;
-    case '\n':
-      *s++ = '\r';		/* insert a CR */
-    default:
-      *s++ = c;			/* copy characters */
+    if (m) for (s = (char *) LOCAL->text.data,
+		tl = m + elt->private.msg.text.text.size; m < tl; m++)
+      switch (c = *m) {		/* copy straight from mapped file */
+      case '\r':		/* carriage return seen */
+	break;
+      case '\n':
+	*s++ = '\r';		/* insert a CR */
+      default:
+	*s++ = c;		/* copy characters */
+      }
+    else {			/* set up file descriptor */
+      d.fd = LOCAL->fd;
+      d.pos = elt->private.special.offset + elt->private.msg.text.offset;
+      d.chunk = tmp;		/* initial buffer chunk */
+      d.chunksize = CHUNKSIZE;	/* file chunk size */
+      INIT (&bs,fd_string,&d,elt->private.msg.text.text.size);
+      for (s = (char *) LOCAL->text.data; SIZE (&bs);)
+	switch (c = SNX (&bs)) {
+	case '\r':		/* carriage return seen */
+	  break;
+	case '\n':
+	  *s++ = '\r';		/* insert a CR */
+	default:
+	  *s++ = c;		/* copy characters */
+	}
     }
     *s = '\0';			/* tie off buffer */
 				/* calculate length of cached data */
@@ -757,6 +932,53 @@ void unix_flagmsg (MAILSTREAM *stream,MESSAGECACHE *elt)
 				/* only after finishing */
   if (elt->valid) elt->private.dirty = LOCAL->dirty = T;
 }
+
+/* UNIX mail sort messages
+ * Accepts: mail stream
+ *	    character set
+ *	    search program
+ *	    sort program
+ *	    option flags
+ * Returns: vector of sorted message sequences or NIL if error
+ */
+
+unsigned long *unix_sort (MAILSTREAM *stream,char *charset,SEARCHPGM *spg,
+			 SORTPGM *pgm,long flags)
+{
+  unsigned long *ret;
+  struct stat sbuf;
+  FILE *sortcache = !stat (stream->mailbox,&sbuf) ?
+    sortcache_open (stream,&sbuf,stream->uid_validity,
+		    &LOCAL->sortcacheseq) : NIL;
+  ret = mail_sort_msgs (stream,charset,spg,pgm,flags);
+  sortcache_update (stream,&sortcache,stream->uid_validity,
+		    &LOCAL->sortcacheseq);
+  return ret;
+}
+
+
+/* UNIX mail thread messages
+ * Accepts: mail stream
+ *	    thread type
+ *	    character set
+ *	    search program
+ *	    option flags
+ * Returns: thread node tree or NIL if error
+ */
+
+THREADNODE *unix_thread (MAILSTREAM *stream,char *type,char *charset,
+			SEARCHPGM *spg,long flags)
+{
+  THREADNODE *ret;
+  struct stat sbuf;
+  FILE *sortcache = !stat (stream->mailbox,&sbuf) ?
+    sortcache_open (stream,&sbuf,stream->uid_validity,
+		    &LOCAL->sortcacheseq) : NIL;
+  ret = mail_thread_msgs (stream,type,charset,spg,flags,mail_sort_msgs);
+  sortcache_update (stream,&sortcache,stream->uid_validity,
+		    &LOCAL->sortcacheseq);
+  return ret;
+}
 
 
 /* UNIX mail ping mailbox
@@ -828,6 +1050,17 @@ void unix_check (MAILSTREAM *stream)
 }
 
 
+/* UNIX mail watch mailbox
+ * Accepts: MAIL stream
+ * Returns: descriptor readable when mailbox file changes, or -1
+ */
+
+int unix_watch (MAILSTREAM *stream)
+{
+  return LOCAL ? watch_file (&LOCAL->wd,stream->mailbox,LONGT) : -1;
+}
+
+
 /* UNIX mail expunge mailbox
  * Accepts: MAIL stream
  *	    sequence to expunge if non-NIL
@@ -1336,18 +1569,21 @@ int unix_append_msgs (MAILSTREAM *stream,FILE *sf,FILE *df,SEARCHSET *set)
 void unix_abort (MAILSTREAM *stream)
 {
   if (LOCAL) {			/* only if a file is open */
+    unix_unmap (stream);	/* flush any file mapping */
     if (LOCAL->fd >= 0) close (LOCAL->fd);
     if (LOCAL->ld >= 0) {	/* have a mailbox lock? */
       flock (LOCAL->ld,LOCK_UN);/* yes, release the lock */
       close (LOCAL->ld);	/* close the lock file */
       unlink (LOCAL->lname);	/* and delete it */
     }
+    if (LOCAL->wd >= 0) close (LOCAL->wd);
     if (LOCAL->lname) fs_give ((void **) &LOCAL->lname);
 				/* free local text buffers */
     if (LOCAL->buf) fs_give ((void **) &LOCAL->buf);
     if (LOCAL->text.data) fs_give ((void **) &LOCAL->text.data);
     if (LOCAL->linebuf) fs_give ((void **) &LOCAL->linebuf);
     if (LOCAL->line) fs_give ((void **) &LOCAL->line);
+    if (LOCAL->maptext) fs_give ((void **) &LOCAL->maptext);
 				/* nuke the local data */
     fs_give ((void **) &stream->local);
     stream->dtb = NIL;		/* log out the DTB */
@@ -1421,7 +1657,10 @@ void unix_unlock (int fd,MAILSTREAM *stream,DOTLOCK *lock)
     }
     else now = 0;		/* no time change needed */
 				/* set the times, note change */
-    if (now && !utime (stream->mailbox,tp)) LOCAL->filetime = tp[1];
+    if (now && !utime (stream->mailbox,tp)) {
+      LOCAL->filetime = tp[1];
+      unix_index_touch (stream);/* index must follow mtime */
+    }
   }
   flock (fd,LOCK_UN);		/* release flock'ers */
   if (!stream) close (fd);	/* close the file if no stream */
@@ -1445,6 +1684,8 @@ int unix_parse (MAILSTREAM *stream,DOTLOCK *lock,int op)
   unsigned long prevuid = nmsgs ? mail_elt (stream,nmsgs)->private.uid : 0;
   unsigned long recent = stream->recent;
   unsigned long oldnmsgs = stream->nmsgs;
+  unsigned long basemsgs;
+  off_t basesize;
   short silent = stream->silent;
   short pseudoseen = NIL;
   struct stat sbuf;
@@ -1453,6 +1694,7 @@ int unix_parse (MAILSTREAM *stream,DOTLOCK *lock,int op)
   MESSAGECACHE *elt;
   mail_lock (stream);		/* guard against recursion or pingers */
 				/* toss out previous descriptor */
+  unix_unmap (stream);
   if (LOCAL->fd >= 0) close (LOCAL->fd);
   MM_CRITICAL (stream);		/* open and lock mailbox (shared OK) */
   if ((LOCAL->fd = unix_lock (stream->mailbox,(LOCAL->ld >= 0) ?
@@ -1467,6 +1709,15 @@ int unix_parse (MAILSTREAM *stream,DOTLOCK *lock,int op)
     return NIL;
   }
   fstat (LOCAL->fd,&sbuf);	/* get status */
+				/* first parse, try to use mailbox index */
+  if (!(LOCAL->filesize || stream->nmsgs || stream->sniff) &&
+      unix_index_load (stream,&sbuf)) {
+    oldnmsgs = nmsgs = stream->nmsgs;
+    prevuid = nmsgs ? mail_elt (stream,nmsgs)->private.uid : 0;
+    recent = stream->recent;
+  }
+  basemsgs = nmsgs;		/* note state before parsing new data */
+  basesize = LOCAL->filesize;
 				/* validate change in size */
   if (sbuf.st_size < LOCAL->filesize) {
     sprintf (tmp,"Mailbox shrank from %lu to %lu bytes, aborted",
@@ -1863,6 +2114,8 @@ int unix_parse (MAILSTREAM *stream,DOTLOCK *lock,int op)
 				/* update parsed file size and time */
   LOCAL->filesize = sbuf.st_size;
   LOCAL->filetime = sbuf.st_mtime;
+				/* record new messages in index */
+  if (!stream->sniff) unix_index_update (stream,basemsgs,basesize);
   return T;			/* return the winnage */
 }
 
@@ -2236,6 +2489,7 @@ long unix_rewrite (MAILSTREAM *stream,unsigned long *nexp,DOTLOCK *lock,
     if (size != f.filepos) fatal ("file size inconsistent");
     fs_give ((void **) &f.buf);	/* free buffer */
 				/* make sure tied off */
+    unix_unmap (stream);	/* don't map beyond the new end of file */
     ftruncate (LOCAL->fd,LOCAL->filesize = size);
     fsync (LOCAL->fd);		/* make sure the updates take */
     if (size && (flag < 0)) fatal ("lost UID base information");
@@ -2256,6 +2510,8 @@ long unix_rewrite (MAILSTREAM *stream,unsigned long *nexp,DOTLOCK *lock,
       MM_LOG (LOCAL->buf,ERROR);
       unix_abort (stream);
     }
+				/* disk now matches cache, rebuild index */
+    else unix_index_write (stream,0,T);
     dotlock_unlock (lock);	/* flush the lock file */
   }
   return ret;			/* return state from algorithm */
@@ -2401,6 +2657,455 @@ void unix_phys_write (UNIXFILE *f,char *buf,size_t size)
   }
   f->filepos += size;		/* update file position */
 }
+
+/* UNIX mailbox index file name
+ * Accepts: destination buffer
+ *	    mailbox file status
+ * Returns: index file name, NIL if not indexing
+ */
+
+char *unix_index_file (char *dst,struct stat *sbuf)
+{
+  struct stat dbuf;
+  if (!unix_indexdir ||
+      ((strlen (unix_indexdir) + strlen (myhomedir ())) > (MAILTMPLEN - 40)))
+    return NIL;
+				/* relative names are in home directory */
+  if (*unix_indexdir == '/') strcpy (dst,unix_indexdir);
+  else sprintf (dst,"%s/%s",myhomedir (),unix_indexdir);
+				/* create index directory if necessary */
+  if (stat (dst,&dbuf) && mkdir (dst,S_IRWXU)) return NIL;
+				/* index named by mailbox device and inode */
+  sprintf (dst + strlen (dst),"/%lx.%lx",(unsigned long) sbuf->st_dev,
+	   (unsigned long) sbuf->st_ino);
+  return dst;
+}
+
+/* UNIX load mailbox index
+ * Accepts: MAIL stream, must be critical and locked
+ *	    mailbox file status
+ * Returns: T if messages instantiated from index, NIL if no usable index
+ */
+
+long unix_index_load (MAILSTREAM *stream,struct stat *sbuf)
+{
+  int fd,ti,zn;
+  unsigned long i,j,size;
+  char *s,*t,*base,c,tmp[MAILTMPLEN];
+  short silent = stream->silent;
+  struct stat ibuf;
+  UNIXINDEXHDR *hdr;
+  UNIXINDEXREC *rec;
+  MESSAGECACHE *elt;
+  long ret = NIL;
+  if (!unix_index_file (tmp,sbuf) || ((fd = open (tmp,O_RDONLY,NIL)) < 0))
+    return NIL;
+  flock (fd,LOCK_SH);		/* don't read while it is being written */
+  if (!fstat (fd,&ibuf) && (ibuf.st_uid == geteuid ()) &&
+      ((size = ibuf.st_size) >= sizeof (UNIXINDEXHDR)) &&
+      ((base = (char *) mmap (NIL,size,PROT_READ,MAP_SHARED,fd,0)) !=
+       (char *) MAP_FAILED)) {
+    hdr = (UNIXINDEXHDR *) base;
+    rec = (UNIXINDEXREC *) (base + sizeof (UNIXINDEXHDR));
+    if (!memcmp (hdr->magic,UNIXINDEXMAGIC,8) &&
+	(hdr->recsize == sizeof (UNIXINDEXREC)) &&
+	(hdr->dev == (unsigned long) sbuf->st_dev) &&
+	(hdr->ino == (unsigned long) sbuf->st_ino) && hdr->uid_validity &&
+	(hdr->nmsgs <= ((size - sizeof (UNIXINDEXHDR)) /
+			sizeof (UNIXINDEXREC))) &&
+				/* mailbox unchanged or appended to */
+	(((hdr->filesize == sbuf->st_size) &&
+	  (hdr->filetime == sbuf->st_mtime)) ||
+	 (hdr->filesize < sbuf->st_size))) {
+				/* make sure covered data still there */
+      j = min (hdr->filesize,UNIXINDEXTAIL);
+      lseek (LOCAL->fd,hdr->filesize - j,L_SET);
+      ret = (read (LOCAL->fd,tmp,j) == j) && !memcmp (tmp,hdr->tail,j);
+      if (ret && (hdr->filesize < sbuf->st_size)) {
+				/* appended data must start a message */
+	memset (tmp,'\0',MAILTMPLEN);
+	lseek (LOCAL->fd,hdr->filesize,L_SET);
+	ret = NIL;
+	if (read (LOCAL->fd,tmp,MAILTMPLEN-1) > 0) {
+	  for (s = tmp; ((c = *s) == '\n') || (c == '\r') || (c == ' ') ||
+		 (c == '\t'); s++);
+	  VALID (s,t,ti,zn);
+	  ret = ti ? LONGT : NIL;
+	}
+      }
+				/* keywords must be tied off */
+      for (i = 0; ret && (i < NUSERFLAGS); ++i)
+	if (hdr->keywords[i][MAXUSERFLAG]) ret = NIL;
+    }
+
+    if (ret) {			/* index is good, instantiate messages */
+      stream->silent = T;	/* quell main program new message events */
+      mail_exists (stream,hdr->nmsgs);
+      for (i = 1,j = 0; i <= hdr->nmsgs; ++i,++rec) {
+	(elt = mail_elt (stream,i))->valid = T;
+	elt->private.special.offset = rec->offset;
+	elt->private.msg.header.offset = elt->private.special.text.size =
+	  rec->ihdrsize;
+	elt->private.msg.header.text.size = rec->hdrsize;
+	elt->private.msg.text.offset = rec->textoffset;
+	elt->private.msg.text.text.size = rec->textsize;
+	elt->private.spare.data = rec->xhdrsize;
+	elt->rfc822_size = rec->rfc822_size;
+	elt->private.uid = rec->uid;
+	elt->user_flags = rec->user_flags;
+	elt->day = rec->date & 0x1f;
+	elt->month = (rec->date >> 5) & 0xf;
+	elt->year = (rec->date >> 9) & 0x7f;
+	elt->hours = rec->time & 0x1f;
+	elt->minutes = (rec->time >> 5) & 0x3f;
+	elt->seconds = (rec->time >> 11) & 0x3f;
+	elt->zoccident = (rec->time >> 17) & 0x1;
+	elt->zhours = (rec->time >> 18) & 0xf;
+	elt->zminutes = (rec->time >> 22) & 0x3f;
+	elt->seen = (rec->flags & fSEEN) ? T : NIL;
+	elt->deleted = (rec->flags & fDELETED) ? T : NIL;
+	elt->flagged = (rec->flags & fFLAGGED) ? T : NIL;
+	elt->answered = (rec->flags & fANSWERED) ? T : NIL;
+	elt->draft = (rec->flags & fDRAFT) ? T : NIL;
+				/* recent if not marked old, as in parse */
+	if (elt->private.dirty = elt->recent = (rec->flags & fOLD) ? NIL : T)
+	  ++j;
+      }
+				/* keywords from mailbox base */
+      for (i = 0,LOCAL->idxuf = 0; i < NUSERFLAGS; ++i)
+	if (hdr->keywords[i][0]) {
+	  if (stream->user_flags[i]) fs_give ((void **) &stream->user_flags[i]);
+	  stream->user_flags[i] = cpystr (hdr->keywords[i]);
+	  LOCAL->idxuf |= ((unsigned long) 1) << i;
+	}
+      stream->uid_validity = hdr->uid_validity;
+      stream->uid_last = hdr->uid_last;
+      LOCAL->pseudo = hdr->pseudo ? T : NIL;
+				/* parse resumes from here */
+      LOCAL->filesize = LOCAL->idxsize = hdr->filesize;
+      LOCAL->idxmsgs = hdr->nmsgs;
+      LOCAL->idxvalid = T;
+      stream->silent = silent;	/* restore old silent setting */
+				/* notify upper level of new mailbox sizes */
+      mail_exists (stream,hdr->nmsgs);
+      mail_recent (stream,j);
+				/* mark dirty so O flags are set */
+      if (j) LOCAL->dirty = T;
+    }
+    munmap (base,size);		/* done with index */
+  }
+  flock (fd,LOCK_UN);		/* release index */
+  close (fd);
+  return ret;
+}
+
+/* UNIX update mailbox index after parse
+ * Accepts: MAIL stream
+ *	    number of messages before parse
+ *	    mailbox size before parse
+ */
+
+void unix_index_update (MAILSTREAM *stream,unsigned long nmsgs,off_t size)
+{
+				/* can't index data not yet on disk */
+  if (!unix_indexdir || LOCAL->ddirty || stream->uid_nosticky ||
+      !stream->uid_validity) LOCAL->idxvalid = NIL;
+				/* index current up to this parse? */
+  else if (LOCAL->idxvalid && (LOCAL->idxmsgs == nmsgs) &&
+	   (LOCAL->idxsize == size)) {
+				/* yes, append anything new */
+    if (LOCAL->filesize != size) unix_index_write (stream,nmsgs + 1,NIL);
+  }
+				/* first parse, build index from scratch */
+  else if (!(nmsgs || size)) unix_index_write (stream,0,NIL);
+}
+
+/* UNIX write mailbox index
+ * Accepts: MAIL stream
+ *	    first message to append, or zero to write entire index
+ *	    non-zero if cache was just written to disk by rewrite
+ */
+
+#define INDEXBUFRECS 1024	/* records per index write */
+
+void unix_index_write (MAILSTREAM *stream,unsigned long msgno,long rewrite)
+{
+  int fd;
+  unsigned long i,j;
+  char tmp[MAILTMPLEN];
+  struct stat sbuf;
+  UNIXINDEXHDR hdr;
+  UNIXINDEXREC *recs;
+  long ret = LONGT;
+  LOCAL->idxvalid = NIL;	/* invalid unless written */
+  if (!stream->uid_validity || stream->uid_nosticky ||
+      fstat (LOCAL->fd,&sbuf) || !unix_index_file (tmp,&sbuf) ||
+      ((fd = open (tmp,msgno ? O_RDWR : O_RDWR|O_CREAT,S_IRUSR|S_IWUSR)) < 0))
+    return;
+  flock (fd,LOCK_EX);		/* exclusive access to index */
+  if (msgno) {			/* appending, index must be as we left it */
+    if ((read (fd,&hdr,sizeof (UNIXINDEXHDR)) != sizeof (UNIXINDEXHDR)) ||
+	memcmp (hdr.magic,UNIXINDEXMAGIC,8) ||
+	(hdr.dev != (unsigned long) sbuf.st_dev) ||
+	(hdr.ino != (unsigned long) sbuf.st_ino) ||
+	(hdr.nmsgs != LOCAL->idxmsgs) || (hdr.filesize != LOCAL->idxsize)) {
+      flock (fd,LOCK_UN);	/* someone else's index now, leave it alone */
+      close (fd);
+      return;
+    }
+				/* add keywords new since index written */
+    for (i = 0; i < NUSERFLAGS; ++i)
+      if (stream->user_flags[i] &&
+	  !(LOCAL->idxuf & (((unsigned long) 1) << i))) {
+	strncpy (hdr.keywords[i],stream->user_flags[i],MAXUSERFLAG);
+	LOCAL->idxuf |= ((unsigned long) 1) << i;
+      }
+  }
+  else {			/* new index, header invalid until done */
+    ftruncate (fd,0);
+    memset (&hdr,'\0',sizeof (UNIXINDEXHDR));
+    for (i = 0,LOCAL->idxuf = 0; i < NUSERFLAGS; ++i)
+      if (stream->user_flags[i]) {
+	strncpy (hdr.keywords[i],stream->user_flags[i],MAXUSERFLAG);
+	LOCAL->idxuf |= ((unsigned long) 1) << i;
+      }
+    msgno = 1;			/* write all messages */
+  }
+  if (ret) {			/* write message records */
+    recs = (UNIXINDEXREC *) fs_get (INDEXBUFRECS * sizeof (UNIXINDEXREC));
+    lseek (fd,sizeof (UNIXINDEXHDR) + (msgno - 1) * sizeof (UNIXINDEXREC),
+	   L_SET);
+    for (i = msgno; ret && (i <= stream->nmsgs); i += j) {
+      for (j = 0; (j < INDEXBUFRECS) && ((i + j) <= stream->nmsgs); ++j) {
+	MESSAGECACHE *elt = mail_elt (stream,i + j);
+	unix_index_record (stream,elt,recs + j,rewrite ?
+			   (elt->recent && LOCAL->appending) : elt->recent);
+      }
+      if (write (fd,(char *) recs,j * sizeof (UNIXINDEXREC)) < 0) ret = NIL;
+    }
+    fs_give ((void **) &recs);
+  }
+
+  if (ret) {			/* update header */
+    memcpy (hdr.magic,UNIXINDEXMAGIC,8);
+    hdr.recsize = sizeof (UNIXINDEXREC);
+    hdr.dev = (unsigned long) sbuf.st_dev;
+    hdr.ino = (unsigned long) sbuf.st_ino;
+    hdr.filesize = LOCAL->filesize;
+				/* mtime only meaningful if all parsed */
+    hdr.filetime = (sbuf.st_size == LOCAL->filesize) ? sbuf.st_mtime : 0;
+    hdr.uid_validity = stream->uid_validity;
+    hdr.uid_last = stream->uid_last;
+    hdr.nmsgs = stream->nmsgs;
+    hdr.pseudo = LOCAL->pseudo;
+				/* save tail of covered data */
+    j = min (LOCAL->filesize,UNIXINDEXTAIL);
+    memset (hdr.tail,'\0',UNIXINDEXTAIL);
+    lseek (LOCAL->fd,LOCAL->filesize - j,L_SET);
+    if ((read (LOCAL->fd,hdr.tail,j) != j) || (lseek (fd,0,L_SET) < 0) ||
+	(write (fd,(char *) &hdr,sizeof (UNIXINDEXHDR)) < 0)) ret = NIL;
+    else {			/* tie off and note index now current */
+      ftruncate (fd,sizeof (UNIXINDEXHDR) +
+		 stream->nmsgs * sizeof (UNIXINDEXREC));
+      LOCAL->idxmsgs = stream->nmsgs;
+      LOCAL->idxsize = LOCAL->filesize;
+      LOCAL->idxvalid = T;
+    }
+  }
+				/* don't leave a bad index lying around */
+  if (!LOCAL->idxvalid) ftruncate (fd,0);
+  flock (fd,LOCK_UN);		/* release index */
+  close (fd);
+}
+
+/* UNIX make mailbox index record
+ * Accepts: MAIL stream
+ *	    message cache element
+ *	    record to write
+ *	    non-zero if message is recent on disk
+ */
+
+void unix_index_record (MAILSTREAM *stream,MESSAGECACHE *elt,
+			UNIXINDEXREC *rec,long recent)
+{
+  rec->offset = elt->private.special.offset;
+  rec->ihdrsize = elt->private.special.text.size;
+  rec->hdrsize = elt->private.msg.header.text.size;
+  rec->textoffset = elt->private.msg.text.offset;
+  rec->textsize = elt->private.msg.text.text.size;
+  rec->xhdrsize = elt->private.spare.data;
+  rec->rfc822_size = elt->rfc822_size;
+  rec->uid = elt->private.uid;
+				/* only keywords recorded in the index */
+  rec->user_flags = elt->user_flags & LOCAL->idxuf;
+  rec->date = elt->day | (elt->month << 5) | (elt->year << 9);
+  rec->time = elt->hours | (elt->minutes << 5) | (elt->seconds << 11) |
+    (elt->zoccident << 17) | (elt->zhours << 18) | (elt->zminutes << 22);
+  rec->flags = (elt->seen ? fSEEN : 0) | (elt->deleted ? fDELETED : 0) |
+    (elt->flagged ? fFLAGGED : 0) | (elt->answered ? fANSWERED : 0) |
+      (elt->draft ? fDRAFT : 0) | (recent ? 0 : fOLD);
+  rec->spare = 0;
+}
+
+/* UNIX note mailbox time change in index
+ * Accepts: MAIL stream
+ */
+
+void unix_index_touch (MAILSTREAM *stream)
+{
+  int fd;
+  char tmp[MAILTMPLEN];
+  struct stat sbuf;
+  UNIXINDEXHDR hdr;
+  if (LOCAL->idxvalid && (LOCAL->idxsize == LOCAL->filesize) &&
+      !fstat (LOCAL->fd,&sbuf) && (sbuf.st_size == LOCAL->filesize) &&
+      unix_index_file (tmp,&sbuf) && ((fd = open (tmp,O_RDWR,NIL)) >= 0)) {
+    flock (fd,LOCK_EX);		/* exclusive access to index */
+    if ((read (fd,&hdr,sizeof (UNIXINDEXHDR)) == sizeof (UNIXINDEXHDR)) &&
+	!memcmp (hdr.magic,UNIXINDEXMAGIC,8) &&
+	(hdr.nmsgs == LOCAL->idxmsgs) && (hdr.filesize == LOCAL->idxsize) &&
+	(hdr.filetime != (unsigned long) sbuf.st_mtime)) {
+      hdr.filetime = sbuf.st_mtime;
+      lseek (fd,0,L_SET);
+      write (fd,(char *) &hdr,sizeof (UNIXINDEXHDR));
+    }
+    flock (fd,LOCK_UN);		/* release index */
+    close (fd);
+  }
+}
+
+/* UNIX mapped file routines */
+
+
+/* UNIX map mailbox file
+ * Accepts: MAIL stream
+ *	    file position of data wanted
+ *	    size of data wanted
+ * Returns: data in mapped file, NIL if not mapping file
+ */
+
+unsigned char *unix_map (MAILSTREAM *stream,unsigned long pos,
+			 unsigned long size)
+{
+  struct stat sbuf;
+  if (!unix_mmap || !size || (LOCAL->fd < 0)) return NIL;
+				/* remap if beyond current mapping */
+  if ((pos + size) > LOCAL->mapsize) {
+    unix_unmap (stream);	/* flush old mapping */
+    if (fstat (LOCAL->fd,&sbuf) || ((pos + size) > sbuf.st_size) ||
+	((LOCAL->map = (unsigned char *)
+	  mmap (NIL,sbuf.st_size,PROT_READ,MAP_SHARED,LOCAL->fd,0)) ==
+	 (unsigned char *) MAP_FAILED)) return LOCAL->map = NIL;
+    LOCAL->mapsize = sbuf.st_size;
+  }
+  return LOCAL->map + pos;
+}
+
+
+/* UNIX unmap mailbox file
+ * Accepts: MAIL stream
+ */
+
+void unix_unmap (MAILSTREAM *stream)
+{
+  if (LOCAL->map) munmap (LOCAL->map,LOCAL->mapsize);
+  LOCAL->map = NIL;
+  LOCAL->mapsize = 0;
+}
+
+/* Initialize string structure for mapped message text
+ * Accepts: string structure
+ *	    mapped message text
+ *	    size of string (ignored, computed from text)
+ */
+
+void unix_map_string_init (STRING *s,void *data,unsigned long size)
+{
+  UNIXMAPTEXT *m = (UNIXMAPTEXT *) data;
+  unsigned char *t,*tl;
+  s->data = data;		/* note text */
+				/* size with CRs squeezed and LF as CRLF */
+  for (size = m->size,t = m->text,tl = t + m->size; t < tl; t++)
+    switch (*t) {
+    case '\r':
+      --size;
+      break;
+    case '\n':
+      ++size;
+      break;
+    }
+  s->size = size;
+  s->curpos = s->chunk = m->chunk;
+  s->chunksize = CHUNKSIZE;
+  s->offset = s->cursize = 0;	/* no chunk loaded yet */
+  m->pos = m->end = 0;
+  unix_map_string_setpos (s,0);	/* load initial chunk */
+}
+
+
+/* Get next character from mapped message text
+ * Accepts: string structure
+ * Returns: character, string structure chunk refreshed
+ */
+
+char unix_map_string_next (STRING *s)
+{
+  char c = *s->curpos++;	/* get next byte */
+  SETPOS (s,GETPOS (s));	/* move to next chunk */
+  return c;			/* return the byte */
+}
+
+/* Set string pointer position for mapped message text
+ * Accepts: string structure
+ *	    new position
+ */
+
+void unix_map_string_setpos (STRING *s,unsigned long i)
+{
+  UNIXMAPTEXT *m = (UNIXMAPTEXT *) s->data;
+  unsigned char *t,*tl;
+  char *c,*cl;
+  unsigned long j;
+  if (i > s->size) i = s->size;	/* don't permit setting beyond EOF */
+				/* within current chunk? */
+  if ((i >= s->offset) && (i < m->end)) {
+    s->curpos = s->chunk + (i - s->offset);
+    s->cursize = m->end - i;
+    return;
+  }
+				/* before current chunk, start over */
+  if (i < m->end) m->pos = m->end = 0;
+				/* skip to new position */
+  for (j = m->end,t = m->text + m->pos,tl = m->text + m->size;
+       (j < i) && (t < tl); t++) switch (*t) {
+  case '\r':			/* CRs are squeezed out */
+    break;
+  case '\n':			/* LF becomes CRLF */
+    j += 2;
+    break;
+  default:
+    j++;
+    break;
+  }
+  s->offset = i;		/* new chunk starts here */
+  c = s->chunk;
+				/* landed between CR and LF? */
+  if (j > i) *c++ = '\n';
+				/* convert next chunk */
+  for (cl = s->chunk + s->chunksize; (t < tl) && (c < cl); t++) {
+    if (*t == '\n') {		/* LF becomes CRLF */
+      if ((c + 1) == cl) break;	/* no room in this chunk */
+      *c++ = '\r';
+      *c++ = '\n';
+    }
+    else if (*t != '\r') *c++ = *t;
+  }
+  m->pos = t - m->text;		/* note where next chunk starts */
+  m->end = i + (c - s->chunk);
+  s->curpos = s->chunk;		/* reset position */
+  s->cursize = c - s->chunk;
+}
+
 
 /* MBOX mail routines */
 
@@ -2437,14 +3142,15 @@ DRIVER mboxdriver = {
   NIL,				/* modify flags */
   unix_flagmsg,			/* per-message modify flags */
   NIL,				/* search for message based on criteria */
-  NIL,				/* sort messages */
-  NIL,				/* thread messages */
+  unix_sort,			/* sort messages */
+  unix_thread,			/* thread messages */
   mbox_ping,			/* ping mailbox to see if still alive */
   mbox_check,			/* check for new messages */
   mbox_expunge,			/* expunge deleted messages */
   unix_copy,			/* copy messages to another mailbox */
   mbox_append,			/* append string message to mailbox */
-  NIL				/* garbage collect stream */
+  NIL,				/* garbage collect stream */
+  NIL				/* watch mailbox for changes */
 };
 
 				/* prototype stream */
@@ -2533,6 +3239,7 @@ long mbox_status (MAILSTREAM *stream,char *mbx,long flags)
       if (!mail_elt (stream,i)->seen) status.unseen++;
   status.uidnext = stream->uid_last + 1;
   status.uidvalidity = stream->uid_validity;
+  status.highestmodseq = 0;	/* no modsequences */
   if (!status.recent &&		/* calculate post-snarf results */
       (systream = mail_open (NIL,sysinbox (),OP_READONLY|OP_SILENT))) {
     status.messages += systream->nmsgs;
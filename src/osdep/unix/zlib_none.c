@@ -0,0 +1,71 @@
+/* ========================================================================
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * ========================================================================
+ */
+
+/*
+ * Program:	Dummy (no zlib) deflate compression module
+ *
+ * Date:	18 October 2026
+ * Last Edited:	18 October 2026
+ */
+
+/*  Without zlib, the IMAP client never negotiates COMPRESS=DEFLATE since no
+ * deflate network driver is bound at run time, and servers never offer it.
+ */
+
+#include <sys/uio.h>
+
+static void *pzip = NIL;	/* never compressing */
+
+/* Start server compression
+ * Accepts: NIL to probe, else algorithm name
+ * Returns: cpystr'd error string if compression is not possible, else NIL
+ */
+
+char *deflate_start (char *s)
+{
+  return cpystr ("This server does not support compression");
+}
+
+/* Server compression stubs, never called since never compressing */
+
+static long pzip_write (struct iovec *iov,int iovcnt,long flush)
+{
+  return NIL;
+}
+
+
+static long pzip_dirty (void)
+{
+  return NIL;
+}
+
+
+static long pzip_pending (void)
+{
+  return NIL;
+}
+
+
+static int pzip_bin (void)
+{
+  return EOF;
+}
+
+
+static char *pzip_sin (char *s,int n)
+{
+  return NIL;
+}
+
+
+static long pzip_sinr (char *s,unsigned long n)
+{
+  return NIL;
+}
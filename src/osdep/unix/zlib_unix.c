@@ -0,0 +1,535 @@
+/* ========================================================================
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * ========================================================================
+ */
+
+/*
+ * Program:	Deflate compressed network stream routines
+ *
+ * Date:	18 October 2026
+ * Last Edited:	18 October 2026
+ */
+
+/*  These routines stack a raw deflate (RFC 1951) compression layer on top of
+ * an existing network stream, as used by IMAP COMPRESS=DEFLATE (RFC 4978).
+ * Output is compressed with a sync flush at the end of each write so that
+ * the server sees every command as soon as it is sent.
+ *
+ *  The same layer is provided for the primary I/O of a server.  Its routines
+ * are called by pout.c and its includer, which follow this module in osdep,
+ * and in turn call that includer's pout_sink() and pin_source().
+ */
+
+#include <sys/uio.h>
+#include <zlib.h>
+
+#define ZLIBBUFLEN 16384	/* size of compression buffers */
+
+typedef struct zlib_stream {
+  NETSTREAM *netstream;		/* underlying network stream */
+  z_stream in;			/* inflate state */
+  z_stream out;			/* deflate state */
+  int more;			/* inflate may have more output pending */
+  long ictr;			/* input counter */
+  char *iptr;			/* input pointer */
+  char ibuf[ZLIBBUFLEN];	/* inflated input buffer */
+  char zbuf[ZLIBBUFLEN];	/* compressed input buffer */
+  char obuf[ZLIBBUFLEN];	/* compressed output buffer */
+} ZLIBSTREAM;
+
+typedef struct pzip_state {
+  z_stream out;			/* deflate state */
+  z_stream in;			/* inflate state */
+  int dirty;			/* deflate has output not yet flushed */
+  int more;			/* inflate may have more output pending */
+  long ictr;			/* input counter */
+  char *iptr;			/* input pointer */
+  char ibuf[ZLIBBUFLEN];	/* inflated input buffer */
+  char zbuf[ZLIBBUFLEN];	/* compressed input buffer */
+  char obuf[ZLIBBUFLEN];	/* compressed output buffer */
+} PZIP;
+
+
+/* Function prototypes */
+
+NETSTREAM *zlib_start (NETSTREAM *stream);
+char *zlib_getline (void *stream);
+static char *zlib_getline_work (ZLIBSTREAM *stream,unsigned long *size,
+				long *contd);
+long zlib_getbuffer (void *stream,unsigned long size,char *buffer);
+unsigned long zlib_getsome (void *stream,unsigned long size,char *buffer);
+long zlib_getdata (ZLIBSTREAM *stream);
+long zlib_soutr (void *stream,char *string);
+long zlib_sout (void *stream,char *string,unsigned long size);
+void zlib_close (void *stream);
+char *zlib_host (void *stream);
+char *zlib_remotehost (void *stream);
+unsigned long zlib_port (void *stream);
+char *zlib_localhost (void *stream);
+static long pzip_write (struct iovec *iov,int iovcnt,long flush);
+static long pzip_dirty (void);
+static long pzip_getdata (void);
+static long pzip_pending (void);
+static int pzip_bin (void);
+static char *pzip_sin (char *s,int n);
+static long pzip_sinr (char *s,unsigned long n);
+static long pout_sink (struct iovec *iov,int iovcnt);
+static long pin_source (char *buf,unsigned long size);
+
+static PZIP *pzip = NIL;	/* server compression state if compressing */
+
+
+/* Deflate network driver dispatch */
+
+static NETDRIVER zlibdriver = {
+  NIL,				/* open connection */
+  NIL,				/* open preauthenticated connection */
+  zlib_getline,			/* get a line */
+  zlib_getbuffer,		/* get a buffer */
+  zlib_soutr,			/* output pushed data */
+  zlib_sout,			/* output string */
+  zlib_close,			/* close connection */
+  zlib_host,			/* return host name */
+  zlib_remotehost,		/* return remote host name */
+  zlib_port,			/* return port number */
+  zlib_localhost,		/* return local host name */
+  zlib_getsome			/* get some data */
+};
+
+/* One-time deflate initialization */
+
+void zlib_onceonlyinit (void)
+{
+				/* apply runtime linkage */
+  mail_parameters (NIL,SET_NETDEFLATE,(void *) zlib_start);
+}
+
+
+/* Start deflate compression on network stream
+ * Accepts: network stream
+ * Returns: compressed network stream, or NIL if failure
+ *
+ * On success, the underlying network stream belongs to the new stream.
+ */
+
+NETSTREAM *zlib_start (NETSTREAM *stream)
+{
+  NETSTREAM *ret = NIL;
+  ZLIBSTREAM *zs;
+				/* underlying stream must be able to do this */
+  if (stream && stream->dtb->getsome) {
+    zs = (ZLIBSTREAM *) memset (fs_get (sizeof (ZLIBSTREAM)),0,
+				sizeof (ZLIBSTREAM));
+				/* negative window bits for raw deflate */
+    if (inflateInit2 (&zs->in,-MAX_WBITS) != Z_OK)
+      fs_give ((void **) &zs);
+    else if (deflateInit2 (&zs->out,Z_DEFAULT_COMPRESSION,Z_DEFLATED,
+			   -MAX_WBITS,8,Z_DEFAULT_STRATEGY) != Z_OK) {
+      inflateEnd (&zs->in);
+      fs_give ((void **) &zs);
+    }
+    else {
+      zs->netstream = stream;
+      ret = (NETSTREAM *) fs_get (sizeof (NETSTREAM));
+      ret->stream = (void *) zs;
+      ret->dtb = &zlibdriver;
+    }
+  }
+  return ret;
+}
+
+/* Deflate receive line
+ * Accepts: deflate stream
+ * Returns: text line string or NIL if failure
+ */
+
+char *zlib_getline (void *stream)
+{
+  unsigned long n;
+  long contd;
+  ZLIBSTREAM *zs = (ZLIBSTREAM *) stream;
+  char *ret = zlib_getline_work (zs,&n,&contd);
+  if (ret && contd) {		/* got a line needing continuation? */
+    STRINGLIST *stl = mail_newstringlist ();
+    STRINGLIST *stc = stl;
+    do {			/* collect additional lines */
+      stc->text.data = (unsigned char *) ret;
+      stc->text.size = n;
+      stc = stc->next = mail_newstringlist ();
+      ret = zlib_getline_work (zs,&n,&contd);
+    } while (ret && contd);
+    if (ret) {			/* stash final part of line on list */
+      stc->text.data = (unsigned char *) ret;
+      stc->text.size = n;
+				/* determine how large a buffer we need */
+      for (n = 0, stc = stl; stc; stc = stc->next) n += stc->text.size;
+      ret = fs_get (n + 1);	/* copy parts into buffer */
+      for (n = 0, stc = stl; stc; n += stc->text.size, stc = stc->next)
+	memcpy (ret + n,stc->text.data,stc->text.size);
+      ret[n] = '\0';
+    }
+    mail_free_stringlist (&stl);/* either way, done with list */
+  }
+  return ret;
+}
+
+/* Deflate receive line or partial line
+ * Accepts: deflate stream
+ *	    pointer to return size
+ *	    pointer to return continuation flag
+ * Returns: text line string, size and continuation flag, or NIL if failure
+ */
+
+static char *zlib_getline_work (ZLIBSTREAM *stream,unsigned long *size,
+				long *contd)
+{
+  unsigned long n;
+  char *s,*ret,c,d;
+  *contd = NIL;			/* assume no continuation */
+				/* make sure have data */
+  if (!zlib_getdata (stream)) return NIL;
+  for (s = stream->iptr, n = 0, c = '\0'; stream->ictr--; n++, c = d) {
+    d = *stream->iptr++;	/* slurp another character */
+    if ((c == '\015') && (d == '\012')) {
+      ret = (char *) fs_get (n--);
+      memcpy (ret,s,*size = n);	/* copy into a free storage string */
+      ret[n] = '\0';		/* tie off string with null */
+      return ret;
+    }
+  }
+				/* copy partial string from buffer */
+  memcpy ((ret = (char *) fs_get (n)),s,*size = n);
+				/* get more data from the net */
+  if (!zlib_getdata (stream)) fs_give ((void **) &ret);
+				/* special case of newline broken by buffer */
+  else if ((c == '\015') && (*stream->iptr == '\012')) {
+    stream->iptr++;		/* eat the line feed */
+    stream->ictr--;
+    ret[*size = --n] = '\0';	/* tie off string with null */
+  }
+  else *contd = LONGT;		/* continuation needed */
+  return ret;
+}
+
+/* Deflate receive buffer
+ * Accepts: deflate stream
+ *	    size in bytes
+ *	    buffer to read into
+ * Returns: T if success, NIL otherwise
+ */
+
+long zlib_getbuffer (void *stream,unsigned long size,char *buffer)
+{
+  unsigned long n;
+  while (size) {		/* until request satisfied */
+    if (!(n = zlib_getsome (stream,size,buffer))) return NIL;
+    buffer += n;		/* update pointer */
+    size -= n;			/* update # of bytes to do */
+  }
+  buffer[0] = '\0';		/* tie off string */
+  return T;
+}
+
+
+/* Deflate receive some data
+ * Accepts: deflate stream
+ *	    maximum size in bytes
+ *	    buffer to read into
+ * Returns: number of bytes read, 0 if failure
+ */
+
+unsigned long zlib_getsome (void *stream,unsigned long size,char *buffer)
+{
+  unsigned long n;
+  ZLIBSTREAM *zs = (ZLIBSTREAM *) stream;
+  if (!zlib_getdata (zs)) return 0;
+  n = min (size,zs->ictr);	/* number of bytes to transfer */
+  memcpy (buffer,zs->iptr,n);
+  zs->iptr += n;
+  zs->ictr -= n;
+  return n;
+}
+
+/* Deflate receive data
+ * Accepts: deflate stream
+ * Returns: T if success, NIL otherwise
+ */
+
+long zlib_getdata (ZLIBSTREAM *stream)
+{
+  int i;
+  while (stream->ictr < 1) {	/* if nothing in the buffer */
+				/* need more compressed data? */
+    if (!stream->in.avail_in && !stream->more) {
+      if (!(i = net_getsome (stream->netstream,ZLIBBUFLEN,stream->zbuf)))
+	return NIL;
+      stream->in.next_in = (Bytef *) stream->zbuf;
+      stream->in.avail_in = i;
+    }
+    stream->in.next_out = (Bytef *) stream->ibuf;
+    stream->in.avail_out = ZLIBBUFLEN;
+    switch (inflate (&stream->in,Z_SYNC_FLUSH)) {
+    case Z_OK:			/* made progress */
+    case Z_BUF_ERROR:		/* needs more input */
+      break;
+    default:			/* end of stream or corrupt data */
+      mm_log ("Invalid compressed data from server",ERROR);
+      return NIL;
+    }
+				/* output buffer filled, may be more */
+    stream->more = !stream->in.avail_out;
+    stream->iptr = stream->ibuf;
+    stream->ictr = ZLIBBUFLEN - stream->in.avail_out;
+  }
+  return T;
+}
+
+/* Deflate send string as record
+ * Accepts: deflate stream
+ *	    string pointer
+ * Returns: T if success else NIL
+ */
+
+long zlib_soutr (void *stream,char *string)
+{
+  return zlib_sout (stream,string,(unsigned long) strlen (string));
+}
+
+
+/* Deflate send string
+ * Accepts: deflate stream
+ *	    string pointer
+ *	    byte count
+ * Returns: T if success else NIL
+ */
+
+long zlib_sout (void *stream,char *string,unsigned long size)
+{
+  ZLIBSTREAM *zs = (ZLIBSTREAM *) stream;
+  zs->out.next_in = (Bytef *) string;
+  zs->out.avail_in = size;
+  do {				/* compress and write a buffer at a time */
+    zs->out.next_out = (Bytef *) zs->obuf;
+    zs->out.avail_out = ZLIBBUFLEN;
+    if (deflate (&zs->out,Z_SYNC_FLUSH) == Z_STREAM_ERROR) return NIL;
+    if ((ZLIBBUFLEN - zs->out.avail_out) &&
+	!net_sout (zs->netstream,zs->obuf,ZLIBBUFLEN - zs->out.avail_out))
+      return NIL;
+  } while (!zs->out.avail_out);
+  return LONGT;
+}
+
+/* Deflate close
+ * Accepts: deflate stream
+ */
+
+void zlib_close (void *stream)
+{
+  ZLIBSTREAM *zs = (ZLIBSTREAM *) stream;
+  inflateEnd (&zs->in);		/* flush compression state */
+  deflateEnd (&zs->out);
+  net_close (zs->netstream);	/* close underlying stream */
+  fs_give ((void **) &zs);
+}
+
+
+/* Deflate get host name
+ * Accepts: deflate stream
+ * Returns: host name for this stream
+ */
+
+char *zlib_host (void *stream)
+{
+  return net_host (((ZLIBSTREAM *) stream)->netstream);
+}
+
+
+/* Deflate get remote host name
+ * Accepts: deflate stream
+ * Returns: host name for this stream
+ */
+
+char *zlib_remotehost (void *stream)
+{
+  return net_remotehost (((ZLIBSTREAM *) stream)->netstream);
+}
+
+
+/* Deflate return port for this stream
+ * Accepts: deflate stream
+ * Returns: port number for this stream
+ */
+
+unsigned long zlib_port (void *stream)
+{
+  return net_port (((ZLIBSTREAM *) stream)->netstream);
+}
+
+
+/* Deflate get local host name
+ * Accepts: deflate stream
+ * Returns: local host name
+ */
+
+char *zlib_localhost (void *stream)
+{
+  return net_localhost (((ZLIBSTREAM *) stream)->netstream);
+}
+
+
+/* Start server compression
+ * Accepts: NIL to probe, else algorithm name
+ * Returns: cpystr'd error string if compression is not possible, else NIL
+ *
+ * Compression takes effect at once, so the response granting it must have
+ * been flushed already.
+ */
+
+char *deflate_start (char *s)
+{
+  if (pzip) return cpystr ("[COMPRESSIONACTIVE] DEFLATE active");
+  if (s) {			/* start compression */
+    pzip = (PZIP *) memset (fs_get (sizeof (PZIP)),0,sizeof (PZIP));
+				/* negative window bits for raw deflate */
+    if ((deflateInit2 (&pzip->out,Z_DEFAULT_COMPRESSION,Z_DEFLATED,-MAX_WBITS,
+		       8,Z_DEFAULT_STRATEGY) != Z_OK) ||
+	(inflateInit2 (&pzip->in,-MAX_WBITS) != Z_OK))
+      fatal ("Can't start compression");
+  }
+  return NIL;
+}
+
+/* Write compressed server output
+ * Accepts: I/O vector
+ *	    I/O vector count
+ *	    flag to sync flush compressed output
+ * Returns: T if success else NIL
+ */
+
+static long pzip_write (struct iovec *iov,int iovcnt,long flush)
+{
+  int i;
+  struct iovec zv;
+  for (i = 0; i < iovcnt; ++i) {
+    pzip->out.next_in = (Bytef *) iov[i].iov_base;
+    pzip->out.avail_in = iov[i].iov_len;
+    do {			/* compress and write a buffer at a time */
+      pzip->out.next_out = (Bytef *) pzip->obuf;
+      pzip->out.avail_out = ZLIBBUFLEN;
+      if (deflate (&pzip->out,(flush && (i == (iovcnt - 1))) ?
+		   Z_SYNC_FLUSH : Z_NO_FLUSH) == Z_STREAM_ERROR) return NIL;
+      zv.iov_base = pzip->obuf;
+      if ((zv.iov_len = ZLIBBUFLEN - pzip->out.avail_out) &&
+	  !pout_sink (&zv,1)) return NIL;
+    } while (pzip->out.avail_in || !pzip->out.avail_out);
+  }
+  pzip->dirty = !flush;		/* note whether deflate holds anything */
+  return LONGT;
+}
+
+
+/* Test for unflushed compressed server output
+ * Returns: T if deflate holds output not yet sync flushed, else NIL
+ */
+
+static long pzip_dirty (void)
+{
+  return pzip->dirty ? LONGT : NIL;
+}
+
+/* Get compressed input data
+ * Returns: T if success, NIL otherwise
+ */
+
+static long pzip_getdata (void)
+{
+  long i;
+  while (pzip->ictr < 1) {	/* if nothing in the buffer */
+				/* need more compressed data? */
+    if (!pzip->in.avail_in && !pzip->more) {
+      if ((i = pin_source (pzip->zbuf,ZLIBBUFLEN)) <= 0) return NIL;
+      pzip->in.next_in = (Bytef *) pzip->zbuf;
+      pzip->in.avail_in = i;
+    }
+    pzip->in.next_out = (Bytef *) pzip->ibuf;
+    pzip->in.avail_out = ZLIBBUFLEN;
+    switch (inflate (&pzip->in,Z_SYNC_FLUSH)) {
+    case Z_OK:			/* made progress */
+    case Z_BUF_ERROR:		/* needs more input */
+      break;
+    default:			/* end of stream or corrupt data */
+      syslog (LOG_INFO,"Invalid compressed data from client");
+      return NIL;
+    }
+				/* output buffer filled, may be more */
+    pzip->more = !pzip->in.avail_out;
+    pzip->iptr = pzip->ibuf;
+    pzip->ictr = ZLIBBUFLEN - pzip->in.avail_out;
+  }
+  return LONGT;
+}
+
+
+/* Test for pending compressed input
+ * Returns: T if input is available without reading, else NIL
+ */
+
+static long pzip_pending (void)
+{
+  return (pzip->ictr > 0) || pzip->more || pzip->in.avail_in;
+}
+
+/* Get compressed character
+ * Returns: character or EOF
+ */
+
+static int pzip_bin (void)
+{
+  if (!pzip_getdata ()) return EOF;
+  pzip->ictr--;			/* one last byte available */
+  return (int) (unsigned char) *pzip->iptr++;
+}
+
+
+/* Get compressed string
+ * Accepts: destination string pointer
+ *	    number of bytes available
+ * Returns: destination string pointer or NIL if EOF
+ */
+
+static char *pzip_sin (char *s,int n)
+{
+  int i,c;
+  for (i = c = 0, n--; (c != '\n') && (i < n); pzip->ictr--) {
+    if ((pzip->ictr <= 0) && !pzip_getdata ()) return NIL;
+    c = s[i++] = *pzip->iptr++;
+  }
+  s[i] = '\0';			/* tie off string */
+  return s;
+}
+
+
+/* Get compressed record
+ * Accepts: destination string pointer
+ *	    number of bytes to read
+ * Returns: T if success, NIL otherwise
+ */
+
+static long pzip_sinr (char *s,unsigned long n)
+{
+  unsigned long i;
+  while (n) {			/* until request satisfied */
+    if (!pzip_getdata ()) return NIL;
+    memcpy (s,pzip->iptr,i = min (n,pzip->ictr));
+    pzip->iptr += i;
+    pzip->ictr -= i;
+    s += i;
+    n -= i;
+  }
+  return LONGT;
+}